@@ -46,9 +46,33 @@ def print_detections_list(detections_list : DetectionList):
         '    WIDTH = {}\n'.format(detections_list.Info().ImageWidth()),
         '    HEIGHT = {}\n'.format(detections_list.Info().ImageHeight()),
         '  ELAPSED TIME (ms) = {}\n'.format(detections_list.Info().ElapsedTimeMs()),
-        '  Detections:\n',
     ]
 
+    # Older servers do not send the extended list information.
+    info_ext = detections_list.InfoExt()
+    if info_ext is not None:
+        msg += [
+            '  Input:\n',
+            '    GEOMETRY = {}\n'.format(info_ext.InputGeometry()),
+            '    SOURCE = {},{} {}x{}\n'.format(
+                info_ext.SourceX(),
+                info_ext.SourceY(),
+                info_ext.SourceWidth(),
+                info_ext.SourceHeight()),
+            '    SCALE = {:.3f},{:.3f}\n'.format(
+                info_ext.InputScaleX(),
+                info_ext.InputScaleY()),
+            '    OFFSET = {},{}\n'.format(
+                info_ext.InputOffsetX(),
+                info_ext.InputOffsetY()),
+            '  STREAM = {}\n'.format(info_ext.StreamIndex()),
+            '  REUSED = {}\n'.format(info_ext.Reused()),
+            '  INFERENCE INTERVAL = {}\n'.format(info_ext.InferenceInterval()),
+            '  CPU (%) = {:.1f}\n'.format(info_ext.CpuPercent()),
+        ]
+
+    msg.append('  Detections:\n')
+
     detections_count = detections_list.DetectionsLength()
     if detections_count > 0:
         for index in range(detections_count):
@@ -57,6 +81,13 @@ def print_detections_list(detections_list : DetectionList):
             msg.append('      ID = {}\n'.format(detection.ClassId()))
             msg.append('      NAME = {}\n'.format(detection.ClassName()))
             msg.append('      CONFIDENCE = {}\n'.format(detection.Confidence()))
+            msg.append('      TRACKED = {}\n'.format(detection.Tracked()))
+            msg.append('      TRACK ID = {}\n'.format(detection.TrackId()))
+            msg.append('      AGE = {}\n'.format(detection.Age()))
+            msg.append('      VELOCITY = ({},{})\n'.format(
+                detection.Velocity().X(),
+                detection.Velocity().Y()
+            ))
             msg.append('      RECT = ({},{},{},{})\n'.format(
                 detection.Box().X(), 
                 detection.Box().Y(), 
@@ -0,0 +1,210 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "gstopencv-utils.h"
+#include "async_detector.h"
+
+AsyncDetector::AsyncDetector(ObjectDetector& detector, ResultCallback callback)
+    : detector_(detector)
+    , callback_(callback)
+    , pending_(nullptr)
+    , dropped_(0)
+    , republish_(false)
+    , stopping_(false)
+    , runner_(&AsyncDetector::run, this)
+{
+    gst_video_info_init(&info_);
+}
+
+AsyncDetector::~AsyncDetector()
+{
+    stop();
+}
+
+void AsyncDetector::submit(GstBuffer* buffer, const GstVideoInfo& info)
+{
+    GstBuffer* replaced = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (stopping_)
+        {
+            return;
+        }
+
+        if (pending_)
+        {
+            replaced = pending_;
+            dropped_++;
+        }
+
+        pending_ = gst_buffer_ref(buffer);
+        info_ = info;
+    }
+
+    condition_.notify_one();
+
+    if (replaced)
+    {
+        gst_buffer_unref(replaced);
+    }
+}
+
+void AsyncDetector::republish()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (stopping_)
+        {
+            return;
+        }
+
+        republish_ = true;
+    }
+
+    condition_.notify_one();
+}
+
+DetectionList AsyncDetector::latest() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return latest_;
+}
+
+guint64 AsyncDetector::dropped() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
+
+void AsyncDetector::stop()
+{
+    GstBuffer* pending = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        pending = pending_;
+        pending_ = nullptr;
+    }
+
+    condition_.notify_one();
+
+    if (runner_.joinable())
+    {
+        runner_.join();
+    }
+
+    if (pending)
+    {
+        gst_buffer_unref(pending);
+    }
+}
+
+void AsyncDetector::run()
+{
+    // This thread only runs inference, so it keeps the settings.
+    apply_thread_settings(detector_.thread_settings());
+
+    for (;;)
+    {
+        GstBuffer* buffer = nullptr;
+        GstVideoInfo info;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this] {
+                return stopping_ || republish_ || (pending_ != nullptr);
+            });
+
+            if (stopping_)
+            {
+                break;
+            }
+
+            // A new frame takes priority, and its list stands in for the
+            // republished one.
+            republish_ = false;
+
+            if (pending_ == nullptr)
+            {
+                DetectionList republished = latest_;
+                lock.unlock();
+
+                ObjectDetector::reuse_detections(republished);
+                callback_(republished);
+                continue;
+            }
+
+            buffer = pending_;
+            pending_ = nullptr;
+            info = info_;
+        }
+
+        DetectionList detection_list;
+        gboolean success = FALSE;
+
+        {
+            ScopedBufferMap scoped_buffer(buffer, info);
+
+            if (!scoped_buffer.view().empty())
+            {
+                success = detector_.get_objects(scoped_buffer.view(), detection_list);
+            }
+        }
+
+        gst_buffer_unref(buffer);
+
+        if (success)
+        {
+            // The stored list is the one the callback completed, so that
+            // frames are annotated with what was published.
+            callback_(detection_list);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            latest_ = std::move(detection_list);
+        }
+    }
+}
@@ -0,0 +1,160 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __ASYNC_DETECTOR_H__
+#define __ASYNC_DETECTOR_H__
+
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include "object_detector.h"
+#include "detections_list.h"
+
+/**
+ * Runs the detector on a dedicated worker thread using a single "latest frame"
+ * slot. The streaming thread submits frames without waiting on inference. A
+ * frame that arrives while the worker is busy replaces the pending frame, so
+ * frames never queue up behind the model. Every list passed to the callback
+ * comes from the worker thread, so lists reach it in frame order.
+ */
+class AsyncDetector {
+public:
+
+    typedef std::function<void(DetectionList&)> ResultCallback;
+
+    /**
+     * Constructor. Starts the worker thread.
+     *
+     * @param detector Initialized detector. The worker is the only user of
+     *                 the detector's model while it is running.
+     * @param callback Invoked from the worker thread for each list of detections
+     *                 it publishes, new or republished. It may complete the
+     *                 list in place, and latest() returns the completed list.
+     */
+    AsyncDetector(ObjectDetector& detector, ResultCallback callback);
+
+    AsyncDetector(const AsyncDetector&) = delete;
+    AsyncDetector& operator= (const AsyncDetector&) = delete;
+
+    /**
+     * Destructor. Stops the worker thread.
+     */
+    ~AsyncDetector();
+
+    /**
+     * Hand a frame to the worker. The worker takes its own reference to the
+     * buffer. Any frame still pending is dropped. Caller is never blocked by
+     * inference.
+     *
+     * @param buffer Input buffer
+     * @param info Video info describing the image represented in buffer
+     */
+    void submit(GstBuffer* buffer, const GstVideoInfo& info);
+
+    /**
+     * Ask the worker to publish the most recent list of detections again,
+     * marked as reused. The request is dropped if the worker publishes a
+     * new list first. Caller is never blocked by inference.
+     */
+    void republish();
+
+    /**
+     * Copy of the most recently computed list of detections, as completed by
+     * the callback.
+     *
+     * @return DetectionList
+     */
+    DetectionList latest() const;
+
+    /**
+     * Number of submitted frames that were replaced before the worker picked
+     * them up.
+     *
+     * @return guint64
+     */
+    guint64 dropped() const;
+
+    /**
+     * Stop the worker thread and release the pending frame. Safe to call
+     * more than once.
+     */
+    void stop();
+
+
+private:
+
+    /**
+     * Worker thread entry point.
+     */
+    void run();
+
+
+private:
+
+    ObjectDetector& detector_;
+
+    ResultCallback callback_;
+
+    mutable std::mutex mutex_;
+
+    std::condition_variable condition_;
+
+    // Pending frame slot
+    GstBuffer* pending_;
+    GstVideoInfo info_;
+
+    guint64 dropped_;
+
+    bool republish_;
+
+    bool stopping_;
+
+    DetectionList latest_;
+
+    std::thread runner_;
+};
+
+#endif // __ASYNC_DETECTOR_H__
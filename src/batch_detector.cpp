@@ -0,0 +1,314 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "gstopencv-utils.h"
+#include "batch_detector.h"
+
+BatchDetector::BatchDetector(ObjectDetector& detector, ResultCallback callback)
+    : detector_(detector)
+    , callback_(callback)
+    , num_pending_(0)
+    , stopping_(false)
+    , runner_(&BatchDetector::run, this)
+{
+}
+
+BatchDetector::~BatchDetector()
+{
+    stop();
+}
+
+void BatchDetector::submit(guint stream_index, GstBuffer* buffer, const GstVideoInfo& info)
+{
+    GstBuffer* replaced = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (stopping_)
+        {
+            return;
+        }
+
+        StreamSlot& slot = streams_[stream_index];
+
+        if (slot.pending)
+        {
+            replaced = slot.pending;
+        }
+        else
+        {
+            num_pending_++;
+        }
+
+        slot.pending = gst_buffer_ref(buffer);
+        slot.info = info;
+    }
+
+    condition_.notify_one();
+
+    if (replaced)
+    {
+        gst_buffer_unref(replaced);
+    }
+}
+
+DetectionList BatchDetector::latest(guint stream_index) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = streams_.find(stream_index);
+    if (it != streams_.end())
+    {
+        return it->second.latest;
+    }
+
+    return DetectionList();
+}
+
+void BatchDetector::remove_stream(guint stream_index)
+{
+    GstBuffer* pending = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = streams_.find(stream_index);
+        if (it != streams_.end())
+        {
+            pending = it->second.pending;
+            if (pending)
+            {
+                num_pending_--;
+            }
+
+            streams_.erase(it);
+        }
+    }
+
+    if (pending)
+    {
+        gst_buffer_unref(pending);
+    }
+}
+
+void BatchDetector::flush_stream(guint stream_index)
+{
+    GstBuffer* pending = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = streams_.find(stream_index);
+        if (it != streams_.end())
+        {
+            StreamSlot& slot = it->second;
+
+            pending = slot.pending;
+            if (pending)
+            {
+                num_pending_--;
+                slot.pending = nullptr;
+            }
+
+            slot.latest = DetectionList();
+            slot.generation++;
+        }
+    }
+
+    if (pending)
+    {
+        gst_buffer_unref(pending);
+    }
+}
+
+void BatchDetector::drain_stream(guint stream_index)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    idle_.wait(lock, [this, stream_index] { return stopping_ || !is_busy(stream_index); });
+}
+
+bool BatchDetector::is_busy(guint stream_index) const
+{
+    auto it = streams_.find(stream_index);
+    if ((it != streams_.end()) && it->second.pending)
+    {
+        return true;
+    }
+
+    return std::find(running_.begin(), running_.end(), stream_index) != running_.end();
+}
+
+void BatchDetector::stop()
+{
+    std::vector<GstBuffer*> pending;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+
+        for (auto& entry : streams_)
+        {
+            if (entry.second.pending)
+            {
+                pending.push_back(entry.second.pending);
+                entry.second.pending = nullptr;
+            }
+        }
+
+        num_pending_ = 0;
+    }
+
+    condition_.notify_one();
+    idle_.notify_all();
+
+    if (runner_.joinable())
+    {
+        runner_.join();
+    }
+
+    for (GstBuffer* buffer : pending)
+    {
+        gst_buffer_unref(buffer);
+    }
+}
+
+void BatchDetector::run()
+{
+    for (;;)
+    {
+        std::vector<PendingFrame> batch;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this] { return stopping_ || (num_pending_ > 0); });
+
+            if (stopping_)
+            {
+                break;
+            }
+
+            for (auto& entry : streams_)
+            {
+                StreamSlot& slot = entry.second;
+
+                if (slot.pending)
+                {
+                    batch.push_back({ entry.first, slot.pending, slot.info, slot.generation });
+                    running_.push_back(entry.first);
+                    slot.pending = nullptr;
+                }
+            }
+
+            num_pending_ = 0;
+        }
+
+        std::vector<std::unique_ptr<ScopedBufferMap>> maps;
+        std::vector<FrameView> frames;
+        std::vector<const PendingFrame*> detected;
+
+        for (const auto& frame : batch)
+        {
+            auto map = std::make_unique<ScopedBufferMap>(frame.buffer, frame.info);
+
+            if (!map->view().empty())
+            {
+                frames.push_back(map->view());
+                detected.push_back(&frame);
+                maps.push_back(std::move(map));
+            }
+        }
+
+        std::vector<DetectionList> detection_lists;
+        gboolean success = frames.empty() ? FALSE : detector_.get_objects(frames, detection_lists);
+
+        frames.clear();
+        maps.clear();
+
+        for (const auto& frame : batch)
+        {
+            gst_buffer_unref(frame.buffer);
+        }
+
+        for (std::size_t index = 0; success && (index < detection_lists.size()); ++index)
+        {
+            const PendingFrame& frame = *detected[index];
+
+            DetectionList& detection_list = detection_lists[index];
+            detection_list.info.stream_index = frame.stream_index;
+
+            {
+                // The stream may have been removed or flushed while inference
+                // was running.
+                std::lock_guard<std::mutex> lock(mutex_);
+
+                auto it = streams_.find(frame.stream_index);
+                if ((it == streams_.end()) || (it->second.generation != frame.generation))
+                {
+                    continue;
+                }
+            }
+
+            callback_(detection_list);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            auto it = streams_.find(frame.stream_index);
+            if ((it != streams_.end()) && (it->second.generation == frame.generation))
+            {
+                it->second.latest = std::move(detection_list);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_.clear();
+        }
+
+        idle_.notify_all();
+    }
+}
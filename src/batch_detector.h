@@ -0,0 +1,196 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BATCH_DETECTOR_H__
+#define __BATCH_DETECTOR_H__
+
+#include <map>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include "object_detector.h"
+#include "detections_list.h"
+
+/**
+ * Runs the detector on a dedicated worker thread for several input streams
+ * at once. Each stream has a single "latest frame" slot. Whenever the worker
+ * is free, it takes the pending frame from every stream and runs them through
+ * the network as one batch.
+ */
+class BatchDetector {
+public:
+
+    typedef std::function<void(const DetectionList&)> ResultCallback;
+
+    /**
+     * Constructor. Starts the worker thread.
+     *
+     * @param detector Initialized detector. The worker is the only user of
+     *                 the detector's model while it is running.
+     * @param callback Invoked from the worker thread for each new list of
+     *                 detections. The list's stream_index identifies the stream.
+     */
+    BatchDetector(ObjectDetector& detector, ResultCallback callback);
+
+    BatchDetector(const BatchDetector&) = delete;
+    BatchDetector& operator= (const BatchDetector&) = delete;
+
+    /**
+     * Destructor. Stops the worker thread.
+     */
+    ~BatchDetector();
+
+    /**
+     * Hand a stream's frame to the worker. The worker takes its own reference
+     * to the buffer. Any frame still pending for the same stream is dropped.
+     * Caller is never blocked by inference.
+     *
+     * @param stream_index Index of the stream the frame belongs to
+     * @param buffer Input buffer
+     * @param info Video info describing the image represented in buffer
+     */
+    void submit(guint stream_index, GstBuffer* buffer, const GstVideoInfo& info);
+
+    /**
+     * Copy of the most recently computed list of detections for a stream.
+     *
+     * @param stream_index Stream index
+     * @return DetectionList
+     */
+    DetectionList latest(guint stream_index) const;
+
+    /**
+     * Forget a stream and release its pending frame.
+     *
+     * @param stream_index Stream index
+     */
+    void remove_stream(guint stream_index);
+
+    /**
+     * Drop a stream's pending frame and its latest detections, for example
+     * after a flush. Results for the stream that are still being computed
+     * are discarded.
+     *
+     * @param stream_index Stream index
+     */
+    void flush_stream(guint stream_index);
+
+    /**
+     * Block until a stream's pending frame, if any, has been detected and
+     * its detections published, for example before forwarding EOS.
+     *
+     * @param stream_index Stream index
+     */
+    void drain_stream(guint stream_index);
+
+    /**
+     * Stop the worker thread and release all pending frames. Safe to call
+     * more than once.
+     */
+    void stop();
+
+
+private:
+
+    struct StreamSlot {
+        GstBuffer* pending = nullptr;
+        GstVideoInfo info;
+        DetectionList latest;
+
+        // Incremented on every flush, so that results for frames submitted
+        // before it can be told apart
+        guint64 generation = 0;
+    };
+
+    struct PendingFrame {
+        guint stream_index;
+        GstBuffer* buffer;
+        GstVideoInfo info;
+        guint64 generation;
+    };
+
+    /**
+     * Check whether a stream has a frame pending or in the running batch.
+     * Caller must hold mutex_.
+     *
+     * @param stream_index Stream index
+     * @return bool
+     */
+    bool is_busy(guint stream_index) const;
+
+    /**
+     * Worker thread entry point.
+     */
+    void run();
+
+
+private:
+
+    ObjectDetector& detector_;
+
+    ResultCallback callback_;
+
+    mutable std::mutex mutex_;
+
+    std::condition_variable condition_;
+
+    // Signaled when the worker finishes a batch
+    std::condition_variable idle_;
+
+    // Streams in the batch the worker is running
+    std::vector<guint> running_;
+
+    std::map<guint, StreamSlot> streams_;
+
+    size_t num_pending_;
+
+    bool stopping_;
+
+    std::thread runner_;
+};
+
+#endif // __BATCH_DETECTOR_H__
@@ -0,0 +1,183 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BOUNDED_QUEUE_H__
+#define __BOUNDED_QUEUE_H__
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * Fixed-capacity FIFO used to connect threads. Producers block while the
+ * queue is full and consumers block while it is empty. Closing the queue
+ * wakes all waiters.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+
+    /**
+     * Constructor
+     *
+     * @param capacity Maximum number of queued items
+     */
+    explicit BoundedQueue(size_t capacity)
+        : capacity_(capacity)
+        , closed_(false)
+    {
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator= (const BoundedQueue&) = delete;
+
+    /**
+     * Append an item, waiting for space if the queue is full.
+     *
+     * @param item Item to append
+     * @return bool false if the queue was closed (the item is not queued)
+     */
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return closed_ || (items_.size() < capacity_); });
+
+        if (closed_)
+        {
+            return false;
+        }
+
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+
+        return true;
+    }
+
+    /**
+     * Remove the oldest item, waiting for one if the queue is empty.
+     *
+     * @param item Receives the removed item
+     * @return bool false if the queue was closed
+     */
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+
+        if (closed_)
+        {
+            return false;
+        }
+
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+
+        return true;
+    }
+
+    /**
+     * Remove the oldest item if one is available.
+     *
+     * @param item Receives the removed item
+     * @return bool false if the queue is empty or closed
+     */
+    bool try_pop(T& item)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (closed_ || items_.empty())
+        {
+            return false;
+        }
+
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+
+        return true;
+    }
+
+    /**
+     * Close the queue and wake all waiters. Items still in the queue are
+     * left in place and may be removed with drain().
+     */
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+    /**
+     * Remove all items, regardless of whether the queue is closed.
+     *
+     * @return std::deque<T> Removed items, oldest first
+     */
+    std::deque<T> drain()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::deque<T> items;
+        items.swap(items_);
+        not_full_.notify_all();
+        return items;
+    }
+
+
+private:
+
+    size_t capacity_;
+
+    bool closed_;
+
+    std::deque<T> items_;
+
+    std::mutex mutex_;
+
+    std::condition_variable not_empty_;
+
+    std::condition_variable not_full_;
+};
+
+#endif // __BOUNDED_QUEUE_H__
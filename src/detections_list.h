@@ -48,6 +48,24 @@
 #include <vector>
 #include <opencv2/opencv.hpp>
 
+// How an image is mapped onto the network input
+enum class InputGeometry : uint32_t {
+
+    // The whole image is resized to the input size
+    Stretch = 0,
+
+    // The largest centered region with the input's aspect ratio is resized
+    // to the input size
+    CenterCrop = 1,
+
+    // The whole image is resized to fit the input, keeping its aspect
+    // ratio, and the rest of the input is padded
+    Letterbox = 2,
+
+    // A user-specified region is resized to the input size
+    Roi = 3
+};
+
 struct Detection {
 
     // Classification returned by OpenCV 
@@ -61,6 +79,20 @@ struct Detection {
 
     // Classification confidence score
     float confidence = 0.0;
+
+    // True if the box was carried over from the last inference by the
+    // tracker rather than detected in this image
+    bool tracked = false;
+
+    // Stable ID of the object across frames, assigned by the SORT tracker
+    // (0 = not tracked, or not yet confirmed)
+    uint32_t track_id = 0;
+
+    // Time (ms) since the track was first seen
+    uint32_t age = 0;
+
+    // Estimated velocity of the box center, in image pixels per second
+    cv::Point2f velocity;
 };
 
 struct MetaInfo {
@@ -80,6 +112,42 @@ struct MetaInfo {
 
     // Elapsed time to perform detection in milliseconds
     uint32_t elapsed_time_ms = 0;
+
+    // Index of the input stream the image came from
+    uint32_t stream_index = 0;
+
+    // Geometry the image was mapped onto the network input with
+    InputGeometry input_geometry = InputGeometry::Stretch;
+
+    // Region of the image that was mapped onto the network input
+    uint32_t source_x = 0;
+    uint32_t source_y = 0;
+    uint32_t source_width = 0;
+    uint32_t source_height = 0;
+
+    // Network input pixels per image pixel, and the position of the mapped
+    // image in the network input (non-zero when letterboxed). A network
+    // input position (u, v) is at image position
+    // (source_x + (u - input_offset_x) / input_scale_x, ...). When the
+    // source is tiled, every tile is mapped with the same scale and offset.
+    float input_scale_x = 1.0;
+    float input_scale_y = 1.0;
+    uint32_t input_offset_x = 0;
+    uint32_t input_offset_y = 0;
+
+    // True if the frame was not run through the network (because it had
+    // not changed, was too late, or fell between two inferences) and the
+    // detections are those of an earlier frame, possibly tracked onto this
+    // one
+    bool reused = false;
+
+    // Operating point of the rate controller: inference runs on one frame
+    // in every inference_interval (1 = every frame), including the fixed
+    // inference interval of the tracker. cpu_percent is the
+    // process's CPU usage, in percent of one core, as last measured by the
+    // controller (0 if the controller is disabled).
+    uint32_t inference_interval = 1;
+    float cpu_percent = 0.0;
 };
 
 struct DetectionList {
@@ -57,7 +57,26 @@ detections_list_server::~detections_list_server()
 
 void detections_list_server::publish(const DetectionList& detections)
 {
-    manager_.publish(detections);
+    // The subscriber pool is owned by the runner thread, so the list is
+    // handed over to the asio context rather than published in place. This
+    // allows publishing from any thread (e.g. an inference worker).
+    boost::asio::post(io_context_, [this, detections]()
+    {
+        manager_.publish(detections);
+    });
+}
+
+void detections_list_server::publish(const message::ptr message)
+{
+    boost::asio::post(io_context_, [this, message]()
+    {
+        manager_.publish(message);
+    });
+}
+
+message::ptr detections_list_server::build_message(const DetectionList& detections)
+{
+    return detections_list_subscriber_manager::build_message(detections);
 }
 
 void detections_list_server::run()
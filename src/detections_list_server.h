@@ -73,13 +73,32 @@ public:
 
     /**
      * Publish a list of detections to all subscribed clients. This is a no-op
-     * if there are no subscribers. Caller is never blocked.
+     * if there are no subscribers. Caller is never blocked. May be called from
+     * any thread.
      *
      * @param detections List of detections
      * @return void
      */
     void publish(const DetectionList& detections);
 
+    /**
+     * Publish a message that has already been built with build_message().
+     * This allows the (comparatively expensive) serialization to run on the
+     * caller's thread. May be called from any thread.
+     *
+     * @param message Message to send
+     * @return void
+     */
+    void publish(const message::ptr message);
+
+    /**
+     * Build a transmittable message from the specified detection list.
+     *
+     * @param detections List of detections
+     * @return Shared pointer to transmittable message
+     */
+    static message::ptr build_message(const DetectionList& detections);
+
     /**
      * Server thread entry point.
      *
@@ -60,7 +60,15 @@ detections_list_subscriber_manager::detections_list_subscriber_manager(
 
 void detections_list_subscriber_manager::publish(const DetectionList& detections_list)
 {
-    message::ptr message = build_message(detections_list);
+    publish(build_message(detections_list));
+}
+
+void detections_list_subscriber_manager::publish(const message::ptr message)
+{
+    if (!message)
+    {
+        return;
+    }
 
     for ( auto subscriber : subscribers_ )
     {
@@ -110,12 +118,21 @@ message::ptr detections_list_subscriber_manager::build_message(const DetectionLi
             detection.box.height
         );
 
+        auto velocity = gst_opencv_detector::Velocity(
+            detection.velocity.x,
+            detection.velocity.y
+        );
+
         detections.push_back(gst_opencv_detector::CreateDetection(
             builder,
             detection.class_id,
             builder.CreateString(detection.class_name),
             &box,
-            detection.confidence
+            detection.confidence,
+            detection.tracked,
+            detection.track_id,
+            detection.age,
+            &velocity
         ));
     }
 
@@ -130,10 +147,28 @@ message::ptr detections_list_subscriber_manager::build_message(const DetectionLi
         detections_list.info.elapsed_time_ms
     );
 
+    auto meta_ext = gst_opencv_detector::CreateMetaExt(
+        builder,
+        detections_list.info.stream_index,
+        static_cast<gst_opencv_detector::InputGeometry>(detections_list.info.input_geometry),
+        detections_list.info.source_x,
+        detections_list.info.source_y,
+        detections_list.info.source_width,
+        detections_list.info.source_height,
+        detections_list.info.input_scale_x,
+        detections_list.info.input_scale_y,
+        detections_list.info.input_offset_x,
+        detections_list.info.input_offset_y,
+        detections_list.info.reused,
+        detections_list.info.inference_interval,
+        detections_list.info.cpu_percent
+    );
+
     auto detection_list = gst_opencv_detector::CreateDetectionList(
         builder,
         &meta_info,
-        detections_vector
+        detections_vector,
+        meta_ext
     );
 
     builder.Finish(detection_list);
@@ -80,6 +80,14 @@ public:
      */
     void publish(const DetectionList& detection_list);
 
+    /**
+     * Publish a message that has already been built with build_message().
+     *
+     * @param message Message to send
+     * @return void
+     */
+    void publish(const message::ptr message);
+
     /**
      * Add the subscriber to the subscription pool.
      *
@@ -103,6 +111,14 @@ public:
      */
     void stop_all();
 
+    /**
+     * Build a transmittable message from the specified detection list.
+     *
+     * @param detection_list Detection list to pack
+     * @return Shared pointer to transmittable message
+     */
+    static message::ptr build_message(const DetectionList& detection_list);
+
 
 private:
 
@@ -113,14 +129,6 @@ private:
      */
     void start_accept();
 
-    /**
-     * Build a transmittable message from the specified detection list.
-     *
-     * @param detection_list Detection list to pack
-     * @return Shared pointer to transmittable message
-     */
-    static message::ptr build_message(const DetectionList& detection_list);
-
 
 private:
 
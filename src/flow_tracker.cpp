@@ -0,0 +1,317 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+#include "flow_tracker.h"
+
+namespace {
+
+float median(std::vector<float>& values)
+{
+    auto middle = values.begin() + values.size() / 2;
+    std::nth_element(values.begin(), middle, values.end());
+    return *middle;
+}
+
+uint64_t create_timestamp()
+{
+    using namespace std::chrono;
+
+    return static_cast<uint64_t>(
+        duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count());
+}
+
+}
+
+FlowTracker::FlowTracker()
+    : interval_(1)
+    , frames_since_detection_(0)
+{
+}
+
+void FlowTracker::configure(guint interval)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    interval_ = std::max(1u, interval);
+    frames_since_detection_ = 0;
+}
+
+bool FlowTracker::enabled() const
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    return interval_ > 1;
+}
+
+bool FlowTracker::should_detect()
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    if ((interval_ <= 1) || (frames_since_detection_ == 0) ||
+        (frames_since_detection_ >= interval_))
+    {
+        frames_since_detection_ = 1;
+        return true;
+    }
+
+    frames_since_detection_++;
+
+    return false;
+}
+
+void FlowTracker::start(const FrameView& frame, const DetectionList& detection_list)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    if ((interval_ <= 1) || !make_image(frame, previous_))
+    {
+        previous_.release();
+        return;
+    }
+
+    frame_size_ = frame.size;
+    detection_list_ = detection_list;
+}
+
+bool FlowTracker::track(const FrameView& frame, DetectionList& detection_list)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    if (previous_.empty() || (frame.size != frame_size_) || !make_image(frame, current_))
+    {
+        return false;
+    }
+
+    const auto start_time = std::chrono::steady_clock::now();
+
+    const float scale_x = static_cast<float>(current_.cols) / frame_size_.width;
+    const float scale_y = static_cast<float>(current_.rows) / frame_size_.height;
+    const size_t points_per_box = static_cast<size_t>(kGridSize * kGridSize);
+
+    std::vector<Detection>& detections = detection_list_.detections;
+
+    // Points are kept off the box edges, which are usually background.
+    std::vector<cv::Point2f> points;
+    points.reserve(detections.size() * points_per_box);
+
+    for (const auto& detection : detections)
+    {
+        const float step_x = detection.box.width * scale_x / (kGridSize + 1);
+        const float step_y = detection.box.height * scale_y / (kGridSize + 1);
+
+        for (int row = 1; row <= kGridSize; ++row)
+        {
+            for (int column = 1; column <= kGridSize; ++column)
+            {
+                points.emplace_back(
+                    detection.box.x * scale_x + column * step_x,
+                    detection.box.y * scale_y + row * step_y);
+            }
+        }
+    }
+
+    if (!points.empty())
+    {
+        std::vector<cv::Point2f> forward;
+        std::vector<cv::Point2f> backward;
+        std::vector<uchar> forward_status;
+        std::vector<uchar> backward_status;
+        std::vector<float> error;
+
+        cv::calcOpticalFlowPyrLK(previous_, current_, points, forward, forward_status, error);
+        cv::calcOpticalFlowPyrLK(current_, previous_, forward, backward, backward_status, error);
+
+        const cv::Rect frame_rect(cv::Point(0, 0), frame_size_);
+
+        std::vector<Detection> tracked;
+        tracked.reserve(detections.size());
+
+        for (size_t index = 0; index < detections.size(); ++index)
+        {
+            Detection& detection = detections[index];
+
+            std::vector<cv::Point2f> start;
+            std::vector<cv::Point2f> end;
+
+            for (size_t point = index * points_per_box; point < (index + 1) * points_per_box; ++point)
+            {
+                if (forward_status[point] && backward_status[point] &&
+                    (cv::norm(backward[point] - points[point]) <= kMaxBackwardError))
+                {
+                    start.push_back(points[point]);
+                    end.push_back(forward[point]);
+                }
+            }
+
+            cv::Rect2f box(
+                detection.box.x * scale_x, detection.box.y * scale_y,
+                detection.box.width * scale_x, detection.box.height * scale_y);
+
+            if (move_box(start, end, box))
+            {
+                detection.box = cv::Rect(
+                    cvRound(box.x / scale_x), cvRound(box.y / scale_y),
+                    cvRound(box.width / scale_x), cvRound(box.height / scale_y)) & frame_rect;
+            }
+
+            detection.tracked = true;
+
+            // Objects that have left the frame are dropped.
+            if (!detection.box.empty())
+            {
+                tracked.push_back(detection);
+            }
+        }
+
+        detections = std::move(tracked);
+    }
+
+    std::swap(previous_, current_);
+
+    detection_list = detection_list_;
+    detection_list.info.timestamp = create_timestamp();
+    detection_list.info.elapsed_time_ms = static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start_time).count());
+    detection_list.info.reused = true;
+
+    return true;
+}
+
+void FlowTracker::reset()
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    previous_.release();
+    detection_list_ = DetectionList();
+    frames_since_detection_ = 0;
+}
+
+bool FlowTracker::make_image(const FrameView& frame, cv::Mat& image) const
+{
+    if (frame.empty())
+    {
+        return false;
+    }
+
+    const cv::Size size = (frame.size.width > kImageWidth) ?
+        cv::Size(kImageWidth, std::max(1, frame.size.height * kImageWidth / frame.size.width)) :
+        frame.size;
+
+    switch (frame.format)
+    {
+    case GST_VIDEO_FORMAT_BGR:
+        {
+            cv::Mat small;
+            cv::resize(frame.planes[0], small, size, 0, 0, cv::INTER_AREA);
+            cv::cvtColor(small, image, cv::COLOR_BGR2GRAY);
+        }
+        return true;
+    case GST_VIDEO_FORMAT_NV12:
+    case GST_VIDEO_FORMAT_I420:
+        cv::resize(frame.planes[0], image, size, 0, 0, cv::INTER_AREA);
+        return true;
+    case GST_VIDEO_FORMAT_YUY2:
+        {
+            // Every element holds a luma sample in its first channel.
+            cv::Mat small;
+            cv::resize(frame.planes[0], small, size, 0, 0, cv::INTER_AREA);
+            cv::extractChannel(small, image, 0);
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool FlowTracker::move_box(
+    const std::vector<cv::Point2f>& start,
+    const std::vector<cv::Point2f>& end,
+    cv::Rect2f& box) const
+{
+    if (start.size() < kMinPoints)
+    {
+        return false;
+    }
+
+    std::vector<float> dx;
+    std::vector<float> dy;
+
+    for (size_t index = 0; index < start.size(); ++index)
+    {
+        dx.push_back(end[index].x - start[index].x);
+        dy.push_back(end[index].y - start[index].y);
+    }
+
+    // The scale change is the median ratio of the distances between every
+    // pair of points.
+    std::vector<float> ratios;
+
+    for (size_t first = 0; first < start.size(); ++first)
+    {
+        for (size_t second = first + 1; second < start.size(); ++second)
+        {
+            const double distance = cv::norm(start[first] - start[second]);
+            if (distance > 1e-3)
+            {
+                ratios.push_back(static_cast<float>(cv::norm(end[first] - end[second]) / distance));
+            }
+        }
+    }
+
+    const float scale = ratios.empty() ? 1.0f : median(ratios);
+
+    const float center_x = box.x + box.width / 2 + median(dx);
+    const float center_y = box.y + box.height / 2 + median(dy);
+
+    box.width *= scale;
+    box.height *= scale;
+    box.x = center_x - box.width / 2;
+    box.y = center_y - box.height / 2;
+
+    return true;
+}
@@ -0,0 +1,179 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __FLOW_TRACKER_H__
+#define __FLOW_TRACKER_H__
+
+#include <mutex>
+#include <vector>
+#include <glib.h>
+#include <opencv2/core.hpp>
+#include "detections_list.h"
+#include "frame_view.h"
+
+/**
+ * Carries detections from one inference to the next through the frames in
+ * between. Each box is followed with pyramidal Lucas-Kanade optical flow on
+ * a grid of points inside it, computed on a downscaled luma image. The box
+ * moves by the median point displacement and scales by the median change in
+ * distance between points (median flow). Points whose backward flow does
+ * not return to where they started are discarded.
+ *
+ * Frames are passed in display order: start() with each detected frame and
+ * track() with each frame in between. All methods may be called from any
+ * thread.
+ */
+class FlowTracker {
+public:
+
+    // Width of the luma image tracking runs on. Smaller frames are used at
+    // their own size.
+    static constexpr int kImageWidth = 320;
+
+    // Points per box side
+    static constexpr int kGridSize = 5;
+
+    // Boxes with fewer reliable points than this keep their last position
+    static constexpr size_t kMinPoints = 4;
+
+    // Largest forward-backward error, in tracking image pixels, of a point
+    // that is used
+    static constexpr float kMaxBackwardError = 1.0;
+
+    FlowTracker();
+    FlowTracker( const FlowTracker& ) = delete;
+    FlowTracker& operator= ( const FlowTracker& ) = delete;
+
+    /**
+     * Configure the tracker.
+     *
+     * @param interval Run inference on one frame in every interval and track
+     *                 the rest. 1 disables the tracker.
+     */
+    void configure(guint interval);
+
+    /**
+     * Check whether the tracker is enabled.
+     *
+     * @return bool
+     */
+    bool enabled() const;
+
+    /**
+     * Count a frame against the inference interval. The first frame after
+     * configure() or reset() is always detected.
+     *
+     * @return bool true if the frame should be detected, false if it should
+     *              be tracked
+     */
+    bool should_detect();
+
+    /**
+     * Start tracking the detections of a frame that was run through the
+     * network.
+     *
+     * @param frame Detected frame (BGR, NV12, I420 or YUY2)
+     * @param detection_list Its detections
+     */
+    void start(const FrameView& frame, const DetectionList& detection_list);
+
+    /**
+     * Move the tracked detections onto the next frame. The list is marked
+     * reused and each detection tracked.
+     *
+     * @param frame Next frame
+     * @param detection_list Tracked detections
+     * @return bool false if there is nothing to track from (no detected frame
+     *              yet, or the frame size changed)
+     */
+    bool track(const FrameView& frame, DetectionList& detection_list);
+
+    /**
+     * Forget the tracked detections, so that the next frame is detected.
+     */
+    void reset();
+
+
+private:
+
+    /**
+     * Downscale the luma of a frame to the tracking image size.
+     *
+     * @param frame Input frame
+     * @param image Tracking image (CV_8UC1)
+     * @return bool false if the frame format is not supported
+     */
+    bool make_image(const FrameView& frame, cv::Mat& image) const;
+
+    /**
+     * Move a box, in tracking image coordinates, by the flow of its points.
+     *
+     * @param start Point positions in the previous image
+     * @param end Point positions in the current image
+     * @param box Box to move
+     * @return bool false if too few points were reliable
+     */
+    bool move_box(
+        const std::vector<cv::Point2f>& start,
+        const std::vector<cv::Point2f>& end,
+        cv::Rect2f& box) const;
+
+
+private:
+
+    mutable std::mutex lock_;
+
+    guint interval_;
+
+    guint frames_since_detection_;
+
+    // Tracking image of the last frame and the detections on it
+    cv::Mat previous_;
+    cv::Mat current_;
+    DetectionList detection_list_;
+
+    // Frame size the tracking image was made from
+    cv::Size frame_size_;
+};
+
+#endif // __FLOW_TRACKER_H__
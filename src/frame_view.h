@@ -0,0 +1,99 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __FRAME_VIEW_H__
+#define __FRAME_VIEW_H__
+
+#include <vector>
+#include <gst/video/video.h>
+#include <opencv2/core.hpp>
+
+/**
+ * Non-owning view of a mapped video frame, one cv::Mat per plane. Each plane
+ * keeps the stride of the underlying buffer.
+ *
+ *   BGR  : [0] packed BGR (CV_8UC3)
+ *   NV12 : [0] Y (CV_8UC1), [1] interleaved UV at half resolution (CV_8UC2)
+ *   I420 : [0] Y (CV_8UC1), [1] U and [2] V at half resolution (CV_8UC1)
+ *   YUY2 : [0] packed Y0 U Y1 V (CV_8UC2, one element per pixel)
+ */
+struct FrameView {
+
+    GstVideoFormat format = GST_VIDEO_FORMAT_UNKNOWN;
+
+    // Frame size in pixels
+    cv::Size size;
+
+    // YUV to RGB conversion parameters
+    GstVideoColorMatrix matrix = GST_VIDEO_COLOR_MATRIX_BT601;
+    GstVideoColorRange range = GST_VIDEO_COLOR_RANGE_16_235;
+
+    std::vector<cv::Mat> planes;
+
+    bool empty() const
+    {
+        return planes.empty();
+    }
+
+    /**
+     * Wrap a packed BGR image (no copy).
+     *
+     * @param image BGR image
+     * @return FrameView View of the image, empty if the image is empty
+     */
+    static FrameView from_bgr(const cv::Mat& image)
+    {
+        FrameView view;
+
+        if (!image.empty())
+        {
+            view.format = GST_VIDEO_FORMAT_BGR;
+            view.size = image.size();
+            view.planes.push_back(image);
+        }
+
+        return view;
+    }
+};
+
+#endif // __FRAME_VIEW_H__
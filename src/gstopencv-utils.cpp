@@ -1,37 +1,83 @@
-#include <map>
 #include <filesystem>
+#include <algorithm>
+#include <gst/video/gstvideopool.h>
 #include "gstopencv-utils.h"
 
-static const std::map<GstVideoFormat,int> FORMAT_TO_CHANNELS = {
-    { GST_VIDEO_FORMAT_BGR, 3 },
-    { GST_VIDEO_FORMAT_UYVY, 2 },
-    { GST_VIDEO_FORMAT_VYUY, 2 },
-    { GST_VIDEO_FORMAT_BGRx, 4 },
-    { GST_VIDEO_FORMAT_RGBx, 4 },
-    { GST_VIDEO_FORMAT_RGB, 3 },
-    { GST_VIDEO_FORMAT_RGB16, 3 },
-    { GST_VIDEO_FORMAT_YUY2, 3 }
-};
-
-ScopedBufferMap::ScopedBufferMap(GstBuffer* buffer, gint width, gint height, GstVideoFormat format)
-: buffer_(buffer)
+FrameView make_frame_view(GstVideoFrame* video_frame)
 {
-    gst_buffer_map(buffer_, &map_, GST_MAP_READ);
+    FrameView view;
 
-    int num_channels = -1;
-    
-    if (FORMAT_TO_CHANNELS.count(format))
+    view.format = GST_VIDEO_FRAME_FORMAT(video_frame);
+    view.size = cv::Size(
+        GST_VIDEO_FRAME_WIDTH(video_frame),
+        GST_VIDEO_FRAME_HEIGHT(video_frame));
+
+    const GstVideoColorimetry& colorimetry = video_frame->info.colorimetry;
+
+    if (colorimetry.matrix != GST_VIDEO_COLOR_MATRIX_UNKNOWN)
     {
-        num_channels = FORMAT_TO_CHANNELS.at(format);
-        cv::Mat temp(cv::Size(width, height), CV_8UC(num_channels), map_.data, cv::Mat::AUTO_STEP);
+        view.matrix = colorimetry.matrix;
+    }
 
-        if (format == GST_VIDEO_FORMAT_BGR)
-        {
-            frame_ = temp.clone();
-        }
-        else
+    if (colorimetry.range != GST_VIDEO_COLOR_RANGE_UNKNOWN)
+    {
+        view.range = colorimetry.range;
+    }
+
+    int plane_type = -1;
+
+    switch (view.format)
+    {
+    case GST_VIDEO_FORMAT_BGR:
+        plane_type = CV_8UC3;
+        break;
+    case GST_VIDEO_FORMAT_NV12:
+    case GST_VIDEO_FORMAT_I420:
+        plane_type = CV_8UC1;
+        break;
+    case GST_VIDEO_FORMAT_YUY2:
+        plane_type = CV_8UC2;
+        break;
+    default:
+        break;
+    }
+
+    if (plane_type < 0)
+    {
+        return view;
+    }
+
+    for (guint plane = 0; plane < GST_VIDEO_FRAME_N_PLANES(video_frame); ++plane)
+    {
+        // The interleaved chroma plane of NV12 holds two bytes per sample
+        int type = ((view.format == GST_VIDEO_FORMAT_NV12) && (plane == 1)) ?
+            CV_8UC2 : plane_type;
+
+        view.planes.emplace_back(
+            GST_VIDEO_FRAME_COMP_HEIGHT(video_frame, plane),
+            GST_VIDEO_FRAME_COMP_WIDTH(video_frame, plane),
+            type,
+            GST_VIDEO_FRAME_PLANE_DATA(video_frame, plane),
+            static_cast<size_t>(GST_VIDEO_FRAME_PLANE_STRIDE(video_frame, plane)));
+    }
+
+    return view;
+}
+
+ScopedBufferMap::ScopedBufferMap(GstBuffer* buffer, const GstVideoInfo& info, GstMapFlags flags)
+: mapped_(false)
+{
+    GstVideoInfo video_info = info;
+
+    if (gst_video_frame_map(&video_frame_, &video_info, buffer, flags))
+    {
+        mapped_ = true;
+
+        view_ = make_frame_view(&video_frame_);
+
+        if (!view_.empty())
         {
-            // cv:cvtColor(temp, frame_, )
+            frame_ = view_.planes[0];
         }
     }
 }
@@ -41,9 +87,251 @@ cv::Mat& ScopedBufferMap::frame()
     return frame_;
 }
 
+const FrameView& ScopedBufferMap::view() const
+{
+    return view_;
+}
+
 ScopedBufferMap::~ScopedBufferMap()
 {
-    gst_buffer_unmap(buffer_, &map_);
+    frame_.release();
+    view_.planes.clear();
+
+    if (mapped_)
+    {
+        gst_video_frame_unmap(&video_frame_);
+    }
+}
+
+GstBufferPool* negotiate_output_pool(GstPad* srcpad, const GstVideoInfo& info)
+{
+    GstCaps* caps = gst_pad_get_current_caps(srcpad);
+    if (caps == nullptr)
+    {
+        return nullptr;
+    }
+
+    GstQuery* query = gst_query_new_allocation(caps, TRUE);
+
+    GstBufferPool* pool = nullptr;
+    guint size = static_cast<guint>(GST_VIDEO_INFO_SIZE(&info));
+    guint min_buffers = 0;
+    guint max_buffers = 0;
+
+    if (gst_pad_peer_query(srcpad, query) &&
+        (gst_query_get_n_allocation_pools(query) > 0))
+    {
+        gst_query_parse_nth_allocation_pool(query, 0, &pool, &size, &min_buffers, &max_buffers);
+        size = MAX(size, static_cast<guint>(GST_VIDEO_INFO_SIZE(&info)));
+    }
+
+    if (pool == nullptr)
+    {
+        pool = gst_video_buffer_pool_new();
+    }
+
+    GstStructure* config = gst_buffer_pool_get_config(pool);
+    gst_buffer_pool_config_set_params(config, caps, size, min_buffers, max_buffers);
+
+    // Downstream pools may pad the planes, in which case the layout is
+    // described by a video meta on every buffer.
+    if (gst_query_find_allocation_meta(query, GST_VIDEO_META_API_TYPE, nullptr) &&
+        gst_buffer_pool_has_option(pool, GST_BUFFER_POOL_OPTION_VIDEO_META))
+    {
+        gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+    }
+
+    if (!gst_buffer_pool_set_config(pool, config) || !gst_buffer_pool_set_active(pool, TRUE))
+    {
+        GST_WARNING_OBJECT(srcpad, "Failed to configure output buffer pool %" GST_PTR_FORMAT, pool);
+        gst_object_unref(pool);
+        pool = nullptr;
+    }
+    else
+    {
+        GST_DEBUG_OBJECT(srcpad, "Using output buffer pool %" GST_PTR_FORMAT, pool);
+    }
+
+    gst_query_unref(query);
+    gst_caps_unref(caps);
+
+    return pool;
+}
+
+void release_output_pool(GstBufferPool** pool)
+{
+    if (*pool)
+    {
+        gst_buffer_pool_set_active(*pool, FALSE);
+        gst_object_unref(*pool);
+        *pool = nullptr;
+    }
+}
+
+static gboolean copy_frame_meta(GstBuffer* buffer, GstMeta** meta, gpointer user_data)
+{
+    GstBuffer* destination = static_cast<GstBuffer*>(user_data);
+    const GstMetaInfo* info = (*meta)->info;
+
+    // The destination describes its own plane layout
+    if ((info->api != GST_VIDEO_META_API_TYPE) && info->transform_func)
+    {
+        GstMetaTransformCopy copy = { FALSE, 0, static_cast<gsize>(-1) };
+        info->transform_func(destination, *meta, buffer, _gst_meta_transform_copy, &copy);
+    }
+
+    return TRUE;
+}
+
+GstBuffer* make_frame_writable(GstBuffer* buffer, const GstVideoInfo& info, GstBufferPool* pool)
+{
+    if (gst_buffer_is_writable(buffer) || (pool == nullptr))
+    {
+        return gst_buffer_make_writable(buffer);
+    }
+
+    // Never wait on the pool: its buffers may all be held by frames that are
+    // queued behind this one.
+    GstBufferPoolAcquireParams params = {};
+    params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+
+    GstBuffer* copy = nullptr;
+    if (gst_buffer_pool_acquire_buffer(pool, &copy, &params) != GST_FLOW_OK)
+    {
+        return gst_buffer_make_writable(buffer);
+    }
+
+    GstVideoInfo video_info = info;
+    GstVideoFrame source_frame;
+    GstVideoFrame destination_frame;
+    gboolean copied = FALSE;
+
+    if (gst_video_frame_map(&source_frame, &video_info, buffer, GST_MAP_READ))
+    {
+        if (gst_video_frame_map(&destination_frame, &video_info, copy, GST_MAP_WRITE))
+        {
+            copied = gst_video_frame_copy(&destination_frame, &source_frame);
+            gst_video_frame_unmap(&destination_frame);
+        }
+
+        gst_video_frame_unmap(&source_frame);
+    }
+
+    if (!copied)
+    {
+        gst_buffer_unref(copy);
+        return gst_buffer_make_writable(buffer);
+    }
+
+    gst_buffer_copy_into(copy, buffer,
+        static_cast<GstBufferCopyFlags>(GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS), 0, -1);
+    gst_buffer_foreach_meta(buffer, copy_frame_meta, copy);
+
+    gst_buffer_unref(buffer);
+
+    return copy;
+}
+
+void attach_roi_meta(GstBuffer* buffer, const DetectionList& detection_list)
+{
+    gint id = 0;
+
+    for (const auto& detection : detection_list.detections)
+    {
+        const gchar* label = detection.class_name.empty() ?
+            "object" : detection.class_name.c_str();
+
+        GstVideoRegionOfInterestMeta* meta = gst_buffer_add_video_region_of_interest_meta(
+            buffer,
+            label,
+            static_cast<guint>(std::max(0, detection.box.x)),
+            static_cast<guint>(std::max(0, detection.box.y)),
+            static_cast<guint>(std::max(0, detection.box.width)),
+            static_cast<guint>(std::max(0, detection.box.height)));
+
+        if (meta == nullptr)
+        {
+            continue;
+        }
+
+        meta->id = id++;
+
+        gst_video_region_of_interest_meta_add_param(meta,
+            gst_structure_new("detection",
+                "label", G_TYPE_STRING, label,
+                "label-id", G_TYPE_INT, detection.class_id,
+                "confidence", G_TYPE_DOUBLE, static_cast<gdouble>(detection.confidence),
+                "track-id", G_TYPE_UINT, static_cast<guint>(detection.track_id),
+                nullptr));
+    }
+}
+
+gboolean parse_regions(const gchar* text, std::vector<std::vector<cv::Point>>& regions)
+{
+    regions.clear();
+
+    if (text == nullptr)
+    {
+        return TRUE;
+    }
+
+    gchar** tokens = g_strsplit(text, ";", -1);
+    gboolean valid = TRUE;
+
+    for (gchar** token = tokens; valid && (*token != nullptr); ++token)
+    {
+        const gchar* region = g_strstrip(*token);
+        int x = 0, y = 0, width = 0, height = 0, length = 0;
+
+        if (*region == '\0')
+        {
+            continue;
+        }
+
+        if ((sscanf(region, "%d,%d,%d,%d%n", &x, &y, &width, &height, &length) == 4) &&
+            (region[length] == '\0'))
+        {
+            // The corners are the rectangle's first and last pixels, so that
+            // the bounding box of the polygon is the rectangle itself.
+            const int right = x + width - 1;
+            const int bottom = y + height - 1;
+
+            valid = (x >= 0) && (y >= 0) && (width > 0) && (height > 0);
+            regions.push_back({
+                cv::Point(x, y), cv::Point(right, y),
+                cv::Point(right, bottom), cv::Point(x, bottom) });
+            continue;
+        }
+
+        std::vector<cv::Point> polygon;
+        gchar** vertices = g_strsplit_set(region, " \t", -1);
+
+        for (gchar** vertex = vertices; valid && (*vertex != nullptr); ++vertex)
+        {
+            if (**vertex == '\0')
+            {
+                continue;
+            }
+
+            valid = (sscanf(*vertex, "%d,%d%n", &x, &y, &length) == 2) &&
+                ((*vertex)[length] == '\0') && (x >= 0) && (y >= 0);
+            polygon.emplace_back(x, y);
+        }
+
+        g_strfreev(vertices);
+
+        valid = valid && (polygon.size() >= 3);
+        regions.push_back(std::move(polygon));
+    }
+
+    g_strfreev(tokens);
+
+    if (!valid)
+    {
+        regions.clear();
+    }
+
+    return valid;
 }
 
 gboolean valid_file_path(const gchar* path)
@@ -60,14 +348,3 @@ gboolean valid_file_path(const gchar* path)
 
     return FALSE;
 }
-
-GstBuffer* cv_mat_to_gst_buffer(const cv::Mat& mat)
-{
-    GstBuffer* buffer = gst_buffer_new_allocate(NULL, mat.total() * mat.elemSize(), NULL);
-    GstMapInfo map;
-    gst_buffer_map(buffer, &map, GST_MAP_WRITE);
-    memcpy(map.data, mat.data, mat.total() * mat.elemSize());
-    gst_buffer_unmap(buffer, &map);
-
-    return buffer;
-}
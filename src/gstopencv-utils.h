@@ -41,25 +41,44 @@
  * Boston, MA 02111-1307, USA.
  */
 
+#ifndef __GSTOPENCV_UTILS_H__
+#define __GSTOPENCV_UTILS_H__
+
 #include <gst/gst.h>
 #include <opencv2/opencv.hpp>
 #include <gst/video/video.h>
+#include "frame_view.h"
+#include "detections_list.h"
+
+/**
+ * Wrap the planes of a mapped video frame (no copy).
+ *
+ * @param video_frame Mapped video frame
+ * @return FrameView View of the frame, empty if the format is not supported
+ */
+FrameView make_frame_view(GstVideoFrame* video_frame);
 
 /**
  * Helper class to create a buffer map scope that is automatically destroyed
  * when the object goes out of scope.
+ *
+ * The frame is wrapped in place (no copy) using the plane stride and offset
+ * of the mapped video frame, so row padding added by the source is honored.
  */
 class ScopedBufferMap {
 public:
 
     /**
-     * Creates a scoped buffer info map from the supplied buffer and attributes.
+     * Creates a scoped video frame map from the supplied buffer.
      * @param buffer Input buffer
-     * @param width Width of image represented in buffer
-     * @param height Height of image represented in buffer
-     * @param format Format of the image represented in buffer
+     * @param info Video info describing the image represented in buffer
+     * @param flags Map flags. Use GST_MAP_READWRITE to modify the frame in
+     *              place, in which case the buffer must be writable.
      */
-    ScopedBufferMap(GstBuffer* buffer, gint width, gint height, GstVideoFormat format);
+    ScopedBufferMap(GstBuffer* buffer, const GstVideoInfo& info, GstMapFlags flags = GST_MAP_READ);
+
+    ScopedBufferMap(const ScopedBufferMap&) = delete;
+    ScopedBufferMap& operator= (const ScopedBufferMap&) = delete;
 
     /**
      * Destructor
@@ -67,20 +86,92 @@ public:
     ~ScopedBufferMap();
 
     /**
-     * Reference to OpenCV matrix.
+     * Reference to OpenCV matrix. The matrix refers to the mapped buffer
+     * memory and must not be used once this object is destroyed. For BGR
+     * frames this is the whole image. For YUV frames it is the first plane
+     * (luma, or packed YUY2), which is what annotation draws on. The matrix
+     * is empty if the buffer could not be mapped or the format is not
+     * supported.
      * 
      * @return OpenCV matrix
      */
     cv::Mat& frame();
 
+    /**
+     * View of every plane of the mapped frame, with the same lifetime rules
+     * as frame(). The view is empty if the buffer could not be mapped or the
+     * format is not supported.
+     *
+     * @return Frame view
+     */
+    const FrameView& view() const;
+
 
 private:
 
-    GstBuffer* buffer_;
-    GstMapInfo map_;
-    cv::Mat    frame_;
+    GstVideoFrame video_frame_;
+    bool          mapped_;
+    cv::Mat       frame_;
+    FrameView     view_;
 };
 
+/**
+ * Negotiate a buffer pool for frames pushed on a source pad. The pool offered
+ * by downstream in reply to an ALLOCATION query is used if there is one;
+ * otherwise a video buffer pool is created. The pad must already have caps.
+ *
+ * @param srcpad Source pad the frames are pushed on
+ * @param info Video info matching the current caps of srcpad
+ * @return GstBufferPool* Active pool (caller owns the reference), or nullptr on failure
+ */
+GstBufferPool* negotiate_output_pool(GstPad* srcpad, const GstVideoInfo& info);
+
+/**
+ * Release a pool returned by negotiate_output_pool(). The pointer is reset.
+ *
+ * @param pool Pool to release (may point to nullptr)
+ */
+void release_output_pool(GstBufferPool** pool);
+
+/**
+ * Make a frame writable so it can be drawn on in place. A buffer that is
+ * already writable is returned unchanged. Otherwise the frame is copied into
+ * a buffer acquired from pool, keeping the flags, timestamps and metadata of
+ * the original, and the original is released. Without a pool (or if the pool
+ * has no buffer available) this falls back to gst_buffer_make_writable().
+ *
+ * @param buffer Input buffer. Ownership is transferred to this function.
+ * @param info Video info describing the image represented in buffer
+ * @param pool Output buffer pool (may be nullptr)
+ * @return GstBuffer* Writable buffer. Ownership is transferred to the caller.
+ */
+GstBuffer* make_frame_writable(GstBuffer* buffer, const GstVideoInfo& info, GstBufferPool* pool);
+
+/**
+ * Attach every detection in the list to the buffer as a
+ * GstVideoRegionOfInterestMeta. The ROI type is the class name and the ROI id
+ * is the index of the detection in the list. Each ROI carries a "detection"
+ * parameter structure with the fields "label" (string), "label-id" (int),
+ * "confidence" (double) and "track-id" (uint, 0 unless the detection has a
+ * confirmed track).
+ *
+ * @param buffer Buffer to attach the metadata to. Must be writable.
+ * @param detection_list List of Detections
+ */
+void attach_roi_meta(GstBuffer* buffer, const DetectionList& detection_list);
+
+/**
+ * Parse a list of regions of interest, separated by ';'. Each region is
+ * either a rectangle, "x,y,width,height", or a polygon of at least three
+ * "x,y" vertices separated by spaces. Coordinates are in image pixels.
+ *
+ * @param text Region list
+ * @param regions Polygons, with each rectangle as the polygon through its
+ *                four corner pixels
+ * @return TRUE if every region is valid, FALSE otherwise
+ */
+gboolean parse_regions(const gchar* text, std::vector<std::vector<cv::Point>>& regions);
+
 /**
  * Utility for checking whether a filepath is valid (and points to a regular file).
  * 
@@ -89,10 +180,4 @@ private:
  */
 gboolean valid_file_path(const gchar* path);
 
-/**
- * Utility method for creating a new GstBuffer from a cv::Mat
- * 
- * @param mat Image matrix
- * @return GstBuffer (caller is responsible for freeing)
- */
-GstBuffer* cv_mat_to_gst_buffer(const cv::Mat& mat);
+#endif // __GSTOPENCV_UTILS_H__
@@ -64,17 +64,28 @@
 #include <gst/video/video.h>
 #include <opencv2/dnn/dnn.hpp>
 #include <vector>
+#include <memory>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <cstdio>
 #include <chrono>
+#include <thread>
 
 #include "gstopencv-utils.h"
 #include "object_detector.h"
+#include "async_detector.h"
+#include "flow_tracker.h"
+#include "motion_gate.h"
+#include "rate_controller.h"
+#include "sort_tracker.h"
+#include "pipelined_detector.h"
 #include "detections_list_server.h"
 
 #include "gstopencvdetector.h"
+#include "gstopencvmultidetector.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_opencv_detector_debug);
 #define GST_CAT_DEFAULT gst_opencv_detector_debug
@@ -97,14 +108,220 @@ enum
     PROP_PORT,
     PROP_MAX_SUBSCRIBERS,
     PROP_CONF_THRESHOLD,
-    PROP_NMS_THRESHOLD
+    PROP_NMS_THRESHOLD,
+    PROP_INFERENCE_MODE,
+    PROP_NUM_WORKERS,
+    PROP_ROI_META,
+    PROP_QOS,
+    PROP_QOS_REPUBLISH,
+    PROP_ASYNC_LOAD,
+    PROP_MAP_MODEL,
+    PROP_SHARE_MODEL,
+    PROP_BACKEND,
+    PROP_TARGET,
+    PROP_NUM_THREADS,
+    PROP_INFERENCE_AFFINITY,
+    PROP_INFERENCE_PRIORITY,
+    PROP_INT8_CALIBRATION,
+    PROP_TILE_COLUMNS,
+    PROP_TILE_ROWS,
+    PROP_TILE_OVERLAP,
+    PROP_INPUT_GEOMETRY,
+    PROP_INPUT_ROI,
+    PROP_ROI,
+    PROP_MOTION_THRESHOLD,
+    PROP_MOTION_MIN_INTERVAL,
+    PROP_MOTION_REFRESH_INTERVAL,
+    PROP_TARGET_LATENCY_MS,
+    PROP_MAX_CPU_PERCENT,
+    PROP_INPUT_WIDTH,
+    PROP_INPUT_HEIGHT,
+    PROP_INPUT_SCALE,
+    PROP_INPUT_MEAN,
+    PROP_SWAP_RB,
+    PROP_REFINE_WIDTH,
+    PROP_REFINE_HEIGHT,
+    PROP_REFINE_INTERVAL,
+    PROP_REFINE_MARGIN,
+    PROP_INFERENCE_INTERVAL,
+    PROP_TRACK_IDS,
+    PROP_TRACK_IOU_THRESHOLD,
+    PROP_TRACK_MAX_AGE
 };
 
-struct _GstOpencvDetector
+typedef enum
+{
+    GST_OPENCV_DETECTOR_INFERENCE_SYNC,
+    GST_OPENCV_DETECTOR_INFERENCE_LATEST,
+    GST_OPENCV_DETECTOR_INFERENCE_PIPELINED
+} GstOpencvDetectorInferenceMode;
+
+#define GST_TYPE_OPENCV_DETECTOR_INFERENCE_MODE (gst_opencv_detector_inference_mode_get_type())
+static GType
+gst_opencv_detector_inference_mode_get_type (void)
+{
+    static GType inference_mode_type = 0;
+    static const GEnumValue inference_modes[] = {
+        { GST_OPENCV_DETECTOR_INFERENCE_SYNC,
+          "Run inference on every frame before pushing it", "sync" },
+        { GST_OPENCV_DETECTOR_INFERENCE_LATEST,
+          "Push frames immediately and run inference on the latest frame in a worker thread", "latest" },
+        { GST_OPENCV_DETECTOR_INFERENCE_PIPELINED,
+          "Run preprocessing, inference, postprocessing and publishing on separate threads "
+          "and push frames in order", "pipelined" },
+        { 0, NULL, NULL }
+    };
+
+    if (!inference_mode_type)
+    {
+        inference_mode_type = g_enum_register_static(
+            "GstOpencvDetectorInferenceMode", inference_modes);
+    }
+
+    return inference_mode_type;
+}
+
+typedef enum
+{
+    GST_OPENCV_DETECTOR_BACKEND_DEFAULT,
+    GST_OPENCV_DETECTOR_BACKEND_OPENCV,
+    GST_OPENCV_DETECTOR_BACKEND_OPENVINO,
+    GST_OPENCV_DETECTOR_BACKEND_TIMVX
+} GstOpencvDetectorBackend;
+
+#define GST_TYPE_OPENCV_DETECTOR_BACKEND (gst_opencv_detector_backend_get_type())
+static GType
+gst_opencv_detector_backend_get_type (void)
+{
+    static GType backend_type = 0;
+    static const GEnumValue backends[] = {
+        { GST_OPENCV_DETECTOR_BACKEND_DEFAULT, "OpenCV's default backend", "default" },
+        { GST_OPENCV_DETECTOR_BACKEND_OPENCV, "OpenCV's own implementation", "opencv" },
+        { GST_OPENCV_DETECTOR_BACKEND_OPENVINO, "OpenVINO inference engine", "openvino" },
+        { GST_OPENCV_DETECTOR_BACKEND_TIMVX, "TIM-VX", "timvx" },
+        { 0, NULL, NULL }
+    };
+
+    if (!backend_type)
+    {
+        backend_type = g_enum_register_static(
+            "GstOpencvDetectorBackend", backends);
+    }
+
+    return backend_type;
+}
+
+typedef enum
+{
+    GST_OPENCV_DETECTOR_TARGET_CPU,
+    GST_OPENCV_DETECTOR_TARGET_CPU_FP16,
+    GST_OPENCV_DETECTOR_TARGET_NPU
+} GstOpencvDetectorTarget;
+
+#define GST_TYPE_OPENCV_DETECTOR_TARGET (gst_opencv_detector_target_get_type())
+static GType
+gst_opencv_detector_target_get_type (void)
+{
+    static GType target_type = 0;
+    static const GEnumValue targets[] = {
+        { GST_OPENCV_DETECTOR_TARGET_CPU, "CPU", "cpu" },
+        { GST_OPENCV_DETECTOR_TARGET_CPU_FP16, "CPU with half-precision arithmetic", "cpu-fp16" },
+        { GST_OPENCV_DETECTOR_TARGET_NPU, "Neural processing unit (TIM-VX)", "npu" },
+        { 0, NULL, NULL }
+    };
+
+    if (!target_type)
+    {
+        target_type = g_enum_register_static(
+            "GstOpencvDetectorTarget", targets);
+    }
+
+    return target_type;
+}
+
+// Values match InputGeometry
+typedef enum
+{
+    GST_OPENCV_DETECTOR_INPUT_GEOMETRY_STRETCH,
+    GST_OPENCV_DETECTOR_INPUT_GEOMETRY_CENTER_CROP,
+    GST_OPENCV_DETECTOR_INPUT_GEOMETRY_LETTERBOX,
+    GST_OPENCV_DETECTOR_INPUT_GEOMETRY_ROI
+} GstOpencvDetectorInputGeometry;
+
+#define GST_TYPE_OPENCV_DETECTOR_INPUT_GEOMETRY (gst_opencv_detector_input_geometry_get_type())
+static GType
+gst_opencv_detector_input_geometry_get_type (void)
+{
+    static GType input_geometry_type = 0;
+    static const GEnumValue input_geometries[] = {
+        { GST_OPENCV_DETECTOR_INPUT_GEOMETRY_STRETCH,
+          "Resize the whole frame to the network input size", "stretch" },
+        { GST_OPENCV_DETECTOR_INPUT_GEOMETRY_CENTER_CROP,
+          "Resize the largest centered region with the network input's aspect ratio", "center-crop" },
+        { GST_OPENCV_DETECTOR_INPUT_GEOMETRY_LETTERBOX,
+          "Resize the whole frame keeping its aspect ratio and pad the rest of the input", "letterbox" },
+        { GST_OPENCV_DETECTOR_INPUT_GEOMETRY_ROI,
+          "Resize the region given by input-roi", "roi" },
+        { 0, NULL, NULL }
+    };
+
+    if (!input_geometry_type)
+    {
+        input_geometry_type = g_enum_register_static(
+            "GstOpencvDetectorInputGeometry", input_geometries);
+    }
+
+    return input_geometry_type;
+}
+
+// Backends and targets that this version of OpenCV does not define map to -1.
+#define GST_OPENCV_DETECTOR_CV_VERSION_AT_LEAST(major, minor) \
+    ((CV_VERSION_MAJOR > (major)) || \
+     ((CV_VERSION_MAJOR == (major)) && (CV_VERSION_MINOR >= (minor))))
+
+static int
+gst_opencv_detector_dnn_backend (GstOpencvDetectorBackend backend)
+{
+    switch (backend) {
+    case GST_OPENCV_DETECTOR_BACKEND_OPENCV:
+        return cv::dnn::DNN_BACKEND_OPENCV;
+    case GST_OPENCV_DETECTOR_BACKEND_OPENVINO:
+        return cv::dnn::DNN_BACKEND_INFERENCE_ENGINE;
+    case GST_OPENCV_DETECTOR_BACKEND_TIMVX:
+#if GST_OPENCV_DETECTOR_CV_VERSION_AT_LEAST(4, 6)
+        return cv::dnn::DNN_BACKEND_TIMVX;
+#else
+        return -1;
+#endif
+    default:
+        return cv::dnn::DNN_BACKEND_DEFAULT;
+    }
+}
+
+static int
+gst_opencv_detector_dnn_target (GstOpencvDetectorTarget target)
 {
-    GstElement element;
+    switch (target) {
+    case GST_OPENCV_DETECTOR_TARGET_CPU_FP16:
+#if GST_OPENCV_DETECTOR_CV_VERSION_AT_LEAST(4, 9)
+        return cv::dnn::DNN_TARGET_CPU_FP16;
+#else
+        return -1;
+#endif
+    case GST_OPENCV_DETECTOR_TARGET_NPU:
+#if GST_OPENCV_DETECTOR_CV_VERSION_AT_LEAST(4, 6)
+        return cv::dnn::DNN_TARGET_NPU;
+#else
+        return -1;
+#endif
+    default:
+        return cv::dnn::DNN_TARGET_CPU;
+    }
+}
 
-    GstPad *sinkpad, *srcpad;
+struct _GstOpencvDetector
+{
+    GstVideoFilter base;
 
     // Settings
     gboolean silent;
@@ -112,30 +329,150 @@ struct _GstOpencvDetector
     gchar* weights_path;
     gchar* class_names_path;
     gboolean annotate;
+    gboolean roi_meta;
     guint port;
     guint max_subscribers;
     float conf_threshold;
     float nms_threshold;
-
-    gint width;
-    gint height;
-    GstVideoFormat format;
+    GstOpencvDetectorInferenceMode inference_mode;
+    guint num_workers;
+    gboolean qos;
+    gboolean qos_republish;
+    gboolean async_load;
+    gboolean map_model;
+    gboolean share_model;
+    GstOpencvDetectorBackend backend;
+    GstOpencvDetectorTarget target;
+    guint num_threads;
+    guint64 inference_affinity;
+    gint inference_priority;
+    gchar* int8_calibration;
+    guint tile_columns;
+    guint tile_rows;
+    float tile_overlap;
+    GstOpencvDetectorInputGeometry input_geometry;
+    cv::Rect input_roi;
+    gchar* roi;
+    float motion_threshold;
+    guint motion_min_interval;
+    guint motion_refresh_interval;
+    guint target_latency_ms;
+    guint max_cpu_percent;
+    guint input_width;
+    guint input_height;
+    float input_scale;
+    float input_mean;
+    gboolean swap_rb;
+    guint refine_width;
+    guint refine_height;
+    guint refine_interval;
+    float refine_margin;
+    guint inference_interval;
+    gboolean track_ids;
+    float track_iou_threshold;
+    guint track_max_age;
+
+    // Most recent QoS report from downstream and the resulting frame counts,
+    // protected by the object lock.
+    gdouble qos_proportion;
+    GstClockTime qos_earliest_time;
+    guint64 qos_processed;
+    guint64 qos_dropped;
+
+    // Set when the buffer being processed is too late for inference
+    gboolean frame_late;
+
+    // Set in sync mode when the detections of the buffer being processed are
+    // to be drawn on it or attached to it
+    gboolean apply_detections;
+
+    // Pool for frames that must be copied before they can be annotated.
+    // Negotiated with downstream on first use after each caps change.
+    GstBufferPool* output_pool;
+    gboolean output_pool_negotiated;
 
     DetectionList detection_list;
 
     // std::unique_ptr<ObjectDetector> detector_;
     ObjectDetector* detector_;
+    MotionGate* motion_gate_;
+    RateController* rate_controller_;
+    FlowTracker* flow_tracker_;
+    SortTracker* sort_tracker_;
     detections_list_server* server_;
+    AsyncDetector* async_detector_;
+    PipelinedDetector* pipelined_detector_;
+
+    // Additional detectors of the pipelined mode, loaded with the model
+    std::vector<ObjectDetector*>* workers_;
+
+    // Loads the model when async-load is enabled
+    std::thread* loader_;
+
+    // Set when a property that is applied when the model is loaded changes
+    // after it was loaded. The model is then loaded again on the next NULL
+    // to READY.
+    gboolean model_dirty;
 
     _GstOpencvDetector()
-        : sinkpad(nullptr)
-        , srcpad(nullptr)
-        , silent(FALSE)
+        : silent(FALSE)
         , configs_path(nullptr)
         , weights_path(nullptr)
         , annotate(TRUE)
+        , roi_meta(FALSE)
+        , qos(TRUE)
+        , qos_republish(FALSE)
+        , async_load(FALSE)
+        , map_model(FALSE)
+        , share_model(FALSE)
+        , backend(GST_OPENCV_DETECTOR_BACKEND_DEFAULT)
+        , target(GST_OPENCV_DETECTOR_TARGET_CPU)
+        , num_threads(0)
+        , inference_affinity(0)
+        , inference_priority(0)
+        , int8_calibration(nullptr)
+        , tile_columns(1)
+        , tile_rows(1)
+        , tile_overlap(0.25)
+        , input_geometry(GST_OPENCV_DETECTOR_INPUT_GEOMETRY_STRETCH)
+        , roi(nullptr)
+        , motion_threshold(0.0)
+        , motion_min_interval(0)
+        , motion_refresh_interval(5000)
+        , target_latency_ms(0)
+        , max_cpu_percent(0)
+        , input_width(ObjectDetector::kDefaultCropWidth)
+        , input_height(ObjectDetector::kDefaultCropHeight)
+        , input_scale(ObjectDetector::kDefaultScale)
+        , input_mean(ObjectDetector::kDefaultInputMean)
+        , swap_rb(TRUE)
+        , refine_width(0)
+        , refine_height(0)
+        , refine_interval(0)
+        , refine_margin(0.1)
+        , inference_interval(1)
+        , track_ids(FALSE)
+        , track_iou_threshold(SortTracker::kDefaultIouThreshold)
+        , track_max_age(SortTracker::kDefaultMaxAgeMs)
+        , qos_proportion(1.0)
+        , qos_earliest_time(GST_CLOCK_TIME_NONE)
+        , qos_processed(0)
+        , qos_dropped(0)
+        , frame_late(FALSE)
+        , apply_detections(FALSE)
+        , output_pool(nullptr)
+        , output_pool_negotiated(FALSE)
         , detector_(nullptr)
+        , motion_gate_(nullptr)
+        , rate_controller_(nullptr)
+        , flow_tracker_(nullptr)
+        , sort_tracker_(nullptr)
         , server_(nullptr)
+        , async_detector_(nullptr)
+        , pipelined_detector_(nullptr)
+        , workers_(nullptr)
+        , loader_(nullptr)
+        , model_dirty(FALSE)
     {
 
     }
@@ -156,7 +493,7 @@ static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS (
         "video/x-raw, "
-            "format=(string)BGR"
+            "format=(string){ BGR, NV12, I420, YUY2 }"
     )
 );
 
@@ -165,12 +502,12 @@ static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS (
         "video/x-raw, "
-            "format=(string)BGR"
+            "format=(string){ BGR, NV12, I420, YUY2 }"
     )
 );
 
 #define gst_opencv_detector_parent_class parent_class
-G_DEFINE_TYPE (GstOpencvDetector, gst_opencv_detector, GST_TYPE_ELEMENT);
+G_DEFINE_TYPE (GstOpencvDetector, gst_opencv_detector, GST_TYPE_VIDEO_FILTER);
 
 GST_ELEMENT_REGISTER_DEFINE (opencv_detector, "opencv_detector", GST_RANK_NONE,
     GST_TYPE_OPENCVDETECTOR);
@@ -181,10 +518,52 @@ static void gst_opencv_detector_set_property (GObject * object,
 static void gst_opencv_detector_get_property (GObject * object,
     guint prop_id, GValue * value, GParamSpec * pspec);
 
-static gboolean gst_opencv_detector_sink_event (GstPad * pad,
-    GstObject * parent, GstEvent * event);
-static GstFlowReturn gst_opencv_detector_chain (GstPad * pad,
-    GstObject * parent, GstBuffer * buf);
+static GstStateChangeReturn gst_opencv_detector_change_state (GstElement * element,
+    GstStateChange transition);
+
+static gboolean gst_opencv_detector_stop (GstBaseTransform * trans);
+static gboolean gst_opencv_detector_sink_event (GstBaseTransform * trans,
+    GstEvent * event);
+static gboolean gst_opencv_detector_src_event (GstBaseTransform * trans,
+    GstEvent * event);
+static GstFlowReturn gst_opencv_detector_submit_input_buffer (
+    GstBaseTransform * trans, gboolean is_discont, GstBuffer * input);
+static GstFlowReturn gst_opencv_detector_prepare_output_buffer (
+    GstBaseTransform * trans, GstBuffer * input, GstBuffer ** outbuf);
+static GstFlowReturn gst_opencv_detector_generate_output (
+    GstBaseTransform * trans, GstBuffer ** outbuf);
+static GstFlowReturn gst_opencv_detector_transform_ip (
+    GstBaseTransform * trans, GstBuffer * buf);
+static gboolean gst_opencv_detector_set_info (GstVideoFilter * vfilter,
+    GstCaps * incaps, GstVideoInfo * in_info, GstCaps * outcaps,
+    GstVideoInfo * out_info);
+
+static gboolean gst_opencv_detector_load_model (GstOpencvDetector * filter);
+static void gst_opencv_detector_release_model (GstOpencvDetector * filter);
+static gboolean gst_opencv_detector_is_load_property (guint prop_id);
+static void gst_opencv_detector_load_workers (GstOpencvDetector * filter);
+static void gst_opencv_detector_configure_detector (GstOpencvDetector * filter,
+    ObjectDetector & detector);
+static void gst_opencv_detector_load_model_async (GstOpencvDetector * filter);
+static void gst_opencv_detector_join_loader (GstOpencvDetector * filter);
+static gboolean gst_opencv_detector_start_server (GstOpencvDetector * filter);
+static void gst_opencv_detector_stop_server (GstOpencvDetector * filter);
+static gboolean gst_opencv_detector_ensure_initialized (GstOpencvDetector * filter);
+static void gst_opencv_detector_configure_motion_gate (GstOpencvDetector * filter);
+static void gst_opencv_detector_configure_sort_tracker (GstOpencvDetector * filter);
+static gboolean gst_opencv_detector_needs_inference (GstOpencvDetector * filter,
+    GstBuffer * buf, const FrameView * view);
+static gboolean gst_opencv_detector_needs_tracking (GstOpencvDetector * filter);
+static gboolean gst_opencv_detector_detect_frame (GstOpencvDetector * filter,
+    GstBuffer * buf);
+static void gst_opencv_detector_finish_detections (GstOpencvDetector * filter,
+    DetectionList & detection_list);
+static void gst_opencv_detector_reset_qos (GstOpencvDetector * filter);
+static GstBuffer * gst_opencv_detector_annotate_latest (GstOpencvDetector * filter,
+    GstBuffer * buf);
+static void gst_opencv_detector_drain_completed (GstOpencvDetector * filter);
+static void gst_opencv_detector_discard_completed (GstOpencvDetector * filter);
+static GstBufferPool * gst_opencv_detector_get_output_pool (GstOpencvDetector * filter);
 
 /* GObject vmethod implementations */
 
@@ -194,9 +573,13 @@ gst_opencv_detector_class_init (GstOpencvDetectorClass * klass)
 {
     GObjectClass *gobject_class;
     GstElementClass *gstelement_class;
+    GstBaseTransformClass *trans_class;
+    GstVideoFilterClass *vfilter_class;
 
     gobject_class = (GObjectClass *) klass;
     gstelement_class = (GstElementClass *) klass;
+    trans_class = (GstBaseTransformClass *) klass;
+    vfilter_class = (GstVideoFilterClass *) klass;
 
     gobject_class->set_property = gst_opencv_detector_set_property;
     gobject_class->get_property = gst_opencv_detector_get_property;
@@ -269,11 +652,351 @@ gst_opencv_detector_class_init (GstOpencvDetectorClass * klass)
             0.1, 1.0,
             0.2, G_PARAM_READWRITE));
 
+    g_object_class_install_property( gobject_class, PROP_INFERENCE_MODE,
+        g_param_spec_enum(
+            "inference-mode",
+            "Inference Mode",
+            "Whether frames wait on inference (sync), are pushed immediately "
+            "while a worker thread runs inference on the latest frame (latest), "
+            "or are passed through a multi-threaded stage pipeline (pipelined)",
+            GST_TYPE_OPENCV_DETECTOR_INFERENCE_MODE,
+            GST_OPENCV_DETECTOR_INFERENCE_SYNC, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_NUM_WORKERS,
+        g_param_spec_uint(
+            "num-workers",
+            "Number of Workers",
+            "Number of independent detector instances that frames are dispatched "
+            "to round-robin (pipelined mode only)",
+            1, 64,
+            1, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_ROI_META,
+        g_param_spec_boolean(
+            "roi-meta",
+            "ROI Meta",
+            "Attach each detection to the outgoing frame as GstVideoRegionOfInterestMeta",
+            FALSE, G_PARAM_READWRITE));
+
+    // Late frames are still pushed downstream; only their inference is
+    // skipped. This replaces GstBaseTransform's QoS handling, which drops
+    // them.
+    g_object_class_override_property (gobject_class, PROP_QOS, "qos");
+
+    g_object_class_install_property( gobject_class, PROP_QOS_REPUBLISH,
+        g_param_spec_boolean(
+            "qos-republish",
+            "QoS Republish",
+            "Publish (and annotate or attach) the last detections for frames "
+            "whose inference is skipped because they are late",
+            FALSE, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_ASYNC_LOAD,
+        g_param_spec_boolean(
+            "async-load",
+            "Async Load",
+            "Load the model on a separate thread during the READY to PAUSED "
+            "transition and complete it asynchronously with async-done, rather than "
+            "blocking the NULL to READY transition",
+            FALSE, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_MAP_MODEL,
+        g_param_spec_boolean(
+            "map-model",
+            "Map Model",
+            "Build the network from memory-mapped model files instead of "
+            "reading them into private memory",
+            FALSE, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_SHARE_MODEL,
+        g_param_spec_boolean(
+            "share-model",
+            "Share Model",
+            "Share the network with other detectors in the process that load "
+            "the same model files. Detectors sharing a network run their "
+            "forward passes one at a time",
+            FALSE, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_BACKEND,
+        g_param_spec_enum(
+            "backend",
+            "Backend",
+            "DNN backend used for inference. Backends that OpenCV was built "
+            "without fall back to the default.",
+            GST_TYPE_OPENCV_DETECTOR_BACKEND,
+            GST_OPENCV_DETECTOR_BACKEND_DEFAULT, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_TARGET,
+        g_param_spec_enum(
+            "target",
+            "Target",
+            "Device that the backend runs inference on",
+            GST_TYPE_OPENCV_DETECTOR_TARGET,
+            GST_OPENCV_DETECTOR_TARGET_CPU, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_NUM_THREADS,
+        g_param_spec_uint(
+            "num-threads",
+            "Number of Threads",
+            "Number of threads OpenCV uses for inference (0 = leave it unchanged). "
+            "OpenCV has a single thread pool, so this applies to every detector "
+            "and every other OpenCV user in the process.",
+            0, 256,
+            0, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_INFERENCE_AFFINITY,
+        g_param_spec_uint64(
+            "inference-affinity",
+            "Inference Affinity",
+            "CPU mask (one bit per CPU) that the inference thread and OpenCV's "
+            "worker threads are pinned to (0 = no pinning)",
+            0, G_MAXUINT64,
+            0, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_INFERENCE_PRIORITY,
+        g_param_spec_int(
+            "inference-priority",
+            "Inference Priority",
+            "Nice value of the inference thread and OpenCV's worker threads "
+            "(0 = unchanged). Negative values require CAP_SYS_NICE.",
+            -20, 19,
+            0, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_INT8_CALIBRATION,
+        g_param_spec_string(
+            "int8-calibration",
+            "INT8 Calibration",
+            "Directory of calibration images. If set, the network is quantized "
+            "to INT8 when it is loaded.",
+            NULL, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_TILE_COLUMNS,
+        g_param_spec_uint(
+            "tile-columns",
+            "Tile Columns",
+            "Number of tile columns each frame is cut into. Tiles are detected "
+            "in one batched forward pass and the detections merged.",
+            1, 16,
+            1, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_TILE_ROWS,
+        g_param_spec_uint(
+            "tile-rows",
+            "Tile Rows",
+            "Number of tile rows each frame is cut into",
+            1, 16,
+            1, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_TILE_OVERLAP,
+        g_param_spec_float(
+            "tile-overlap",
+            "Tile Overlap",
+            "Fraction of a tile's width and height shared with the neighboring tile",
+            0.0, 0.9,
+            0.25, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_INPUT_GEOMETRY,
+        g_param_spec_enum(
+            "input-geometry",
+            "Input Geometry",
+            "How frames are mapped onto the network input. Boxes are always "
+            "reported in frame coordinates.",
+            GST_TYPE_OPENCV_DETECTOR_INPUT_GEOMETRY,
+            GST_OPENCV_DETECTOR_INPUT_GEOMETRY_STRETCH, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_INPUT_ROI,
+        g_param_spec_string(
+            "input-roi",
+            "Input ROI",
+            "Region of the frame detected in roi geometry, as \"x,y,width,height\"",
+            NULL, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_ROI,
+        g_param_spec_string(
+            "roi",
+            "ROI",
+            "Regions of interest, separated by ';', each either \"x,y,width,height\" "
+            "or a polygon \"x1,y1 x2,y2 x3,y3 ...\". Only their bounding box is "
+            "detected, and only detections centered inside a region are reported.",
+            NULL, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_MOTION_THRESHOLD,
+        g_param_spec_float(
+            "motion-threshold",
+            "Motion Threshold",
+            "Fraction of a downscaled frame that must change since the last "
+            "detected frame for inference to run. Frames below it reuse the last "
+            "detections. 0 runs inference on every frame.",
+            0.0, 1.0,
+            0.0, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_MOTION_MIN_INTERVAL,
+        g_param_spec_uint(
+            "motion-min-interval",
+            "Motion Minimum Interval",
+            "Minimum time in milliseconds between two inferences triggered by motion",
+            0, G_MAXUINT,
+            0, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_MOTION_REFRESH_INTERVAL,
+        g_param_spec_uint(
+            "motion-refresh-interval",
+            "Motion Refresh Interval",
+            "Time in milliseconds after which inference runs even without motion "
+            "(0 = never)",
+            0, G_MAXUINT,
+            5000, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_TARGET_LATENCY_MS,
+        g_param_spec_uint(
+            "target-latency-ms",
+            "Target Latency",
+            "Average inference time per frame, in milliseconds, that the rate "
+            "controller keeps to by running inference on fewer frames (0 = no target)",
+            0, 10000,
+            0, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_MAX_CPU_PERCENT,
+        g_param_spec_uint(
+            "max-cpu-percent",
+            "Maximum CPU Percent",
+            "CPU usage of the process, in percent of one core, that the rate "
+            "controller keeps below by running inference on fewer frames (0 = no limit)",
+            0, 6400,
+            0, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_INPUT_WIDTH,
+        g_param_spec_uint(
+            "input-width",
+            "Input Width",
+            "Width of the network input, in pixels. Smaller inputs are faster "
+            "but find fewer small objects.",
+            16, 4096,
+            ObjectDetector::kDefaultCropWidth, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_INPUT_HEIGHT,
+        g_param_spec_uint(
+            "input-height",
+            "Input Height",
+            "Height of the network input, in pixels",
+            16, 4096,
+            ObjectDetector::kDefaultCropHeight, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_INPUT_SCALE,
+        g_param_spec_float(
+            "input-scale",
+            "Input Scale",
+            "Factor input pixel values are multiplied by after the mean is subtracted",
+            0.0, G_MAXFLOAT,
+            ObjectDetector::kDefaultScale, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_INPUT_MEAN,
+        g_param_spec_float(
+            "input-mean",
+            "Input Mean",
+            "Value subtracted from every input channel",
+            0.0, 255.0,
+            ObjectDetector::kDefaultInputMean, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_SWAP_RB,
+        g_param_spec_boolean(
+            "swap-rb",
+            "Swap RB",
+            "Feed the network RGB rather than BGR input",
+            TRUE, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_REFINE_WIDTH,
+        g_param_spec_uint(
+            "refine-width",
+            "Refine Width",
+            "Width of the larger network input used in multi-scale mode "
+            "(0 = multi-scale mode off)",
+            0, 4096,
+            0, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_REFINE_HEIGHT,
+        g_param_spec_uint(
+            "refine-height",
+            "Refine Height",
+            "Height of the larger network input used in multi-scale mode "
+            "(0 = multi-scale mode off)",
+            0, 4096,
+            0, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_REFINE_INTERVAL,
+        g_param_spec_uint(
+            "refine-interval",
+            "Refine Interval",
+            "In multi-scale mode, run every Nth inference at the larger input "
+            "(0 = only after uncertain frames)",
+            0, G_MAXUINT,
+            0, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_REFINE_MARGIN,
+        g_param_spec_float(
+            "refine-margin",
+            "Refine Margin",
+            "In multi-scale mode, run the next inference at the larger input if "
+            "a detection scored within this distance of the confidence threshold "
+            "(0 = never)",
+            0.0, 1.0,
+            0.1, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_INFERENCE_INTERVAL,
+        g_param_spec_uint(
+            "inference-interval",
+            "Inference Interval",
+            "Run inference on one frame in every N and track the detections "
+            "through the frames in between (1 = every frame)",
+            1, 1000,
+            1, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_TRACK_IDS,
+        g_param_spec_boolean(
+            "track-ids",
+            "Track IDs",
+            "Assign stable track IDs, ages and velocities to detections across frames",
+            FALSE, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_TRACK_IOU_THRESHOLD,
+        g_param_spec_float(
+            "track-iou-threshold",
+            "Track IoU Threshold",
+            "Minimum IoU between a track's predicted box and a detection for them to match",
+            0.0, 1.0,
+            SortTracker::kDefaultIouThreshold, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_TRACK_MAX_AGE,
+        g_param_spec_uint(
+            "track-max-age",
+            "Track Max Age",
+            "Time in milliseconds a track is kept without a matching detection",
+            0, G_MAXUINT,
+            SortTracker::kDefaultMaxAgeMs, G_PARAM_READWRITE));
+
     gst_element_class_set_details_simple (gstelement_class,
         "OpencvDetector",
         "FIXME:Generic",
         "FIXME:Generic Template Element", "Robert Vaughan <<user@hostname.org>>");
 
+    gstelement_class->change_state = GST_DEBUG_FUNCPTR (gst_opencv_detector_change_state);
+
+    trans_class->stop = GST_DEBUG_FUNCPTR (gst_opencv_detector_stop);
+    trans_class->sink_event = GST_DEBUG_FUNCPTR (gst_opencv_detector_sink_event);
+    trans_class->src_event = GST_DEBUG_FUNCPTR (gst_opencv_detector_src_event);
+    trans_class->submit_input_buffer =
+        GST_DEBUG_FUNCPTR (gst_opencv_detector_submit_input_buffer);
+    trans_class->prepare_output_buffer =
+        GST_DEBUG_FUNCPTR (gst_opencv_detector_prepare_output_buffer);
+    trans_class->generate_output =
+        GST_DEBUG_FUNCPTR (gst_opencv_detector_generate_output);
+    trans_class->transform_ip = GST_DEBUG_FUNCPTR (gst_opencv_detector_transform_ip);
+
+    // Detections are attached to every frame, including in passthrough.
+    trans_class->transform_ip_on_passthrough = TRUE;
+
+    vfilter_class->set_info = GST_DEBUG_FUNCPTR (gst_opencv_detector_set_info);
+
     gst_element_class_add_pad_template (gstelement_class,
         gst_static_pad_template_get (&src_factory));
     gst_element_class_add_pad_template (gstelement_class,
@@ -281,8 +1004,6 @@ gst_opencv_detector_class_init (GstOpencvDetectorClass * klass)
 }
 
 /* initialize the new element
- * instantiate pads and add them to element
- * set pad callback functions
  * initialize instance structure
  */
 static void
@@ -290,22 +1011,67 @@ gst_opencv_detector_init (GstOpencvDetector * filter)
 {
     ObjectDetector* detector = new ObjectDetector();
 
-    filter->sinkpad = gst_pad_new_from_static_template (&sink_factory, "sink");
-    gst_pad_set_event_function (filter->sinkpad,
-        GST_DEBUG_FUNCPTR (gst_opencv_detector_sink_event));
-    gst_pad_set_chain_function (filter->sinkpad,
-        GST_DEBUG_FUNCPTR (gst_opencv_detector_chain));
-    GST_PAD_SET_PROXY_CAPS (filter->sinkpad);
-    gst_element_add_pad (GST_ELEMENT (filter), filter->sinkpad);
-
-    filter->srcpad = gst_pad_new_from_static_template (&src_factory, "src");
-    GST_PAD_SET_PROXY_CAPS (filter->srcpad);
-    gst_element_add_pad (GST_ELEMENT (filter), filter->srcpad);
-
     filter->silent = FALSE;
     filter->annotate = TRUE;
+    filter->roi_meta = FALSE;
+    filter->output_pool = nullptr;
+    filter->output_pool_negotiated = FALSE;
+    filter->inference_mode = GST_OPENCV_DETECTOR_INFERENCE_SYNC;
+    filter->num_workers = 1;
+    filter->qos = TRUE;
+    filter->qos_republish = FALSE;
+    filter->async_load = FALSE;
+    filter->map_model = FALSE;
+    filter->share_model = FALSE;
+    filter->backend = GST_OPENCV_DETECTOR_BACKEND_DEFAULT;
+    filter->target = GST_OPENCV_DETECTOR_TARGET_CPU;
+    filter->num_threads = 0;
+    filter->inference_affinity = 0;
+    filter->inference_priority = 0;
+    filter->int8_calibration = nullptr;
+    filter->tile_columns = 1;
+    filter->tile_rows = 1;
+    filter->tile_overlap = 0.25;
+    filter->input_geometry = GST_OPENCV_DETECTOR_INPUT_GEOMETRY_STRETCH;
+    filter->input_roi = cv::Rect();
+    filter->roi = nullptr;
+    filter->motion_threshold = 0.0;
+    filter->motion_min_interval = 0;
+    filter->motion_refresh_interval = 5000;
+    filter->target_latency_ms = 0;
+    filter->max_cpu_percent = 0;
+    filter->input_width = ObjectDetector::kDefaultCropWidth;
+    filter->input_height = ObjectDetector::kDefaultCropHeight;
+    filter->input_scale = ObjectDetector::kDefaultScale;
+    filter->input_mean = ObjectDetector::kDefaultInputMean;
+    filter->swap_rb = TRUE;
+    filter->refine_width = 0;
+    filter->refine_height = 0;
+    filter->refine_interval = 0;
+    filter->refine_margin = 0.1;
+    filter->inference_interval = 1;
+    filter->track_ids = FALSE;
+    filter->track_iou_threshold = SortTracker::kDefaultIouThreshold;
+    filter->track_max_age = SortTracker::kDefaultMaxAgeMs;
+    filter->loader_ = nullptr;
+    filter->model_dirty = FALSE;
+    filter->frame_late = FALSE;
+    filter->apply_detections = FALSE;
+    gst_opencv_detector_reset_qos (filter);
 
     filter->detector_ = detector;
+    filter->motion_gate_ = new MotionGate();
+    gst_opencv_detector_configure_motion_gate(filter);
+    filter->rate_controller_ = new RateController();
+    filter->flow_tracker_ = new FlowTracker();
+    filter->sort_tracker_ = new SortTracker();
+    filter->workers_ = new std::vector<ObjectDetector*>();
+
+    // Frames are annotated in place. Without annotation they are only read,
+    // so they pass through untouched.
+    gst_base_transform_set_in_place (GST_BASE_TRANSFORM (filter), TRUE);
+    gst_base_transform_set_passthrough (GST_BASE_TRANSFORM (filter), !filter->annotate);
+    gst_base_transform_set_qos_enabled (GST_BASE_TRANSFORM (filter), FALSE);
 }
 
 static void
@@ -315,9 +1081,28 @@ gst_opencv_detector_finalize(GObject *object)
     GstOpencvDetector *self = GST_OPENCVDETECTOR(object);
     (void)self;
 
+    // The worker uses the detector and publishes to the server, so it must
+    // be stopped first.
+    gst_opencv_detector_join_loader(self);
+    delete self->async_detector_;
+    delete self->pipelined_detector_;
+    for (ObjectDetector* worker : *self->workers_)
+    {
+        delete worker;
+    }
+    delete self->workers_;
     delete self->detector_;
+    delete self->motion_gate_;
+    delete self->rate_controller_;
+    delete self->flow_tracker_;
+    delete self->sort_tracker_;
     delete self->server_;
 
+    release_output_pool(&self->output_pool);
+
+    g_free(self->int8_calibration);
+    g_free(self->roi);
+
     return klass->finalize(object);
 }
 
@@ -389,6 +1174,7 @@ gst_opencv_detector_set_property (GObject * object, guint prop_id,
         break;
     case PROP_ANNOTATE:
         filter->annotate = g_value_get_boolean(value);
+        gst_base_transform_set_passthrough (GST_BASE_TRANSFORM (filter), !filter->annotate);
         break;
     case PROP_PORT:
         filter->port = g_value_get_int(value);
@@ -402,10 +1188,233 @@ gst_opencv_detector_set_property (GObject * object, guint prop_id,
     case PROP_NMS_THRESHOLD:
         filter->nms_threshold = g_value_get_float(value);
         break;
+    case PROP_INFERENCE_MODE:
+        filter->inference_mode =
+            static_cast<GstOpencvDetectorInferenceMode>(g_value_get_enum(value));
+        break;
+    case PROP_NUM_WORKERS:
+        filter->num_workers = g_value_get_uint(value);
+        break;
+    case PROP_ROI_META:
+        filter->roi_meta = g_value_get_boolean(value);
+        break;
+    case PROP_QOS:
+        GST_OBJECT_LOCK (filter);
+        filter->qos = g_value_get_boolean(value);
+        GST_OBJECT_UNLOCK (filter);
+        break;
+    case PROP_QOS_REPUBLISH:
+        filter->qos_republish = g_value_get_boolean(value);
+        break;
+    case PROP_ASYNC_LOAD:
+        filter->async_load = g_value_get_boolean(value);
+        break;
+    case PROP_MAP_MODEL:
+        filter->map_model = g_value_get_boolean(value);
+        break;
+    case PROP_SHARE_MODEL:
+        filter->share_model = g_value_get_boolean(value);
+        break;
+    case PROP_BACKEND:
+        filter->backend = static_cast<GstOpencvDetectorBackend>(g_value_get_enum(value));
+        break;
+    case PROP_TARGET:
+        filter->target = static_cast<GstOpencvDetectorTarget>(g_value_get_enum(value));
+        break;
+    case PROP_NUM_THREADS:
+        filter->num_threads = g_value_get_uint(value);
+        break;
+    case PROP_INFERENCE_AFFINITY:
+        filter->inference_affinity = g_value_get_uint64(value);
+        break;
+    case PROP_INFERENCE_PRIORITY:
+        filter->inference_priority = g_value_get_int(value);
+        break;
+    case PROP_INT8_CALIBRATION:
+        {
+            const gchar* calibration = g_value_get_string(value);
+            if (calibration && !g_file_test(calibration, G_FILE_TEST_IS_DIR))
+            {
+                GST_ELEMENT_WARNING(filter, RESOURCE, NOT_FOUND,
+                    ("Calibration directory not found at '%s'.", calibration),
+                    ("Directory not found."));
+            }
+            else
+            {
+                g_free(filter->int8_calibration);
+                filter->int8_calibration = g_strdup(calibration);
+            }
+        }
+        break;
+    case PROP_TILE_COLUMNS:
+        filter->tile_columns = g_value_get_uint(value);
+        break;
+    case PROP_TILE_ROWS:
+        filter->tile_rows = g_value_get_uint(value);
+        break;
+    case PROP_TILE_OVERLAP:
+        filter->tile_overlap = g_value_get_float(value);
+        break;
+    case PROP_INPUT_GEOMETRY:
+        filter->input_geometry =
+            static_cast<GstOpencvDetectorInputGeometry>(g_value_get_enum(value));
+        break;
+    case PROP_INPUT_ROI:
+        {
+            const gchar* roi = g_value_get_string(value);
+            int x = 0, y = 0, width = 0, height = 0;
+
+            if (roi == nullptr)
+            {
+                filter->input_roi = cv::Rect();
+            }
+            else if ((sscanf(roi, "%d,%d,%d,%d", &x, &y, &width, &height) == 4) &&
+                     (x >= 0) && (y >= 0) && (width > 0) && (height > 0))
+            {
+                filter->input_roi = cv::Rect(x, y, width, height);
+            }
+            else
+            {
+                GST_ELEMENT_WARNING(filter, RESOURCE, SETTINGS,
+                    ("Invalid input-roi '%s'.", roi),
+                    ("Expected \"x,y,width,height\" with a positive width and height."));
+            }
+        }
+        break;
+    case PROP_ROI:
+        {
+            const gchar* roi = g_value_get_string(value);
+            std::vector<std::vector<cv::Point>> regions;
+
+            if (parse_regions(roi, regions))
+            {
+                g_free(filter->roi);
+                filter->roi = regions.empty() ? nullptr : g_strdup(roi);
+            }
+            else
+            {
+                GST_ELEMENT_WARNING(filter, RESOURCE, SETTINGS,
+                    ("Invalid roi '%s'.", roi),
+                    ("Expected regions separated by ';', each \"x,y,width,height\" or "
+                     "at least three \"x,y\" vertices separated by spaces."));
+            }
+        }
+        break;
+    case PROP_MOTION_THRESHOLD:
+        filter->motion_threshold = g_value_get_float(value);
+        gst_opencv_detector_configure_motion_gate(filter);
+        break;
+    case PROP_MOTION_MIN_INTERVAL:
+        filter->motion_min_interval = g_value_get_uint(value);
+        gst_opencv_detector_configure_motion_gate(filter);
+        break;
+    case PROP_MOTION_REFRESH_INTERVAL:
+        filter->motion_refresh_interval = g_value_get_uint(value);
+        gst_opencv_detector_configure_motion_gate(filter);
+        break;
+    case PROP_TARGET_LATENCY_MS:
+        filter->target_latency_ms = g_value_get_uint(value);
+        filter->rate_controller_->configure(filter->target_latency_ms, filter->max_cpu_percent);
+        break;
+    case PROP_MAX_CPU_PERCENT:
+        filter->max_cpu_percent = g_value_get_uint(value);
+        filter->rate_controller_->configure(filter->target_latency_ms, filter->max_cpu_percent);
+        break;
+    case PROP_INPUT_WIDTH:
+        filter->input_width = g_value_get_uint(value);
+        break;
+    case PROP_INPUT_HEIGHT:
+        filter->input_height = g_value_get_uint(value);
+        break;
+    case PROP_INPUT_SCALE:
+        filter->input_scale = g_value_get_float(value);
+        break;
+    case PROP_INPUT_MEAN:
+        filter->input_mean = g_value_get_float(value);
+        break;
+    case PROP_SWAP_RB:
+        filter->swap_rb = g_value_get_boolean(value);
+        break;
+    case PROP_REFINE_WIDTH:
+        filter->refine_width = g_value_get_uint(value);
+        break;
+    case PROP_REFINE_HEIGHT:
+        filter->refine_height = g_value_get_uint(value);
+        break;
+    case PROP_REFINE_INTERVAL:
+        filter->refine_interval = g_value_get_uint(value);
+        break;
+    case PROP_REFINE_MARGIN:
+        filter->refine_margin = g_value_get_float(value);
+        break;
+    case PROP_INFERENCE_INTERVAL:
+        filter->inference_interval = g_value_get_uint(value);
+        filter->flow_tracker_->configure(filter->inference_interval);
+        break;
+    case PROP_TRACK_IDS:
+        filter->track_ids = g_value_get_boolean(value);
+        gst_opencv_detector_configure_sort_tracker(filter);
+        break;
+    case PROP_TRACK_IOU_THRESHOLD:
+        filter->track_iou_threshold = g_value_get_float(value);
+        gst_opencv_detector_configure_sort_tracker(filter);
+        break;
+    case PROP_TRACK_MAX_AGE:
+        filter->track_max_age = g_value_get_uint(value);
+        gst_opencv_detector_configure_sort_tracker(filter);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
     }
+
+    if (gst_opencv_detector_is_load_property (prop_id))
+    {
+        filter->model_dirty = TRUE;
+    }
+}
+
+/* Properties that are applied when the model is loaded. Changing one takes
+ * effect on the next NULL to READY transition.
+ */
+static gboolean
+gst_opencv_detector_is_load_property (guint prop_id)
+{
+    switch (prop_id) {
+    case PROP_CONFIGS_PATH:
+    case PROP_WEIGHTS_PATH:
+    case PROP_CLASS_NAMES_PATH:
+    case PROP_CONF_THRESHOLD:
+    case PROP_NMS_THRESHOLD:
+    case PROP_INFERENCE_MODE:
+    case PROP_NUM_WORKERS:
+    case PROP_MAP_MODEL:
+    case PROP_SHARE_MODEL:
+    case PROP_BACKEND:
+    case PROP_TARGET:
+    case PROP_NUM_THREADS:
+    case PROP_INFERENCE_AFFINITY:
+    case PROP_INFERENCE_PRIORITY:
+    case PROP_INT8_CALIBRATION:
+    case PROP_TILE_COLUMNS:
+    case PROP_TILE_ROWS:
+    case PROP_TILE_OVERLAP:
+    case PROP_INPUT_GEOMETRY:
+    case PROP_INPUT_ROI:
+    case PROP_ROI:
+    case PROP_INPUT_WIDTH:
+    case PROP_INPUT_HEIGHT:
+    case PROP_INPUT_SCALE:
+    case PROP_INPUT_MEAN:
+    case PROP_SWAP_RB:
+    case PROP_REFINE_WIDTH:
+    case PROP_REFINE_HEIGHT:
+    case PROP_REFINE_INTERVAL:
+    case PROP_REFINE_MARGIN:
+        return TRUE;
+    default:
+        return FALSE;
+    }
 }
 
 static void
@@ -442,6 +1451,131 @@ gst_opencv_detector_get_property (GObject * object, guint prop_id,
     case PROP_NMS_THRESHOLD:
         g_value_set_float(value, filter->nms_threshold);
         break;
+    case PROP_INFERENCE_MODE:
+        g_value_set_enum(value, filter->inference_mode);
+        break;
+    case PROP_NUM_WORKERS:
+        g_value_set_uint(value, filter->num_workers);
+        break;
+    case PROP_ROI_META:
+        g_value_set_boolean(value, filter->roi_meta);
+        break;
+    case PROP_QOS:
+        GST_OBJECT_LOCK (filter);
+        g_value_set_boolean(value, filter->qos);
+        GST_OBJECT_UNLOCK (filter);
+        break;
+    case PROP_QOS_REPUBLISH:
+        g_value_set_boolean(value, filter->qos_republish);
+        break;
+    case PROP_ASYNC_LOAD:
+        g_value_set_boolean(value, filter->async_load);
+        break;
+    case PROP_MAP_MODEL:
+        g_value_set_boolean(value, filter->map_model);
+        break;
+    case PROP_SHARE_MODEL:
+        g_value_set_boolean(value, filter->share_model);
+        break;
+    case PROP_BACKEND:
+        g_value_set_enum(value, filter->backend);
+        break;
+    case PROP_TARGET:
+        g_value_set_enum(value, filter->target);
+        break;
+    case PROP_NUM_THREADS:
+        g_value_set_uint(value, filter->num_threads);
+        break;
+    case PROP_INFERENCE_AFFINITY:
+        g_value_set_uint64(value, filter->inference_affinity);
+        break;
+    case PROP_INFERENCE_PRIORITY:
+        g_value_set_int(value, filter->inference_priority);
+        break;
+    case PROP_INT8_CALIBRATION:
+        g_value_set_string(value, filter->int8_calibration);
+        break;
+    case PROP_TILE_COLUMNS:
+        g_value_set_uint(value, filter->tile_columns);
+        break;
+    case PROP_TILE_ROWS:
+        g_value_set_uint(value, filter->tile_rows);
+        break;
+    case PROP_TILE_OVERLAP:
+        g_value_set_float(value, filter->tile_overlap);
+        break;
+    case PROP_INPUT_GEOMETRY:
+        g_value_set_enum(value, filter->input_geometry);
+        break;
+    case PROP_INPUT_ROI:
+        if (filter->input_roi.empty())
+        {
+            g_value_set_string(value, NULL);
+        }
+        else
+        {
+            g_value_take_string(value, g_strdup_printf("%d,%d,%d,%d",
+                filter->input_roi.x, filter->input_roi.y,
+                filter->input_roi.width, filter->input_roi.height));
+        }
+        break;
+    case PROP_ROI:
+        g_value_set_string(value, filter->roi);
+        break;
+    case PROP_MOTION_THRESHOLD:
+        g_value_set_float(value, filter->motion_threshold);
+        break;
+    case PROP_MOTION_MIN_INTERVAL:
+        g_value_set_uint(value, filter->motion_min_interval);
+        break;
+    case PROP_MOTION_REFRESH_INTERVAL:
+        g_value_set_uint(value, filter->motion_refresh_interval);
+        break;
+    case PROP_TARGET_LATENCY_MS:
+        g_value_set_uint(value, filter->target_latency_ms);
+        break;
+    case PROP_MAX_CPU_PERCENT:
+        g_value_set_uint(value, filter->max_cpu_percent);
+        break;
+    case PROP_INPUT_WIDTH:
+        g_value_set_uint(value, filter->input_width);
+        break;
+    case PROP_INPUT_HEIGHT:
+        g_value_set_uint(value, filter->input_height);
+        break;
+    case PROP_INPUT_SCALE:
+        g_value_set_float(value, filter->input_scale);
+        break;
+    case PROP_INPUT_MEAN:
+        g_value_set_float(value, filter->input_mean);
+        break;
+    case PROP_SWAP_RB:
+        g_value_set_boolean(value, filter->swap_rb);
+        break;
+    case PROP_REFINE_WIDTH:
+        g_value_set_uint(value, filter->refine_width);
+        break;
+    case PROP_REFINE_HEIGHT:
+        g_value_set_uint(value, filter->refine_height);
+        break;
+    case PROP_REFINE_INTERVAL:
+        g_value_set_uint(value, filter->refine_interval);
+        break;
+    case PROP_REFINE_MARGIN:
+        g_value_set_float(value, filter->refine_margin);
+        break;
+    case PROP_INFERENCE_INTERVAL:
+        g_value_set_uint(value, filter->inference_interval);
+        break;
+    case PROP_TRACK_IDS:
+        g_value_set_boolean(value, filter->track_ids);
+        break;
+    case PROP_TRACK_IOU_THRESHOLD:
+        g_value_set_float(value, filter->track_iou_threshold);
+        break;
+    case PROP_TRACK_MAX_AGE:
+        g_value_set_uint(value, filter->track_max_age);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -450,169 +1584,1034 @@ gst_opencv_detector_get_property (GObject * object, guint prop_id,
 
 /* GstElement vmethod implementations */
 
-/* this function handles sink events */
-static gboolean
-gst_opencv_detector_sink_event (GstPad * pad, GstObject * parent,
-    GstEvent * event)
+/* The server is bound and the model is loaded and warmed up before the first
+ * frame arrives, so that the first frame does not stall on them.
+ */
+static GstStateChangeReturn
+gst_opencv_detector_change_state (GstElement * element, GstStateChange transition)
 {
-    GstOpencvDetector *filter;
-    gboolean ret;
+    GstOpencvDetector *filter = GST_OPENCVDETECTOR (element);
+    GstStateChangeReturn ret;
 
-    filter = GST_OPENCVDETECTOR (parent);
-
-    GST_LOG_OBJECT (filter, "Received %s event: %" GST_PTR_FORMAT,
-            GST_EVENT_TYPE_NAME (event), event);
+    switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+        if (!gst_opencv_detector_start_server (filter))
+        {
+            return GST_STATE_CHANGE_FAILURE;
+        }
 
-    switch (GST_EVENT_TYPE (event)) {
-        case GST_EVENT_CAPS:
+        if (!filter->async_load && !gst_opencv_detector_load_model (filter))
+        {
+            // The element stays in NULL, so READY to NULL does not run.
+            gst_opencv_detector_stop_server (filter);
+            return GST_STATE_CHANGE_FAILURE;
+        }
+        break;
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+        // The server is released if a previous asynchronous load failed.
+        if (!gst_opencv_detector_start_server (filter))
         {
-            GstCaps *caps;
+            return GST_STATE_CHANGE_FAILURE;
+        }
+        break;
+    default:
+        break;
+    }
 
-            gst_event_parse_caps (event, &caps);
-            /* do something with the caps */
-            for (guint i = 0; i < gst_caps_get_size(caps); i++) {
-                GstStructure* s = gst_caps_get_structure(caps, i);
+    ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+    if (ret == GST_STATE_CHANGE_FAILURE)
+    {
+        return ret;
+    }
 
-                // Caps are expected to appear in the following format:
-                // video/x-raw,
-                //     format=(string)NV21,
-                //     width=(int)1280,
-                //     height=(int)720,
-                //     colorimetry=(string)bt709,
-                //     framerate=(fraction)30/1;
+    switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+        if (filter->async_load && !filter->detector_->is_initialized() &&
+            (filter->loader_ == nullptr))
+        {
+            // The element reaches PAUSED once the loader has finished, and
+            // the parent bin waits for async-done before it completes its
+            // own state change. Frames that arrive before then wait on the
+            // load.
+            gst_element_post_message (element,
+                gst_message_new_async_start (GST_OBJECT_CAST (element)));
 
-                g_print("Received caps for %s\n", gst_structure_get_name(s));
+            filter->loader_ = new std::thread(gst_opencv_detector_load_model_async, filter);
 
-                if (gst_structure_has_name(s, "video/x-raw"))
-                {
-                    gchar* serialized = gst_structure_to_string(s);
-                    g_print("  Serialized: <begin>%s<end>\n", serialized);
-                    g_free(serialized);
+            ret = GST_STATE_CHANGE_ASYNC;
+        }
+        break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+        gst_opencv_detector_join_loader (filter);
+        break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+        // Going down while still loading skips PAUSED to READY.
+        gst_opencv_detector_join_loader (filter);
 
-                    if (gst_structure_has_field(s, "format"))
-                    {
-                        const gchar* format_string = gst_structure_get_string(s, "format");
-                        if (format_string) {
-                            filter->format = gst_video_format_from_string(format_string);
-                            g_print("   Format = %s\n", gst_structure_get_name(s));
-                        }
-                    }
-                    else
-                    {
-                        g_print("   MISSING format");
-                    }
+        // The model stays loaded so that a restart does not pay for it
+        // again, unless a property it was loaded with changes.
+        gst_opencv_detector_stop_server (filter);
+        break;
+    default:
+        break;
+    }
 
-                    if (gst_structure_has_field(s, "width"))
-                    {
-                        gint width = -1;
-                        if (gst_structure_get_int(s, "width", &width))
-                        {
-                            filter->width = width;
-                            g_print("   Width = %d\n", width);
-                        } 
-                    }
-                    else
-                    {
-                        g_print("   MISSING width");
-                    }
+    return ret;
+}
 
-                    if (gst_structure_has_field(s, "height"))
-                    {
-                        gint height = -1;
-                        if (gst_structure_get_int(s, "height", &height)) {
-                            filter->height = height;
-                            g_print("   Height = %d\n", height);
-                        }
-                    }
-                    else
+/* Load and warm up the model, unless it is already loaded with the current
+ * properties. Posts an element error on failure.
+ */
+static gboolean
+gst_opencv_detector_load_model (GstOpencvDetector * filter)
+{
+    if (filter->detector_->is_initialized())
+    {
+        if (!filter->model_dirty)
+        {
+            return TRUE;
+        }
+
+        GST_INFO_OBJECT (filter, "Model properties changed, reloading the model");
+        gst_opencv_detector_release_model (filter);
+    }
+
+    // Properties changed from here on apply to the next load.
+    filter->model_dirty = FALSE;
+
+    ObjectDetector* detector = filter->detector_;
+
+    if (!filter->configs_path || !filter->weights_path || !filter->class_names_path)
+    {
+        GST_ELEMENT_ERROR (filter, RESOURCE, NOT_FOUND,
+            ("No detection model configured."),
+            ("The configs, weights and classes properties must all be set."));
+        return FALSE;
+    }
+
+    gint64 start_time = g_get_monotonic_time ();
+
+    gst_opencv_detector_configure_detector (filter, *detector);
+
+    // OpenCV has one thread pool for the whole process, so it is only
+    // resized if asked to.
+    if (filter->num_threads > 0)
+    {
+        cv::setNumThreads(static_cast<int>(filter->num_threads));
+    }
+
+    cv::Size input_size(static_cast<int>(filter->input_width),
+        static_cast<int>(filter->input_height));
+
+    if (!detector->initialize(
+            filter->configs_path,
+            filter->weights_path,
+            filter->class_names_path,
+            filter->conf_threshold,
+            filter->nms_threshold,
+            input_size,
+            filter->input_scale,
+            filter->input_mean,
+            filter->swap_rb))
+    {
+        GST_ELEMENT_ERROR (filter, RESOURCE, OPEN_READ,
+            ("Failed to load detection model."),
+            ("configs '%s', weights '%s', classes '%s'", filter->configs_path,
+                filter->weights_path, filter->class_names_path));
+        return FALSE;
+    }
+
+    // Frames are mapped read-only for detection. Annotation is drawn on the
+    // outgoing buffer afterwards, and only if there is something to draw.
+    detector->set_annotate(false);
+
+    gint64 load_time = g_get_monotonic_time ();
+
+    if (!detector->warm_up())
+    {
+        GST_ELEMENT_WARNING (filter, STREAM, FAILED,
+            ("Warm-up inference failed."),
+            ("The first frame will include network setup time."));
+    }
+
+    gint64 warm_up_time = g_get_monotonic_time ();
+
+    GST_INFO_OBJECT (filter, "Loaded model in %" G_GINT64_FORMAT " ms, warm-up took %"
+        G_GINT64_FORMAT " ms", (load_time - start_time) / 1000,
+        (warm_up_time - load_time) / 1000);
+
+    // Only the pipelined mode runs inference on more than one detector.
+    if (filter->inference_mode == GST_OPENCV_DETECTOR_INFERENCE_PIPELINED)
+    {
+        gst_opencv_detector_load_workers (filter);
+    }
+    else if (filter->num_workers > 1)
+    {
+        GST_ELEMENT_WARNING (filter, RESOURCE, SETTINGS,
+            ("num-workers has no effect in this inference mode."),
+            ("Only the pipelined mode uses more than one worker; %u requested.",
+                filter->num_workers));
+    }
+
+    GST_INFO_OBJECT (filter, "Loaded models:\n%s",
+        ModelRegistry::instance().memory_report().c_str());
+
+    return TRUE;
+}
+
+/* Release the model and the workers. The element must be in READY or NULL,
+ * so that no worker thread uses them.
+ */
+static void
+gst_opencv_detector_release_model (GstOpencvDetector * filter)
+{
+    for (ObjectDetector* worker : *filter->workers_)
+    {
+        delete worker;
+    }
+    filter->workers_->clear();
+
+    delete filter->detector_;
+    filter->detector_ = new ObjectDetector();
+}
+
+/* Load and warm up the additional detectors that the pipelined mode runs
+ * inference on, on the same thread as the model. Each worker runs its own
+ * copy of the network. With share-model, it is shared with the same worker
+ * of any other detector in the process.
+ */
+static void
+gst_opencv_detector_load_workers (GstOpencvDetector * filter)
+{
+    std::vector<ObjectDetector*>& workers = *filter->workers_;
+
+    cv::Size input_size(static_cast<int>(filter->input_width),
+        static_cast<int>(filter->input_height));
+
+    for (guint index = 1; index < filter->num_workers; ++index)
+    {
+        ObjectDetector* worker = new ObjectDetector();
+        worker->set_model_replica(index);
+        gst_opencv_detector_configure_detector(filter, *worker);
+
+        if (!worker->initialize(
+                filter->configs_path,
+                filter->weights_path,
+                filter->class_names_path,
+                filter->conf_threshold,
+                filter->nms_threshold,
+                input_size,
+                filter->input_scale,
+                filter->input_mean,
+                filter->swap_rb))
+        {
+            GST_WARNING_OBJECT(filter, "Failed to initialize detector worker %u", index);
+            delete worker;
+            continue;
+        }
+
+        if (!worker->warm_up())
+        {
+            GST_WARNING_OBJECT(filter, "Warm-up of detector worker %u failed", index);
+        }
+
+        workers.push_back(worker);
+    }
+}
+
+/* Apply the loading, backend and thread settings to a detector that has not
+ * been initialized yet.
+ */
+static void
+gst_opencv_detector_configure_detector (GstOpencvDetector * filter,
+    ObjectDetector & detector)
+{
+    detector.set_map_files(filter->map_model);
+    detector.set_share_model(filter->share_model);
+    detector.set_calibration_dir(filter->int8_calibration);
+
+    // The regions of interest replace the input geometry: only their
+    // bounding box is detected, and only detections inside them are kept.
+    std::vector<std::vector<cv::Point>> regions;
+    parse_regions(filter->roi, regions);
+
+    if (regions.empty())
+    {
+        detector.set_input_geometry(
+            static_cast<InputGeometry>(filter->input_geometry), filter->input_roi);
+    }
+    else
+    {
+        std::vector<cv::Point> points;
+        for (const auto& region : regions)
+        {
+            points.insert(points.end(), region.begin(), region.end());
+        }
+
+        detector.set_input_geometry(InputGeometry::Roi, cv::boundingRect(points));
+    }
+
+    detector.set_detection_mask(regions);
+
+    detector.set_tiling(static_cast<int>(filter->tile_columns),
+        static_cast<int>(filter->tile_rows), filter->tile_overlap);
+    detector.set_refinement(
+        cv::Size(static_cast<int>(filter->refine_width), static_cast<int>(filter->refine_height)),
+        filter->refine_interval,
+        filter->refine_margin);
+
+    int backend = gst_opencv_detector_dnn_backend (filter->backend);
+    int target = gst_opencv_detector_dnn_target (filter->target);
+
+    if ((backend < 0) || (target < 0) || !detector.set_backend(backend, target))
+    {
+        GST_ELEMENT_WARNING (filter, RESOURCE, SETTINGS,
+            ("DNN backend or target is not available."),
+            ("OpenCV does not support the %s backend with the %s target; "
+             "using the default backend on the CPU.",
+             g_enum_get_value (static_cast<GEnumClass*>(g_type_class_peek (
+                GST_TYPE_OPENCV_DETECTOR_BACKEND)), filter->backend)->value_nick,
+             g_enum_get_value (static_cast<GEnumClass*>(g_type_class_peek (
+                GST_TYPE_OPENCV_DETECTOR_TARGET)), filter->target)->value_nick));
+    }
+
+    ThreadSettings settings;
+    settings.cpu_mask = filter->inference_affinity;
+    settings.priority = filter->inference_priority;
+    detector.set_thread_settings(settings);
+}
+
+/* Loader thread entry point. Completes the READY to PAUSED transition, or
+ * aborts it if the model cannot be loaded (the error has been posted).
+ */
+static void
+gst_opencv_detector_load_model_async (GstOpencvDetector * filter)
+{
+    GstElement* element = GST_ELEMENT_CAST (filter);
+
+    if (!gst_opencv_detector_load_model (filter))
+    {
+        // Release the port, so that it is free if the application gives up
+        // on the element rather than taking it back to NULL.
+        gst_opencv_detector_stop_server (filter);
+        gst_element_abort_state (element);
+        return;
+    }
+
+    gst_element_continue_state (element, GST_STATE_CHANGE_SUCCESS);
+
+    gst_element_post_message (element,
+        gst_message_new_async_done (GST_OBJECT_CAST (filter), GST_CLOCK_TIME_NONE));
+}
+
+/* Wait for a pending asynchronous load to finish. */
+static void
+gst_opencv_detector_join_loader (GstOpencvDetector * filter)
+{
+    if (filter->loader_)
+    {
+        filter->loader_->join();
+        delete filter->loader_;
+        filter->loader_ = nullptr;
+    }
+}
+
+/* Bind the detections server if a port is set. Posts an element error on
+ * failure.
+ */
+static gboolean
+gst_opencv_detector_start_server (GstOpencvDetector * filter)
+{
+    if (!filter->port || filter->server_)
+    {
+        return TRUE;
+    }
+
+    try
+    {
+        filter->server_ = new detections_list_server(filter->port, static_cast<size_t>(filter->max_subscribers));
+    }
+    catch (const std::exception& e)
+    {
+        GST_ELEMENT_ERROR (filter, RESOURCE, OPEN_READ_WRITE,
+            ("Failed to start the detections server on port %u.", filter->port),
+            ("%s", e.what()));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Release the detections server and its port. */
+static void
+gst_opencv_detector_stop_server (GstOpencvDetector * filter)
+{
+    delete filter->server_;
+    filter->server_ = nullptr;
+}
+
+/* GstBaseTransform vmethod implementations */
+
+/* Release the workers when the element stops. They are created again on the
+ * next buffer.
+ */
+static gboolean
+gst_opencv_detector_stop (GstBaseTransform * trans)
+{
+    GstOpencvDetector *filter = GST_OPENCVDETECTOR (trans);
+
+    delete filter->async_detector_;
+    filter->async_detector_ = nullptr;
+
+    delete filter->pipelined_detector_;
+    filter->pipelined_detector_ = nullptr;
+
+    release_output_pool (&filter->output_pool);
+    filter->output_pool_negotiated = FALSE;
+
+    gst_opencv_detector_reset_qos (filter);
+    filter->motion_gate_->reset ();
+    filter->rate_controller_->reset ();
+    filter->flow_tracker_->reset ();
+    filter->sort_tracker_->reset ();
+
+    return TRUE;
+}
+
+/* this function handles sink events */
+static gboolean
+gst_opencv_detector_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+    GstOpencvDetector *filter = GST_OPENCVDETECTOR (trans);
+
+    GST_LOG_OBJECT (filter, "Received %s event: %" GST_PTR_FORMAT,
+            GST_EVENT_TYPE_NAME (event), event);
+
+    // Serialized events must stay behind the frames that are still in the
+    // stage pipeline.
+    if (filter->pipelined_detector_ && GST_EVENT_IS_SERIALIZED (event))
+    {
+        if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+        {
+            gst_opencv_detector_discard_completed (filter);
+        }
+        else
+        {
+            gst_opencv_detector_drain_completed (filter);
+        }
+    }
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+    {
+        gst_opencv_detector_reset_qos (filter);
+        filter->motion_gate_->reset ();
+        filter->flow_tracker_->reset ();
+        filter->sort_tracker_->reset ();
+    }
+
+    return GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event (trans, event);
+}
+
+/* Track QoS reports from downstream. The earliest time is the running time
+ * before which frames can no longer be displayed in time.
+ */
+static gboolean
+gst_opencv_detector_src_event (GstBaseTransform * trans, GstEvent * event)
+{
+    GstOpencvDetector *filter = GST_OPENCVDETECTOR (trans);
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_QOS)
+    {
+        gdouble proportion;
+        GstClockTimeDiff diff;
+        GstClockTime timestamp;
+
+        gst_event_parse_qos (event, NULL, &proportion, &diff, &timestamp);
+
+        GST_OBJECT_LOCK (filter);
+        filter->qos_proportion = proportion;
+        if (GST_CLOCK_TIME_IS_VALID (timestamp) &&
+            ((diff >= 0) || (timestamp > static_cast<GstClockTime>(-diff))))
+        {
+            filter->qos_earliest_time = timestamp + diff;
+        }
+        else
+        {
+            filter->qos_earliest_time = GST_CLOCK_TIME_NONE;
+        }
+        GST_OBJECT_UNLOCK (filter);
+
+        GST_LOG_OBJECT (filter, "QoS proportion %f, diff %" GST_STIME_FORMAT
+            ", timestamp %" GST_TIME_FORMAT, proportion, GST_STIME_ARGS (diff),
+            GST_TIME_ARGS (timestamp));
+    }
+
+    return GST_BASE_TRANSFORM_CLASS (parent_class)->src_event (trans, event);
+}
+
+/* Decide whether the incoming frame is too late for inference. Late frames
+ * are still queued and pushed downstream, so that the upstream queue drains
+ * instead of growing.
+ */
+static GstFlowReturn
+gst_opencv_detector_submit_input_buffer (GstBaseTransform * trans,
+    gboolean is_discont, GstBuffer * input)
+{
+    GstOpencvDetector *filter = GST_OPENCVDETECTOR (trans);
+
+    GstClockTime timestamp = GST_BUFFER_PTS (input);
+    GstClockTime running_time = GST_CLOCK_TIME_NONE;
+
+    if (GST_CLOCK_TIME_IS_VALID (timestamp) && (trans->segment.format == GST_FORMAT_TIME))
+    {
+        running_time = gst_segment_to_running_time (&trans->segment,
+            GST_FORMAT_TIME, timestamp);
+    }
+
+    GST_OBJECT_LOCK (filter);
+
+    GstClockTime earliest_time = filter->qos_earliest_time;
+
+    filter->frame_late = filter->qos &&
+        GST_CLOCK_TIME_IS_VALID (running_time) &&
+        GST_CLOCK_TIME_IS_VALID (earliest_time) &&
+        (running_time <= earliest_time);
+
+    if (filter->frame_late)
+    {
+        filter->qos_dropped++;
+    }
+    else
+    {
+        filter->qos_processed++;
+    }
+
+    guint64 processed = filter->qos_processed;
+    guint64 dropped = filter->qos_dropped;
+    gdouble proportion = filter->qos_proportion;
+
+    GST_OBJECT_UNLOCK (filter);
+
+    if (filter->frame_late)
+    {
+        GST_DEBUG_OBJECT (filter, "Skipping inference on frame at %" GST_TIME_FORMAT
+            " (earliest %" GST_TIME_FORMAT ")", GST_TIME_ARGS (running_time),
+            GST_TIME_ARGS (earliest_time));
+
+        GstClockTime stream_time = gst_segment_to_stream_time (&trans->segment,
+            GST_FORMAT_TIME, timestamp);
+
+        GstMessage* message = gst_message_new_qos (GST_OBJECT_CAST (filter), FALSE,
+            running_time, stream_time, timestamp, GST_BUFFER_DURATION (input));
+        gst_message_set_qos_values (message,
+            GST_CLOCK_DIFF (running_time, earliest_time), proportion, 1000000);
+        gst_message_set_qos_stats (message, GST_FORMAT_BUFFERS, processed, dropped);
+        gst_element_post_message (GST_ELEMENT_CAST (filter), message);
+    }
+
+    return GST_BASE_TRANSFORM_CLASS (parent_class)->submit_input_buffer (
+        trans, is_discont, input);
+}
+
+/* Sync mode: detect on the input, which is only read, then pick the buffer
+ * that transform_ip works on. The frame is only copied when there are
+ * detections to draw on it, and the buffer when there are detections to
+ * attach to it.
+ */
+static GstFlowReturn
+gst_opencv_detector_prepare_output_buffer (GstBaseTransform * trans,
+    GstBuffer * input, GstBuffer ** outbuf)
+{
+    GstOpencvDetector *filter = GST_OPENCVDETECTOR (trans);
+
+    filter->apply_detections = gst_opencv_detector_detect_frame (filter, input) &&
+        (filter->detection_list.detections.size() > 0);
+
+    const gboolean draw = filter->apply_detections && filter->annotate &&
+        !gst_base_transform_is_passthrough (trans);
+    const gboolean attach = filter->apply_detections && filter->roi_meta;
+
+    if (gst_buffer_is_writable (input) || (!draw && !attach))
+    {
+        *outbuf = input;
+    }
+    else if (!draw)
+    {
+        // Attaching metadata needs a writable buffer, but a shallow copy
+        // shares the frame memory.
+        *outbuf = gst_buffer_copy (input);
+    }
+    else
+    {
+        // Copy into a buffer from the output pool rather than the heap.
+        *outbuf = make_frame_writable (gst_buffer_ref (input),
+            GST_VIDEO_FILTER (filter)->in_info,
+            gst_opencv_detector_get_output_pool (filter));
+    }
+
+    return GST_FLOW_OK;
+}
+
+/* Sync mode: draw and attach the detections that prepare_output_buffer found.
+ * The frame is only mapped for writing when there is something to draw.
+ */
+static GstFlowReturn
+gst_opencv_detector_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+{
+    GstOpencvDetector *filter = GST_OPENCVDETECTOR (trans);
+    const DetectionList& detection_list = filter->detection_list;
+
+    if (!filter->apply_detections)
+    {
+        return GST_FLOW_OK;
+    }
+
+    if (filter->annotate && !gst_base_transform_is_passthrough (trans))
+    {
+        ScopedBufferMap scoped_buffer(buf, GST_VIDEO_FILTER (filter)->in_info, GST_MAP_READWRITE);
+        if (!scoped_buffer.frame().empty())
+        {
+            filter->detector_->annotate(detection_list, scoped_buffer.frame());
+        }
+    }
+
+    if (filter->roi_meta)
+    {
+        attach_roi_meta(buf, detection_list);
+    }
+
+    return GST_FLOW_OK;
+}
+
+/* In sync mode frames go through the base class (prepare_output_buffer and
+ * transform_ip). The latest and pipelined modes hand frames to worker
+ * threads and produce output buffers here instead. The base class calls this
+ * repeatedly until no buffer is returned.
+ */
+static GstFlowReturn
+gst_opencv_detector_generate_output (GstBaseTransform * trans, GstBuffer ** outbuf)
+{
+    GstOpencvDetector *filter = GST_OPENCVDETECTOR (trans);
+
+    if (!gst_opencv_detector_ensure_initialized (filter))
+    {
+        return GST_FLOW_ERROR;
+    }
+
+    if (filter->inference_mode == GST_OPENCV_DETECTOR_INFERENCE_SYNC)
+    {
+        return GST_BASE_TRANSFORM_CLASS (parent_class)->generate_output (trans, outbuf);
+    }
+
+    ObjectDetector* detector = filter->detector_;
+    const GstVideoInfo& info = GST_VIDEO_FILTER (filter)->in_info;
+
+    GstBuffer* buf = trans->queued_buf;
+    trans->queued_buf = NULL;
+
+    *outbuf = NULL;
+
+    if (filter->inference_mode == GST_OPENCV_DETECTOR_INFERENCE_LATEST)
+    {
+        if (buf == NULL)
+        {
+            return GST_FLOW_OK;
+        }
+
+        if (filter->async_detector_ == nullptr)
+        {
+            detections_list_server* server = filter->server_;
+
+            filter->async_detector_ = new AsyncDetector(*detector,
+                [filter, server](DetectionList& detection_list)
+                {
+                    gst_opencv_detector_finish_detections(filter, detection_list);
+
+                    if (server)
                     {
-                        g_print("   MISSING height");
+                        server->publish(detection_list);
                     }
+                });
+        }
 
-                    if (gst_structure_has_field_typed(s, "colorimetry", G_TYPE_STRING)) {
-                        g_print("   Colorimetry = %s\n", gst_structure_get_string(s, "colorimetry"));
-                    } else {
-                        g_print("   MISSING colorimetry\n");
-                    }
-                }
+        if (filter->frame_late)
+        {
+            if (filter->qos_republish && filter->server_)
+            {
+                filter->async_detector_->republish();
             }
+        }
+        else if (!gst_opencv_detector_needs_tracking (filter) &&
+                 gst_opencv_detector_needs_inference (filter, buf, NULL))
+        {
+            filter->async_detector_->submit(buf, info);
+        }
+        else if (filter->server_)
+        {
+            filter->async_detector_->republish();
+        }
 
-            /* and forward */
-            ret = gst_pad_event_default (pad, parent, event);
-            break;
+        *outbuf = gst_opencv_detector_annotate_latest (filter, buf);
+
+        return GST_FLOW_OK;
+    }
+
+    if (filter->pipelined_detector_ == nullptr)
+    {
+        filter->pipelined_detector_ = new PipelinedDetector(
+            *detector, *filter->workers_, filter->server_, filter->annotate, filter->roi_meta);
+
+        filter->pipelined_detector_->set_finish_callback(
+            [filter](DetectionList& detection_list)
+            {
+                gst_opencv_detector_finish_detections(filter, detection_list);
+            });
+
+        filter->pipelined_detector_->set_tracker(filter->flow_tracker_);
+    }
+
+    PipelinedDetector* pipeline = filter->pipelined_detector_;
+
+    if (buf != NULL)
+    {
+        GstBufferPool* pool = filter->annotate ?
+            gst_opencv_detector_get_output_pool(filter) : nullptr;
+
+        PipelinedDetector::FrameAction action = PipelinedDetector::FrameAction::Detect;
+
+        if (filter->frame_late)
+        {
+            action = filter->qos_republish ?
+                PipelinedDetector::FrameAction::Reuse : PipelinedDetector::FrameAction::Skip;
+        }
+        else if (gst_opencv_detector_needs_tracking (filter))
+        {
+            action = PipelinedDetector::FrameAction::Track;
+        }
+        else if (!gst_opencv_detector_needs_inference (filter, buf, NULL))
+        {
+            action = PipelinedDetector::FrameAction::Reuse;
+        }
+
+        if (!pipeline->submit(buf, info, pool, action))
+        {
+            return GST_FLOW_FLUSHING;
         }
-        default:
-            ret = gst_pad_event_default (pad, parent, event);
-            break;
     }
-    return ret;
+
+    // Only wait on the pipeline when it is full.
+    *outbuf = pipeline->pop(pipeline->in_flight() >= pipeline->depth());
+
+    return GST_FLOW_OK;
 }
 
-/* chain function
- * this function does the actual processing
+/* GstVideoFilter vmethod implementations */
+
+static gboolean
+gst_opencv_detector_set_info (GstVideoFilter * vfilter, GstCaps * incaps,
+    GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
+{
+    GstOpencvDetector *filter = GST_OPENCVDETECTOR (vfilter);
+    (void)incaps;
+    (void)outcaps;
+    (void)out_info;
+
+    GST_INFO_OBJECT (filter, "Negotiated %s %dx%d",
+        gst_video_format_to_string (GST_VIDEO_INFO_FORMAT (in_info)),
+        GST_VIDEO_INFO_WIDTH (in_info),
+        GST_VIDEO_INFO_HEIGHT (in_info));
+
+    // The output pool is renegotiated for the new caps on first use.
+    release_output_pool (&filter->output_pool);
+    filter->output_pool_negotiated = FALSE;
+
+    // A new format or size starts a new reference frame.
+    filter->motion_gate_->reset ();
+    filter->flow_tracker_->reset ();
+    filter->sort_tracker_->reset ();
+
+    return TRUE;
+}
+
+/* Wait for the model if it is still being loaded. Returns TRUE if the
+ * detector is ready. Otherwise, an error has already been posted.
  */
-static GstFlowReturn
-gst_opencv_detector_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+static gboolean
+gst_opencv_detector_ensure_initialized (GstOpencvDetector * filter)
 {
-    GstOpencvDetector *filter;
-    (void)pad;
+    gst_opencv_detector_join_loader (filter);
 
-    filter = GST_OPENCVDETECTOR (parent);
+    return filter->detector_->is_initialized();
+}
 
-    ObjectDetector* detector = filter->detector_;
+/* Apply the motion properties to the gate. */
+static void
+gst_opencv_detector_configure_motion_gate (GstOpencvDetector * filter)
+{
+    filter->motion_gate_->configure (filter->motion_threshold,
+        filter->motion_min_interval, filter->motion_refresh_interval);
+}
 
-    // Attempt to initialize the filter state.
-    if (!detector->is_initialized())
+/* Apply the track properties to the SORT tracker. */
+static void
+gst_opencv_detector_configure_sort_tracker (GstOpencvDetector * filter)
+{
+    filter->sort_tracker_->configure (filter->track_ids,
+        filter->track_iou_threshold, filter->track_max_age);
+}
+
+/* Decide whether inference runs on a frame that is in time. The rate
+ * controller skips frames to stay within its budget, and the motion gate
+ * skips frames where nothing has moved. The motion gate uses the mapped view
+ * if there is one (sync mode), and otherwise maps the buffer itself.
+ */
+static gboolean
+gst_opencv_detector_needs_inference (GstOpencvDetector * filter, GstBuffer * buf,
+    const FrameView * view)
+{
+    if (!filter->rate_controller_->should_detect())
     {
-        detector->initialize(
-            filter->configs_path,
-            filter->weights_path,
-            filter->class_names_path,
-            filter->conf_threshold,
-            filter->nms_threshold
-        );
+        GST_LOG_OBJECT (filter, "Reusing detections to stay within budget");
+        return FALSE;
+    }
 
-        detector->set_annotate(filter->annotate);
+    MotionGate* gate = filter->motion_gate_;
+
+    if (!gate->enabled())
+    {
+        return TRUE;
     }
 
-    if (filter->port && (filter->server_ == nullptr))
+    gboolean changed = FALSE;
+
+    if (view != NULL)
     {
-        filter->server_ = new detections_list_server(filter->port, static_cast<size_t>(filter->max_subscribers));
+        changed = gate->update (*view);
+    }
+    else
+    {
+        ScopedBufferMap scoped_buffer (buf, GST_VIDEO_FILTER (filter)->in_info);
+        changed = gate->update (scoped_buffer.view());
     }
 
-    if (detector->is_initialized())
+    if (!changed)
     {
-        ScopedBufferMap scoped_buffer(buf, filter->width, filter->height, filter->format);
+        GST_LOG_OBJECT (filter, "Reusing detections (motion score %.4f)", gate->score());
+    }
 
-        cv::Mat working_image = scoped_buffer.frame();
+    return changed;
+}
 
-        DetectionList& detection_list = filter->detection_list;
+/* Decide whether a frame that is in time falls between two inferences of
+ * the fixed inference interval. Such frames get the last detections moved
+ * onto them by the tracker instead.
+ */
+static gboolean
+gst_opencv_detector_needs_tracking (GstOpencvDetector * filter)
+{
+    FlowTracker* tracker = filter->flow_tracker_;
+
+    return tracker->enabled() && !tracker->should_detect();
+}
 
-        detection_list.detections.clear();
-        if (!detector->get_objects(working_image, detection_list))
+/* Sync mode: detect, track or reuse the detections of a frame, then publish
+ * them. The frame is only read. Returns FALSE if the frame is forwarded as is.
+ */
+static gboolean
+gst_opencv_detector_detect_frame (GstOpencvDetector * filter, GstBuffer * buf)
+{
+    ObjectDetector* detector = filter->detector_;
+    DetectionList& detection_list = filter->detection_list;
+
+    if (filter->frame_late)
+    {
+        // The frame is forwarded as is, or with the last detections.
+        if (!filter->qos_republish)
         {
-            g_print("ERROR while attempting to get detections!\n");
+            return FALSE;
+        }
+
+        ObjectDetector::reuse_detections(detection_list);
+    }
+    else
+    {
+        ScopedBufferMap scoped_buffer(buf, GST_VIDEO_FILTER (filter)->in_info);
+        const FrameView& view = scoped_buffer.view();
+
+        if (gst_opencv_detector_needs_tracking (filter))
+        {
+            if (!filter->flow_tracker_->track (view, detection_list))
+            {
+                ObjectDetector::reuse_detections(detection_list);
+            }
+        }
+        else if (!gst_opencv_detector_needs_inference (filter, NULL, &view))
+        {
+            ObjectDetector::reuse_detections(detection_list);
         }
         else
         {
-            g_print("FOUND %lu objects.\n", detection_list.detections.size());
+            detection_list.detections.clear();
+
+            // The streaming thread only has the inference settings while it
+            // runs inference.
+            ScopedThreadSettings scoped_settings(detector->thread_settings());
+
+            if (!detector->get_objects(view, detection_list))
+            {
+                GST_WARNING_OBJECT (filter, "Failed to get detections");
+            }
+            else
+            {
+                GST_LOG_OBJECT (filter, "Found %zu objects", detection_list.detections.size());
+                filter->flow_tracker_->start (view, detection_list);
+            }
         }
+    }
+
+    gst_opencv_detector_finish_detections (filter, detection_list);
+
+    if (filter->server_)
+    {
+        filter->server_->publish(detection_list);
+    }
+
+    return TRUE;
+}
 
-        if (filter->server_)
+/* Assign track IDs, feed the inference time of detected frames to the rate
+ * controller and record its operating point in every list before it is
+ * published. Called from one thread at a time, in frame order: the streaming
+ * thread or the stage pipeline in sync and pipelined modes, and the
+ * AsyncDetector worker in latest mode.
+ */
+static void
+gst_opencv_detector_finish_detections (GstOpencvDetector * filter,
+    DetectionList & detection_list)
+{
+    filter->sort_tracker_->update (detection_list);
+
+    if (!detection_list.info.reused)
+    {
+        filter->rate_controller_->report (detection_list.info.elapsed_time_ms);
+    }
+
+    filter->rate_controller_->stamp (detection_list);
+
+    // The controller only sees the frames the tracker leaves to inference.
+    detection_list.info.inference_interval *= std::max(1u, filter->inference_interval);
+}
+
+/* Forget the last QoS report and restart the frame counts. */
+static void
+gst_opencv_detector_reset_qos (GstOpencvDetector * filter)
+{
+    GST_OBJECT_LOCK (filter);
+    filter->qos_proportion = 1.0;
+    filter->qos_earliest_time = GST_CLOCK_TIME_NONE;
+    filter->qos_processed = 0;
+    filter->qos_dropped = 0;
+    GST_OBJECT_UNLOCK (filter);
+}
+
+/* Latest mode: annotate the outgoing frame with the most recent results,
+ * which may have been computed from an earlier frame.
+ */
+static GstBuffer *
+gst_opencv_detector_annotate_latest (GstOpencvDetector * filter, GstBuffer * buf)
+{
+    if (!filter->annotate && !filter->roi_meta)
+    {
+        return buf;
+    }
+
+    const GstVideoInfo& info = GST_VIDEO_FILTER (filter)->in_info;
+    DetectionList latest = filter->async_detector_->latest();
+
+    if (latest.detections.size() == 0)
+    {
+        return buf;
+    }
+
+    if (filter->annotate)
+    {
+        // The worker holds a reference to the buffer, so this usually
+        // copies into a buffer from the output pool.
+        buf = make_frame_writable(buf, info, gst_opencv_detector_get_output_pool(filter));
+
+        ScopedBufferMap scoped_buffer(buf, info, GST_MAP_READWRITE);
+        if (!scoped_buffer.frame().empty())
         {
-            filter->server_->publish(detection_list);
+            filter->detector_->annotate(latest, scoped_buffer.frame());
         }
+    }
+
+    if (filter->roi_meta)
+    {
+        // Only the buffer metadata has to be writable, so this does not
+        // copy the frame.
+        buf = gst_buffer_make_writable(buf);
+        attach_roi_meta(buf, latest);
+    }
+
+    return buf;
+}
+
+/* Push every frame that is still in the stage pipeline, in order. */
+static void
+gst_opencv_detector_drain_completed (GstOpencvDetector * filter)
+{
+    PipelinedDetector* pipeline = filter->pipelined_detector_;
+    GstPad* srcpad = GST_BASE_TRANSFORM_SRC_PAD (filter);
 
-        if ((detection_list.detections.size() > 0) && filter->annotate)
+    while (pipeline->in_flight() > 0)
+    {
+        GstBuffer* completed = pipeline->pop(true);
+        if (completed == nullptr)
         {
-            GstBuffer* annotated_frame = cv_mat_to_gst_buffer(working_image);
-            gst_buffer_unref(buf);
+            break;
+        }
 
-            return gst_pad_push(filter->srcpad, annotated_frame);
+        if (gst_pad_push(srcpad, completed) != GST_FLOW_OK)
+        {
+            gst_opencv_detector_discard_completed(filter);
+            break;
         }
     }
+}
+
+/* Output pool for frames that have to be copied before annotation. The pool
+ * is negotiated with downstream on first use after each caps change.
+ */
+static GstBufferPool *
+gst_opencv_detector_get_output_pool (GstOpencvDetector * filter)
+{
+    if (!filter->output_pool_negotiated)
+    {
+        filter->output_pool = negotiate_output_pool (
+            GST_BASE_TRANSFORM_SRC_PAD (filter), GST_VIDEO_FILTER (filter)->in_info);
+        filter->output_pool_negotiated = TRUE;
+    }
 
-    return gst_pad_push(filter->srcpad, buf);
+    return filter->output_pool;
+}
+
+/* Drop every frame that is still in the stage pipeline. */
+static void
+gst_opencv_detector_discard_completed (GstOpencvDetector * filter)
+{
+    PipelinedDetector* pipeline = filter->pipelined_detector_;
+
+    while (pipeline->in_flight() > 0)
+    {
+        GstBuffer* completed = pipeline->pop(true);
+        if (completed == nullptr)
+        {
+            break;
+        }
+
+        gst_buffer_unref(completed);
+    }
 }
 
 
@@ -630,7 +2629,12 @@ opencvdetector_init (GstPlugin * opencvdetector)
   GST_DEBUG_CATEGORY_INIT (gst_opencv_detector_debug, "opencvdetector",
       0, "Template opencvdetector");
 
-  return GST_ELEMENT_REGISTER (opencv_detector, opencvdetector);
+  gboolean ret = FALSE;
+
+  ret |= GST_ELEMENT_REGISTER (opencv_detector, opencvdetector);
+  ret |= GST_ELEMENT_REGISTER (opencv_multi_detector, opencvdetector);
+
+  return ret;
 }
 
 /* PACKAGE: this is usually set by meson depending on some _INIT macro
@@ -48,12 +48,13 @@
 #define __GST_OPENCVDETECTOR_H__
 
 #include <gst/gst.h>
+#include <gst/video/gstvideofilter.h>
 
 G_BEGIN_DECLS
 
 #define GST_TYPE_OPENCVDETECTOR (gst_opencv_detector_get_type())
 G_DECLARE_FINAL_TYPE (GstOpencvDetector, gst_opencv_detector,
-    GST, OPENCVDETECTOR, GstElement)
+    GST, OPENCVDETECTOR, GstVideoFilter)
 
 GST_ELEMENT_REGISTER_DECLARE(opencv_detector)
 
@@ -0,0 +1,800 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * SECTION:element-opencvmultidetector
+ *
+ * Runs object detection on several video streams with a single model. Each
+ * requested sink pad (sink_%u) has a matching src pad (src_%u) that frames
+ * are pushed to without waiting on inference. A worker thread runs the
+ * latest frame of every stream through the network as one batch and
+ * publishes one DetectionList per stream, tagged with the stream index.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 opencv_multi_detector name=d configs=... weights=... classes=... port=5050 \
+ *     v4l2src device=/dev/video0 ! video/x-raw,format=YUY2 ! d.sink_0  d.src_0 ! fakesink \
+ *     v4l2src device=/dev/video2 ! video/x-raw,format=YUY2 ! d.sink_1  d.src_1 ! fakesink
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <cstdio>
+#include <algorithm>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include "gstopencv-utils.h"
+#include "object_detector.h"
+#include "batch_detector.h"
+#include "detections_list_server.h"
+
+#include "gstopencvmultidetector.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_opencv_multi_detector_debug);
+#define GST_CAT_DEFAULT gst_opencv_multi_detector_debug
+
+enum
+{
+    PROP_0,
+    PROP_CONFIGS_PATH,
+    PROP_WEIGHTS_PATH,
+    PROP_CLASS_NAMES_PATH,
+    PROP_ANNOTATE,
+    PROP_PORT,
+    PROP_MAX_SUBSCRIBERS,
+    PROP_CONF_THRESHOLD,
+    PROP_NMS_THRESHOLD,
+    PROP_ROI_META
+};
+
+/* State shared by a request sink pad and its src pad */
+struct MultiDetectorStream
+{
+    guint index;
+    GstPad* sinkpad;
+    GstPad* srcpad;
+
+    GstVideoInfo info;
+
+    // Pool for frames that must be copied before they can be annotated
+    GstBufferPool* output_pool;
+    gboolean output_pool_negotiated;
+};
+
+struct _GstOpencvMultiDetector
+{
+    GstElement element;
+
+    // Settings
+    gchar* configs_path;
+    gchar* weights_path;
+    gchar* class_names_path;
+    gboolean annotate;
+    gboolean roi_meta;
+    guint port;
+    guint max_subscribers;
+    float conf_threshold;
+    float nms_threshold;
+
+    guint next_stream_index;
+
+    // Guards the batch worker, which is started and stopped on state changes
+    // while pads may be released from any thread
+    GMutex init_lock;
+
+    ObjectDetector* detector_;
+    detections_list_server* server_;
+    BatchDetector* batch_detector_;
+};
+
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE ("sink_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (
+        "video/x-raw, "
+            "format=(string){ BGR, NV12, I420, YUY2 }"
+    )
+);
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_SOMETIMES,
+    GST_STATIC_CAPS (
+        "video/x-raw, "
+            "format=(string){ BGR, NV12, I420, YUY2 }"
+    )
+);
+
+#define gst_opencv_multi_detector_parent_class parent_class
+G_DEFINE_TYPE (GstOpencvMultiDetector, gst_opencv_multi_detector, GST_TYPE_ELEMENT);
+
+GST_ELEMENT_REGISTER_DEFINE (opencv_multi_detector, "opencv_multi_detector", GST_RANK_NONE,
+    GST_TYPE_OPENCVMULTIDETECTOR);
+
+static void gst_opencv_multi_detector_finalize (GObject * object);
+static GstStateChangeReturn gst_opencv_multi_detector_change_state (
+    GstElement * element, GstStateChange transition);
+static gboolean gst_opencv_multi_detector_load_model (GstOpencvMultiDetector * self);
+static gboolean gst_opencv_multi_detector_start_server (GstOpencvMultiDetector * self);
+static void gst_opencv_multi_detector_start_worker (GstOpencvMultiDetector * self);
+static void gst_opencv_multi_detector_stop_worker (GstOpencvMultiDetector * self);
+static void gst_opencv_multi_detector_set_property (GObject * object,
+    guint prop_id, const GValue * value, GParamSpec * pspec);
+static void gst_opencv_multi_detector_get_property (GObject * object,
+    guint prop_id, GValue * value, GParamSpec * pspec);
+
+static GstPad* gst_opencv_multi_detector_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps);
+static void gst_opencv_multi_detector_release_pad (GstElement * element,
+    GstPad * pad);
+
+static GstIterator* gst_opencv_multi_detector_iterate_internal_links (
+    GstPad * pad, GstObject * parent);
+static gboolean gst_opencv_multi_detector_sink_event (GstPad * pad,
+    GstObject * parent, GstEvent * event);
+static GstFlowReturn gst_opencv_multi_detector_chain (GstPad * pad,
+    GstObject * parent, GstBuffer * buf);
+
+/* GObject vmethod implementations */
+
+static void
+gst_opencv_multi_detector_class_init (GstOpencvMultiDetectorClass * klass)
+{
+    GObjectClass *gobject_class = (GObjectClass *) klass;
+    GstElementClass *gstelement_class = (GstElementClass *) klass;
+
+    GST_DEBUG_CATEGORY_INIT (gst_opencv_multi_detector_debug, "opencvmultidetector",
+        0, "OpenCV multi-stream detector");
+
+    gobject_class->set_property = gst_opencv_multi_detector_set_property;
+    gobject_class->get_property = gst_opencv_multi_detector_get_property;
+    gobject_class->finalize = gst_opencv_multi_detector_finalize;
+
+    g_object_class_install_property( gobject_class, PROP_CONFIGS_PATH,
+        g_param_spec_string (
+            "configs",
+            "Configs",
+            "Path to OpenCV net configuration file",
+            "", G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_WEIGHTS_PATH,
+        g_param_spec_string(
+            "weights",
+            "Weights",
+            "Path to OpenCV net weights file",
+            "", G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_CLASS_NAMES_PATH,
+        g_param_spec_string(
+            "classes",
+            "Classes",
+            "Path to class names file",
+            "", G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_ANNOTATE,
+        g_param_spec_boolean(
+            "annotate",
+            "Annotate",
+            "Annotate each stream with its most recent detections.",
+            FALSE, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_PORT,
+        g_param_spec_int(
+            "port",
+            "Port",
+            "Port that detection server will opened on",
+            0, 65525,
+            0, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_MAX_SUBSCRIBERS,
+        g_param_spec_int(
+            "max-subscribers",
+            "Maximum Subscribers",
+            "Maximum number of subscribers that may be accepted",
+            1, detections_list_server::DEFAULT_MAX_SUBCRIBERS,
+            detections_list_server::DEFAULT_MAX_SUBCRIBERS, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_CONF_THRESHOLD,
+        g_param_spec_float(
+            "confidence-threshold",
+            "Confidence Threshold",
+            "Confidence threshold for object detection",
+            0.1, 1.0,
+            0.6, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_NMS_THRESHOLD,
+        g_param_spec_float(
+            "nms-threshold",
+            "Non-Maximum Suppression Threshold",
+            "Non-maximum suppression threshold",
+            0.1, 1.0,
+            0.2, G_PARAM_READWRITE));
+
+    g_object_class_install_property( gobject_class, PROP_ROI_META,
+        g_param_spec_boolean(
+            "roi-meta",
+            "ROI Meta",
+            "Attach each stream's most recent detections to its frames as GstVideoRegionOfInterestMeta",
+            FALSE, G_PARAM_READWRITE));
+
+    gst_element_class_set_details_simple (gstelement_class,
+        "OpencvMultiDetector",
+        "Filter/Analyzer/Video",
+        "Batched OpenCV object detection across several video streams",
+        "Robert Vaughan <robert.glissmann@gmail.com>");
+
+    gstelement_class->change_state =
+        GST_DEBUG_FUNCPTR (gst_opencv_multi_detector_change_state);
+    gstelement_class->request_new_pad =
+        GST_DEBUG_FUNCPTR (gst_opencv_multi_detector_request_new_pad);
+    gstelement_class->release_pad =
+        GST_DEBUG_FUNCPTR (gst_opencv_multi_detector_release_pad);
+
+    gst_element_class_add_pad_template (gstelement_class,
+        gst_static_pad_template_get (&src_factory));
+    gst_element_class_add_pad_template (gstelement_class,
+        gst_static_pad_template_get (&sink_factory));
+}
+
+static void
+gst_opencv_multi_detector_init (GstOpencvMultiDetector * self)
+{
+    self->annotate = FALSE;
+    self->roi_meta = FALSE;
+    self->port = 0;
+    self->max_subscribers = detections_list_server::DEFAULT_MAX_SUBCRIBERS;
+    self->conf_threshold = 0.6;
+    self->nms_threshold = 0.2;
+    self->next_stream_index = 0;
+
+    g_mutex_init(&self->init_lock);
+
+    self->detector_ = new ObjectDetector();
+    self->server_ = nullptr;
+    self->batch_detector_ = nullptr;
+}
+
+static void
+gst_opencv_multi_detector_finalize (GObject * object)
+{
+    GstOpencvMultiDetector *self = GST_OPENCVMULTIDETECTOR(object);
+
+    // The worker uses the detector and publishes to the server, so it must
+    // be stopped first.
+    delete self->batch_detector_;
+    delete self->detector_;
+    delete self->server_;
+
+    g_free(self->configs_path);
+    g_free(self->weights_path);
+    g_free(self->class_names_path);
+
+    g_mutex_clear(&self->init_lock);
+
+    G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
+static void
+gst_opencv_multi_detector_set_path (GstOpencvMultiDetector * self,
+    gchar ** path, const GValue * value, const gchar * description)
+{
+    gchar* new_path = g_value_dup_string(value);
+
+    if (valid_file_path(new_path))
+    {
+        g_free(*path);
+        *path = new_path;
+    }
+    else
+    {
+        GST_ELEMENT_WARNING(self, RESOURCE, NOT_FOUND,
+            ("%s file not found at '%s'.", description, new_path),
+            ("File not found."));
+        g_free(new_path);
+    }
+}
+
+static void
+gst_opencv_multi_detector_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+    GstOpencvMultiDetector *self = GST_OPENCVMULTIDETECTOR (object);
+
+    switch (prop_id) {
+    case PROP_CONFIGS_PATH:
+        gst_opencv_multi_detector_set_path(self, &self->configs_path, value, "Configuration");
+        break;
+    case PROP_WEIGHTS_PATH:
+        gst_opencv_multi_detector_set_path(self, &self->weights_path, value, "Weights");
+        break;
+    case PROP_CLASS_NAMES_PATH:
+        gst_opencv_multi_detector_set_path(self, &self->class_names_path, value, "Class names");
+        break;
+    case PROP_ANNOTATE:
+        self->annotate = g_value_get_boolean(value);
+        break;
+    case PROP_ROI_META:
+        self->roi_meta = g_value_get_boolean(value);
+        break;
+    case PROP_PORT:
+        self->port = g_value_get_int(value);
+        break;
+    case PROP_MAX_SUBSCRIBERS:
+        self->max_subscribers = g_value_get_int(value);
+        break;
+    case PROP_CONF_THRESHOLD:
+        self->conf_threshold = g_value_get_float(value);
+        break;
+    case PROP_NMS_THRESHOLD:
+        self->nms_threshold = g_value_get_float(value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+gst_opencv_multi_detector_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+    GstOpencvMultiDetector *self = GST_OPENCVMULTIDETECTOR (object);
+
+    switch (prop_id) {
+    case PROP_CONFIGS_PATH:
+        g_value_set_string(value, self->configs_path);
+        break;
+    case PROP_WEIGHTS_PATH:
+        g_value_set_string(value, self->weights_path);
+        break;
+    case PROP_CLASS_NAMES_PATH:
+        g_value_set_string(value, self->class_names_path);
+        break;
+    case PROP_ANNOTATE:
+        g_value_set_boolean(value, self->annotate);
+        break;
+    case PROP_ROI_META:
+        g_value_set_boolean(value, self->roi_meta);
+        break;
+    case PROP_PORT:
+        g_value_set_int(value, self->port);
+        break;
+    case PROP_MAX_SUBSCRIBERS:
+        g_value_set_int(value, self->max_subscribers);
+        break;
+    case PROP_CONF_THRESHOLD:
+        g_value_set_float(value, self->conf_threshold);
+        break;
+    case PROP_NMS_THRESHOLD:
+        g_value_set_float(value, self->nms_threshold);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+/* GstElement vmethod implementations */
+
+static GstPad*
+gst_opencv_multi_detector_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps)
+{
+    GstOpencvMultiDetector *self = GST_OPENCVMULTIDETECTOR (element);
+    (void)templ;
+    (void)caps;
+
+    guint index = 0;
+
+    GST_OBJECT_LOCK(self);
+    if (name && (std::sscanf(name, "sink_%u", &index) == 1))
+    {
+        self->next_stream_index = std::max(self->next_stream_index, index + 1);
+    }
+    else
+    {
+        index = self->next_stream_index++;
+    }
+    GST_OBJECT_UNLOCK(self);
+
+    gchar* sink_name = g_strdup_printf("sink_%u", index);
+    gchar* src_name = g_strdup_printf("src_%u", index);
+
+    MultiDetectorStream* stream = g_new0(MultiDetectorStream, 1);
+    stream->index = index;
+    gst_video_info_init(&stream->info);
+
+    stream->sinkpad = gst_pad_new_from_static_template(&sink_factory, sink_name);
+    gst_pad_set_element_private(stream->sinkpad, stream);
+    gst_pad_set_event_function(stream->sinkpad,
+        GST_DEBUG_FUNCPTR (gst_opencv_multi_detector_sink_event));
+    gst_pad_set_chain_function(stream->sinkpad,
+        GST_DEBUG_FUNCPTR (gst_opencv_multi_detector_chain));
+    gst_pad_set_iterate_internal_links_function(stream->sinkpad,
+        GST_DEBUG_FUNCPTR (gst_opencv_multi_detector_iterate_internal_links));
+    GST_PAD_SET_PROXY_CAPS(stream->sinkpad);
+
+    // Keep a reference so the src pad outlives its removal from the element.
+    stream->srcpad = GST_PAD(gst_object_ref(
+        gst_pad_new_from_static_template(&src_factory, src_name)));
+    gst_pad_set_element_private(stream->srcpad, stream);
+    gst_pad_set_iterate_internal_links_function(stream->srcpad,
+        GST_DEBUG_FUNCPTR (gst_opencv_multi_detector_iterate_internal_links));
+    GST_PAD_SET_PROXY_CAPS(stream->srcpad);
+
+    g_free(sink_name);
+    g_free(src_name);
+
+    gst_element_add_pad(element, stream->srcpad);
+    gst_element_add_pad(element, stream->sinkpad);
+
+    GST_INFO_OBJECT(self, "Added stream %u", index);
+
+    return stream->sinkpad;
+}
+
+static void
+gst_opencv_multi_detector_release_pad (GstElement * element, GstPad * pad)
+{
+    GstOpencvMultiDetector *self = GST_OPENCVMULTIDETECTOR (element);
+    MultiDetectorStream* stream =
+        static_cast<MultiDetectorStream*>(gst_pad_get_element_private(pad));
+
+    if (stream == nullptr)
+    {
+        return;
+    }
+
+    GST_INFO_OBJECT(self, "Removing stream %u", stream->index);
+
+    g_mutex_lock(&self->init_lock);
+    if (self->batch_detector_)
+    {
+        self->batch_detector_->remove_stream(stream->index);
+    }
+    g_mutex_unlock(&self->init_lock);
+
+    gst_pad_set_element_private(stream->sinkpad, nullptr);
+    gst_pad_set_element_private(stream->srcpad, nullptr);
+
+    if (GST_OBJECT_PARENT(stream->srcpad) == GST_OBJECT(element))
+    {
+        gst_pad_set_active(stream->srcpad, FALSE);
+        gst_element_remove_pad(element, stream->srcpad);
+    }
+    gst_object_unref(stream->srcpad);
+
+    gst_pad_set_active(stream->sinkpad, FALSE);
+    gst_element_remove_pad(element, stream->sinkpad);
+
+    release_output_pool(&stream->output_pool);
+
+    g_free(stream);
+}
+
+/* Each sink pad is linked only to the src pad of the same stream */
+static GstIterator*
+gst_opencv_multi_detector_iterate_internal_links (GstPad * pad, GstObject * parent)
+{
+    (void)parent;
+
+    MultiDetectorStream* stream =
+        static_cast<MultiDetectorStream*>(gst_pad_get_element_private(pad));
+
+    if (stream == nullptr)
+    {
+        return nullptr;
+    }
+
+    GstPad* other = (pad == stream->sinkpad) ? stream->srcpad : stream->sinkpad;
+
+    GValue value = G_VALUE_INIT;
+    g_value_init(&value, GST_TYPE_PAD);
+    g_value_set_object(&value, other);
+
+    GstIterator* it = gst_iterator_new_single(GST_TYPE_PAD, &value);
+    g_value_unset(&value);
+
+    return it;
+}
+
+static gboolean
+gst_opencv_multi_detector_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+    MultiDetectorStream* stream =
+        static_cast<MultiDetectorStream*>(gst_pad_get_element_private(pad));
+
+    GST_LOG_OBJECT (parent, "Received %s event: %" GST_PTR_FORMAT,
+            GST_EVENT_TYPE_NAME (event), event);
+
+    if ((GST_EVENT_TYPE (event) == GST_EVENT_CAPS) && stream)
+    {
+        GstCaps *caps;
+
+        gst_event_parse_caps (event, &caps);
+        if (!gst_video_info_from_caps (&stream->info, caps))
+        {
+            GST_WARNING_OBJECT (parent, "Failed to parse caps %" GST_PTR_FORMAT, caps);
+        }
+
+        release_output_pool (&stream->output_pool);
+        stream->output_pool_negotiated = FALSE;
+    }
+
+    // Serialized events hold the pad's stream lock, so the worker cannot be
+    // stopped underneath them.
+    BatchDetector* batch_detector = GST_OPENCVMULTIDETECTOR (parent)->batch_detector_;
+
+    if (stream && batch_detector)
+    {
+        switch (GST_EVENT_TYPE (event)) {
+        case GST_EVENT_FLUSH_STOP:
+            // Detections of frames from before the flush are stale.
+            batch_detector->flush_stream (stream->index);
+            break;
+        case GST_EVENT_EOS:
+            // Publish the detections of the stream's last frame first.
+            batch_detector->drain_stream (stream->index);
+            break;
+        default:
+            break;
+        }
+    }
+
+    return gst_pad_event_default (pad, parent, event);
+}
+
+static GstStateChangeReturn
+gst_opencv_multi_detector_change_state (GstElement * element, GstStateChange transition)
+{
+    GstOpencvMultiDetector *self = GST_OPENCVMULTIDETECTOR (element);
+    GstStateChangeReturn ret;
+
+    switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+        if (!gst_opencv_multi_detector_start_server (self) ||
+            !gst_opencv_multi_detector_load_model (self))
+        {
+            return GST_STATE_CHANGE_FAILURE;
+        }
+        break;
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+        gst_opencv_multi_detector_start_worker (self);
+        break;
+    default:
+        break;
+    }
+
+    ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+    if (ret == GST_STATE_CHANGE_FAILURE)
+    {
+        return ret;
+    }
+
+    switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+        // The pads are deactivated, so no stream is submitting frames.
+        gst_opencv_multi_detector_stop_worker (self);
+        break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+        // The model stays loaded so that a restart does not pay for it again.
+        delete self->server_;
+        self->server_ = nullptr;
+        break;
+    default:
+        break;
+    }
+
+    return ret;
+}
+
+/* Load the model, unless it is already loaded. Posts an error message on
+ * failure.
+ */
+static gboolean
+gst_opencv_multi_detector_load_model (GstOpencvMultiDetector * self)
+{
+    ObjectDetector* detector = self->detector_;
+
+    if (detector->is_initialized())
+    {
+        return TRUE;
+    }
+
+    if (!self->configs_path || !self->weights_path || !self->class_names_path)
+    {
+        GST_ELEMENT_ERROR (self, RESOURCE, NOT_FOUND,
+            ("No detection model configured."),
+            ("The configs, weights and classes properties must all be set."));
+        return FALSE;
+    }
+
+    if (!detector->initialize(
+            self->configs_path,
+            self->weights_path,
+            self->class_names_path,
+            self->conf_threshold,
+            self->nms_threshold))
+    {
+        GST_ELEMENT_ERROR (self, RESOURCE, OPEN_READ,
+            ("Failed to load detection model."),
+            ("configs '%s', weights '%s', classes '%s'", self->configs_path,
+                self->weights_path, self->class_names_path));
+        return FALSE;
+    }
+
+    // Frames in the batch are only read. Annotation is drawn on the outgoing
+    // frames instead.
+    detector->set_annotate(false);
+
+    GST_INFO_OBJECT (self, "Loaded detection model");
+
+    return TRUE;
+}
+
+static gboolean
+gst_opencv_multi_detector_start_server (GstOpencvMultiDetector * self)
+{
+    if (!self->port || self->server_)
+    {
+        return TRUE;
+    }
+
+    try
+    {
+        self->server_ = new detections_list_server(self->port, static_cast<size_t>(self->max_subscribers));
+    }
+    catch (const std::exception& e)
+    {
+        GST_ELEMENT_ERROR (self, RESOURCE, OPEN_READ_WRITE,
+            ("Failed to start the detections server on port %u.", self->port),
+            ("%s", e.what()));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Start the batch worker before the pads are activated. */
+static void
+gst_opencv_multi_detector_start_worker (GstOpencvMultiDetector * self)
+{
+    g_mutex_lock(&self->init_lock);
+
+    if (self->batch_detector_ == nullptr)
+    {
+        detections_list_server* server = self->server_;
+
+        self->batch_detector_ = new BatchDetector(*self->detector_,
+            [server](const DetectionList& detection_list)
+            {
+                if (server)
+                {
+                    server->publish(detection_list);
+                }
+            });
+    }
+
+    g_mutex_unlock(&self->init_lock);
+}
+
+/* Stop the batch worker and drop its pending frames and latest results. */
+static void
+gst_opencv_multi_detector_stop_worker (GstOpencvMultiDetector * self)
+{
+    g_mutex_lock(&self->init_lock);
+
+    BatchDetector* batch_detector = self->batch_detector_;
+    self->batch_detector_ = nullptr;
+
+    g_mutex_unlock(&self->init_lock);
+
+    delete batch_detector;
+}
+
+static GstFlowReturn
+gst_opencv_multi_detector_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+    GstOpencvMultiDetector *self = GST_OPENCVMULTIDETECTOR (parent);
+    MultiDetectorStream* stream =
+        static_cast<MultiDetectorStream*>(gst_pad_get_element_private(pad));
+
+    if (stream == nullptr)
+    {
+        gst_buffer_unref(buf);
+        return GST_FLOW_FLUSHING;
+    }
+
+    if (self->batch_detector_ == nullptr)
+    {
+        gst_buffer_unref(buf);
+        return GST_FLOW_FLUSHING;
+    }
+
+    self->batch_detector_->submit(stream->index, buf, stream->info);
+
+    if (self->annotate || self->roi_meta)
+    {
+        // Annotate with the most recent results for this stream, which may
+        // have been computed from an earlier frame.
+        DetectionList latest = self->batch_detector_->latest(stream->index);
+
+        if (self->annotate && (latest.detections.size() > 0))
+        {
+            // The worker holds a reference to the buffer, so this usually
+            // copies into a buffer from the stream's output pool.
+            if (gst_pad_check_reconfigure(stream->srcpad) || !stream->output_pool_negotiated)
+            {
+                release_output_pool(&stream->output_pool);
+
+                stream->output_pool = negotiate_output_pool(stream->srcpad, stream->info);
+                stream->output_pool_negotiated = TRUE;
+            }
+
+            buf = make_frame_writable(buf, stream->info, stream->output_pool);
+
+            ScopedBufferMap scoped_buffer(buf, stream->info, GST_MAP_READWRITE);
+            if (!scoped_buffer.frame().empty())
+            {
+                self->detector_->annotate(latest, scoped_buffer.frame());
+            }
+        }
+
+        if (self->roi_meta && (latest.detections.size() > 0))
+        {
+            // Only the buffer metadata has to be writable, so this does not
+            // copy the frame.
+            buf = gst_buffer_make_writable(buf);
+            attach_roi_meta(buf, latest);
+        }
+    }
+
+    return gst_pad_push(stream->srcpad, buf);
+}
@@ -0,0 +1,686 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+#include "input_blob.h"
+
+// The kernel is chosen at compile time. x86-64 builds use SSE2 unless the
+// compiler targets AVX2 and FMA (for example with -march=native), since
+// those are not available on every x86-64 CPU. tools/benchmark_input_blob.cpp
+// measures the kernel that was built in.
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define INPUT_BLOB_AVX2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define INPUT_BLOB_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define INPUT_BLOB_SSE2 1
+#endif
+
+namespace {
+
+/**
+ * Sampling positions along one axis of the source region, computed the same
+ * way as cv::resize with INTER_LINEAR.
+ */
+struct AxisMap {
+
+    // Neighboring source indices and the weight of the second one
+    std::vector<int> index0;
+    std::vector<int> index1;
+    std::vector<float> weight;
+
+    // Source index nearest to the sample center
+    std::vector<int> nearest;
+
+    AxisMap(int output_size, int source_offset, int source_size)
+        : index0(output_size)
+        , index1(output_size)
+        , weight(output_size)
+        , nearest(output_size)
+    {
+        const float ratio = static_cast<float>(source_size) / output_size;
+
+        for (int index = 0; index < output_size; ++index)
+        {
+            float position = (index + 0.5f) * ratio - 0.5f;
+            int first = static_cast<int>(std::floor(position));
+            float fraction = position - first;
+
+            if (first < 0)
+            {
+                first = 0;
+                fraction = 0.0f;
+            }
+
+            if (first >= source_size - 1)
+            {
+                first = source_size - 1;
+                fraction = 0.0f;
+            }
+
+            index0[index] = source_offset + first;
+            index1[index] = source_offset + std::min(first + 1, source_size - 1);
+            weight[index] = fraction;
+
+            int center = static_cast<int>((index + 0.5f) * ratio);
+            nearest[index] = source_offset + std::max(0, std::min(center, source_size - 1));
+        }
+    }
+};
+
+/**
+ * Per-pixel transform from three interpolated input channels (B, G, R or
+ * Y, U, V) to the three blob channels:
+ *
+ *   out[k] = clamp(sum(matrix[k][j] * in[j]) + offset[k], 0, 255) * scale + bias
+ *
+ * Color conversion, channel order and normalization are all folded into the
+ * coefficients.
+ */
+struct ColorTransform {
+
+    float matrix[3][3];
+    float offset[3];
+    float scale;
+    float bias;
+
+    ColorTransform(const FrameView& frame, const InputBlobParams& params)
+    {
+        // Rows produce R, G and B from the input channels
+        float rgb[3][3] = {};
+        float rgb_offset[3] = {};
+
+        if (frame.format == GST_VIDEO_FORMAT_BGR)
+        {
+            rgb[0][2] = 1.0f;
+            rgb[1][1] = 1.0f;
+            rgb[2][0] = 1.0f;
+        }
+        else
+        {
+            gdouble kr = 0.0;
+            gdouble kb = 0.0;
+
+            if (!gst_video_color_matrix_get_Kr_Kb(frame.matrix, &kr, &kb))
+            {
+                // BT.601
+                kr = 0.299;
+                kb = 0.114;
+            }
+
+            const gdouble kg = 1.0 - kr - kb;
+            const bool full_range = (frame.range == GST_VIDEO_COLOR_RANGE_0_255);
+
+            const float y_offset = full_range ? 0.0f : 16.0f;
+            const float y_gain = full_range ? 1.0f : 255.0f / 219.0f;
+            const float c_gain = full_range ? 1.0f : 255.0f / 224.0f;
+
+            rgb[0][0] = y_gain;
+            rgb[0][2] = static_cast<float>(2.0 * (1.0 - kr)) * c_gain;
+
+            rgb[1][0] = y_gain;
+            rgb[1][1] = -static_cast<float>(2.0 * kb * (1.0 - kb) / kg) * c_gain;
+            rgb[1][2] = -static_cast<float>(2.0 * kr * (1.0 - kr) / kg) * c_gain;
+
+            rgb[2][0] = y_gain;
+            rgb[2][1] = static_cast<float>(2.0 * (1.0 - kb)) * c_gain;
+
+            // Luma is offset by y_offset, chroma is centered on 128
+            for (int k = 0; k < 3; ++k)
+            {
+                rgb_offset[k] = -rgb[k][0] * y_offset - 128.0f * (rgb[k][1] + rgb[k][2]);
+            }
+        }
+
+        // blobFromImage writes BGR unless swapRB is set
+        const int order[3] = { params.swap_rb ? 0 : 2, 1, params.swap_rb ? 2 : 0 };
+
+        for (int k = 0; k < 3; ++k)
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                matrix[k][j] = rgb[order[k]][j];
+            }
+
+            offset[k] = rgb_offset[order[k]];
+        }
+
+        scale = params.scale;
+        bias = -params.mean * params.scale;
+    }
+};
+
+/**
+ * Two horizontally resampled source rows, one pointer per input channel, and
+ * the vertical weight of the bottom row.
+ */
+struct RowPair {
+    const float* top[3];
+    const float* bottom[3];
+    float weight;
+};
+
+/**
+ * Vertical interpolation, color transform and normalization of one output
+ * row, written to the three blob channel planes.
+ */
+void convert_row(const RowPair& rows, const ColorTransform& transform, float* const dst[3], int width)
+{
+    int x = 0;
+
+#if defined(INPUT_BLOB_AVX2)
+    {
+        const __m256 weight = _mm256_set1_ps(rows.weight);
+        const __m256 lower = _mm256_setzero_ps();
+        const __m256 upper = _mm256_set1_ps(255.0f);
+        const __m256 scale = _mm256_set1_ps(transform.scale);
+        const __m256 bias = _mm256_set1_ps(transform.bias);
+
+        __m256 matrix[3][3];
+        __m256 offset[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                matrix[k][j] = _mm256_set1_ps(transform.matrix[k][j]);
+            }
+            offset[k] = _mm256_set1_ps(transform.offset[k]);
+        }
+
+        for (; x + 8 <= width; x += 8)
+        {
+            __m256 in[3];
+            for (int j = 0; j < 3; ++j)
+            {
+                const __m256 top = _mm256_loadu_ps(rows.top[j] + x);
+                const __m256 bottom = _mm256_loadu_ps(rows.bottom[j] + x);
+                in[j] = _mm256_fmadd_ps(_mm256_sub_ps(bottom, top), weight, top);
+            }
+
+            for (int k = 0; k < 3; ++k)
+            {
+                __m256 value = _mm256_fmadd_ps(matrix[k][0], in[0], offset[k]);
+                value = _mm256_fmadd_ps(matrix[k][1], in[1], value);
+                value = _mm256_fmadd_ps(matrix[k][2], in[2], value);
+                value = _mm256_min_ps(_mm256_max_ps(value, lower), upper);
+                _mm256_storeu_ps(dst[k] + x, _mm256_fmadd_ps(value, scale, bias));
+            }
+        }
+    }
+#elif defined(INPUT_BLOB_NEON)
+    {
+        const float32x4_t weight = vdupq_n_f32(rows.weight);
+        const float32x4_t lower = vdupq_n_f32(0.0f);
+        const float32x4_t upper = vdupq_n_f32(255.0f);
+        const float32x4_t scale = vdupq_n_f32(transform.scale);
+        const float32x4_t bias = vdupq_n_f32(transform.bias);
+
+        float32x4_t matrix[3][3];
+        float32x4_t offset[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                matrix[k][j] = vdupq_n_f32(transform.matrix[k][j]);
+            }
+            offset[k] = vdupq_n_f32(transform.offset[k]);
+        }
+
+        for (; x + 4 <= width; x += 4)
+        {
+            float32x4_t in[3];
+            for (int j = 0; j < 3; ++j)
+            {
+                const float32x4_t top = vld1q_f32(rows.top[j] + x);
+                const float32x4_t bottom = vld1q_f32(rows.bottom[j] + x);
+                in[j] = vmlaq_f32(top, vsubq_f32(bottom, top), weight);
+            }
+
+            for (int k = 0; k < 3; ++k)
+            {
+                float32x4_t value = vmlaq_f32(offset[k], matrix[k][0], in[0]);
+                value = vmlaq_f32(value, matrix[k][1], in[1]);
+                value = vmlaq_f32(value, matrix[k][2], in[2]);
+                value = vminq_f32(vmaxq_f32(value, lower), upper);
+                vst1q_f32(dst[k] + x, vmlaq_f32(bias, value, scale));
+            }
+        }
+    }
+#elif defined(INPUT_BLOB_SSE2)
+    {
+        const __m128 weight = _mm_set1_ps(rows.weight);
+        const __m128 lower = _mm_setzero_ps();
+        const __m128 upper = _mm_set1_ps(255.0f);
+        const __m128 scale = _mm_set1_ps(transform.scale);
+        const __m128 bias = _mm_set1_ps(transform.bias);
+
+        __m128 matrix[3][3];
+        __m128 offset[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                matrix[k][j] = _mm_set1_ps(transform.matrix[k][j]);
+            }
+            offset[k] = _mm_set1_ps(transform.offset[k]);
+        }
+
+        for (; x + 4 <= width; x += 4)
+        {
+            __m128 in[3];
+            for (int j = 0; j < 3; ++j)
+            {
+                const __m128 top = _mm_loadu_ps(rows.top[j] + x);
+                const __m128 bottom = _mm_loadu_ps(rows.bottom[j] + x);
+                in[j] = _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), weight));
+            }
+
+            for (int k = 0; k < 3; ++k)
+            {
+                __m128 value = _mm_add_ps(offset[k], _mm_mul_ps(matrix[k][0], in[0]));
+                value = _mm_add_ps(value, _mm_mul_ps(matrix[k][1], in[1]));
+                value = _mm_add_ps(value, _mm_mul_ps(matrix[k][2], in[2]));
+                value = _mm_min_ps(_mm_max_ps(value, lower), upper);
+                _mm_storeu_ps(dst[k] + x, _mm_add_ps(_mm_mul_ps(value, scale), bias));
+            }
+        }
+    }
+#endif
+
+    for (; x < width; ++x)
+    {
+        float in[3];
+        for (int j = 0; j < 3; ++j)
+        {
+            const float top = rows.top[j][x];
+            in[j] = top + (rows.bottom[j][x] - top) * rows.weight;
+        }
+
+        for (int k = 0; k < 3; ++k)
+        {
+            float value = transform.offset[k] +
+                transform.matrix[k][0] * in[0] +
+                transform.matrix[k][1] * in[1] +
+                transform.matrix[k][2] * in[2];
+            value = std::min(255.0f, std::max(0.0f, value));
+            dst[k][x] = value * transform.scale + transform.bias;
+        }
+    }
+}
+
+/**
+ * Source row resampled horizontally to the output width, one float vector
+ * per channel.
+ */
+struct SourceRow {
+    int index = -1;
+    std::vector<float> channels[3];
+};
+
+/**
+ * Holds the last two resampled source rows. When upscaling, consecutive
+ * output rows share source rows, which are then only resampled once.
+ */
+class RowCache {
+public:
+
+    RowCache(int width, int num_channels)
+    {
+        for (auto& row : rows_)
+        {
+            for (int channel = 0; channel < num_channels; ++channel)
+            {
+                row.channels[channel].resize(static_cast<std::size_t>(width));
+            }
+        }
+    }
+
+    /**
+     * Return the resampled source row, resampling it if it is not cached.
+     *
+     * @param index Source row index
+     * @param keep Source row that must not be evicted
+     * @param fill Called as fill(index, row) to resample a row
+     */
+    template <typename Fill>
+    const SourceRow& fetch(int index, int keep, Fill fill)
+    {
+        for (const auto& row : rows_)
+        {
+            if (row.index == index)
+            {
+                return row;
+            }
+        }
+
+        SourceRow& row = (rows_[0].index != keep) ? rows_[0] : rows_[1];
+        fill(index, row);
+        row.index = index;
+
+        return row;
+    }
+
+
+private:
+
+    SourceRow rows_[2];
+};
+
+void resample_bgr_row(const uchar* source, const AxisMap& columns, SourceRow& row)
+{
+    float* blue = row.channels[0].data();
+    float* green = row.channels[1].data();
+    float* red = row.channels[2].data();
+
+    for (std::size_t x = 0; x < columns.weight.size(); ++x)
+    {
+        const uchar* first = source + 3 * columns.index0[x];
+        const uchar* second = source + 3 * columns.index1[x];
+        const float weight = columns.weight[x];
+
+        blue[x] = first[0] + (second[0] - first[0]) * weight;
+        green[x] = first[1] + (second[1] - first[1]) * weight;
+        red[x] = first[2] + (second[2] - first[2]) * weight;
+    }
+}
+
+void resample_luma_row(const uchar* source, int step, const AxisMap& columns, SourceRow& row)
+{
+    float* luma = row.channels[0].data();
+
+    for (std::size_t x = 0; x < columns.weight.size(); ++x)
+    {
+        const int first = source[step * columns.index0[x]];
+        const int second = source[step * columns.index1[x]];
+
+        luma[x] = first + (second - first) * columns.weight[x];
+    }
+}
+
+void sample_chroma_row(const FrameView& frame, int chroma_row, const AxisMap& columns, SourceRow& row)
+{
+    float* u = row.channels[0].data();
+    float* v = row.channels[1].data();
+
+    for (std::size_t x = 0; x < columns.nearest.size(); ++x)
+    {
+        const int chroma_column = columns.nearest[x] / 2;
+
+        switch (frame.format)
+        {
+        case GST_VIDEO_FORMAT_NV12:
+            {
+                const uchar* uv = frame.planes[1].ptr<uchar>(chroma_row) + 2 * chroma_column;
+                u[x] = uv[0];
+                v[x] = uv[1];
+            }
+            break;
+        case GST_VIDEO_FORMAT_I420:
+            u[x] = frame.planes[1].ptr<uchar>(chroma_row)[chroma_column];
+            v[x] = frame.planes[2].ptr<uchar>(chroma_row)[chroma_column];
+            break;
+        case GST_VIDEO_FORMAT_YUY2:
+            {
+                const uchar* pair = frame.planes[0].ptr<uchar>(chroma_row) + 4 * chroma_column;
+                u[x] = pair[1];
+                v[x] = pair[3];
+            }
+            break;
+        default:
+            u[x] = 128.0f;
+            v[x] = 128.0f;
+            break;
+        }
+    }
+}
+
+void fill_from_bgr(
+    const FrameView&      frame,
+    const AxisMap&        columns,
+    const AxisMap&        rows,
+    const ColorTransform& transform,
+    float* const          planes[3],
+    std::size_t           stride)
+{
+    const int width = static_cast<int>(columns.weight.size());
+    const cv::Mat& plane = frame.planes[0];
+
+    RowCache cache(width, 3);
+    auto resample = [&](int index, SourceRow& row) {
+        resample_bgr_row(plane.ptr<uchar>(index), columns, row);
+    };
+
+    for (std::size_t y = 0; y < rows.weight.size(); ++y)
+    {
+        const SourceRow& top = cache.fetch(rows.index0[y], rows.index1[y], resample);
+        const SourceRow& bottom = cache.fetch(rows.index1[y], rows.index0[y], resample);
+
+        RowPair pair;
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            pair.top[channel] = top.channels[channel].data();
+            pair.bottom[channel] = bottom.channels[channel].data();
+        }
+        pair.weight = rows.weight[y];
+
+        const std::size_t offset = y * stride;
+        float* const dst[3] = { planes[0] + offset, planes[1] + offset, planes[2] + offset };
+
+        convert_row(pair, transform, dst, width);
+    }
+}
+
+void fill_from_yuv(
+    const FrameView&      frame,
+    const AxisMap&        columns,
+    const AxisMap&        rows,
+    const ColorTransform& transform,
+    float* const          planes[3],
+    std::size_t           stride)
+{
+    const int width = static_cast<int>(columns.weight.size());
+    const cv::Mat& luma = frame.planes[0];
+
+    // Luma samples are one byte apart, except in packed YUY2
+    const bool packed = (frame.format == GST_VIDEO_FORMAT_YUY2);
+    const int luma_step = packed ? 2 : 1;
+
+    RowCache cache(width, 1);
+    auto resample = [&](int index, SourceRow& row) {
+        resample_luma_row(luma.ptr<uchar>(index), luma_step, columns, row);
+    };
+
+    SourceRow chroma;
+    chroma.channels[0].resize(static_cast<std::size_t>(width));
+    chroma.channels[1].resize(static_cast<std::size_t>(width));
+
+    for (std::size_t y = 0; y < rows.weight.size(); ++y)
+    {
+        const SourceRow& top = cache.fetch(rows.index0[y], rows.index1[y], resample);
+        const SourceRow& bottom = cache.fetch(rows.index1[y], rows.index0[y], resample);
+
+        // YUY2 has full vertical chroma resolution
+        const int chroma_row = packed ? rows.nearest[y] : rows.nearest[y] / 2;
+        if (chroma.index != chroma_row)
+        {
+            sample_chroma_row(frame, chroma_row, columns, chroma);
+            chroma.index = chroma_row;
+        }
+
+        // Chroma is not interpolated vertically
+        RowPair pair;
+        pair.top[0] = top.channels[0].data();
+        pair.bottom[0] = bottom.channels[0].data();
+        pair.top[1] = pair.bottom[1] = chroma.channels[0].data();
+        pair.top[2] = pair.bottom[2] = chroma.channels[1].data();
+        pair.weight = rows.weight[y];
+
+        const std::size_t offset = y * stride;
+        float* const dst[3] = { planes[0] + offset, planes[1] + offset, planes[2] + offset };
+
+        convert_row(pair, transform, dst, width);
+    }
+}
+
+/**
+ * Zero every plane outside the target region.
+ */
+void fill_padding(const cv::Size& size, const cv::Rect& target, float* const planes[3])
+{
+    for (int channel = 0; channel < 3; ++channel)
+    {
+        for (int y = 0; y < size.height; ++y)
+        {
+            float* row = planes[channel] + y * static_cast<std::size_t>(size.width);
+
+            if ((y < target.y) || (y >= target.y + target.height))
+            {
+                std::fill(row, row + size.width, 0.0f);
+            }
+            else
+            {
+                std::fill(row, row + target.x, 0.0f);
+                std::fill(row + target.x + target.width, row + size.width, 0.0f);
+            }
+        }
+    }
+}
+
+} // namespace
+
+gboolean fill_input_blob(
+    const FrameView&       frame,
+    const cv::Rect&        source,
+    const InputBlobParams& params,
+    float*                 blob)
+{
+    const cv::Rect bounds = source & cv::Rect(cv::Point(0, 0), frame.size);
+    const cv::Rect input(cv::Point(0, 0), params.size);
+    const cv::Rect target = params.target.empty() ? input : (params.target & input);
+
+    if (frame.empty() || bounds.empty() || target.empty() || (blob == nullptr))
+    {
+        return FALSE;
+    }
+
+    const AxisMap columns(target.width, bounds.x, bounds.width);
+    const AxisMap rows(target.height, bounds.y, bounds.height);
+
+    const ColorTransform transform(frame, params);
+
+    const std::size_t plane_size = static_cast<std::size_t>(params.size.area());
+    float* const planes[3] = { blob, blob + plane_size, blob + 2 * plane_size };
+
+    if (target != input)
+    {
+        fill_padding(params.size, target, planes);
+    }
+
+    // Rows are written into the target region of each plane
+    const std::size_t stride = static_cast<std::size_t>(params.size.width);
+    const std::size_t origin = target.y * stride + target.x;
+    float* const target_planes[3] = {
+        planes[0] + origin, planes[1] + origin, planes[2] + origin };
+
+    switch (frame.format)
+    {
+    case GST_VIDEO_FORMAT_BGR:
+        fill_from_bgr(frame, columns, rows, transform, target_planes, stride);
+        return TRUE;
+    case GST_VIDEO_FORMAT_NV12:
+    case GST_VIDEO_FORMAT_I420:
+    case GST_VIDEO_FORMAT_YUY2:
+        fill_from_yuv(frame, columns, rows, transform, target_planes, stride);
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+const char* input_blob_kernel()
+{
+#if defined(INPUT_BLOB_AVX2)
+    return "avx2";
+#elif defined(INPUT_BLOB_NEON)
+    return "neon";
+#elif defined(INPUT_BLOB_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+gboolean frame_to_bgr(const FrameView& frame, cv::Mat& bgr)
+{
+    if (frame.empty())
+    {
+        return FALSE;
+    }
+
+    switch (frame.format)
+    {
+    case GST_VIDEO_FORMAT_BGR:
+        bgr = frame.planes[0];
+        return TRUE;
+    case GST_VIDEO_FORMAT_NV12:
+        cv::cvtColorTwoPlane(frame.planes[0], frame.planes[1], bgr, cv::COLOR_YUV2BGR_NV12);
+        return TRUE;
+    case GST_VIDEO_FORMAT_I420:
+        {
+            cv::Mat uv;
+            cv::merge(std::vector<cv::Mat>{ frame.planes[1], frame.planes[2] }, uv);
+            cv::cvtColorTwoPlane(frame.planes[0], uv, bgr, cv::COLOR_YUV2BGR_NV12);
+        }
+        return TRUE;
+    case GST_VIDEO_FORMAT_YUY2:
+        cv::cvtColor(frame.planes[0], bgr, cv::COLOR_YUV2BGR_YUY2);
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
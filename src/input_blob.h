@@ -0,0 +1,111 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __INPUT_BLOB_H__
+#define __INPUT_BLOB_H__
+
+#include <gst/gst.h>
+#include <opencv2/core.hpp>
+#include "frame_view.h"
+
+/**
+ * Network input transform applied while filling a blob.
+ */
+struct InputBlobParams {
+
+    // Network input size
+    cv::Size size;
+
+    // Scale applied after the mean has been subtracted
+    float scale = 1.0;
+
+    // Mean subtracted from every channel
+    float mean = 0.0;
+
+    // Write channels in RGB order rather than BGR order
+    bool swap_rb = false;
+
+    // Region of the network input that the source is resampled into. Empty
+    // for the whole input. The rest of the input is filled with zeros, the
+    // normalized value of a pixel equal to the mean (letterbox padding).
+    cv::Rect target;
+};
+
+/**
+ * Resample a region of a frame into one 3xHxW image of an NCHW float blob.
+ * Color conversion, bilinear resizing and normalization are done in a single
+ * pass, and only the source pixels that are actually sampled are read. For
+ * BGR frames the result matches cv::dnn::blobFromImage without cropping.
+ * Chroma is sampled at the nearest position.
+ *
+ * @param frame Source frame (BGR, NV12, I420 or YUY2)
+ * @param source Region of the frame that is mapped onto the network input,
+ *               or onto params.target if it is set
+ * @param params Network input transform
+ * @param blob Destination. Must have room for 3 * params.size.area() floats.
+ * @return gboolean TRUE on success, FALSE if the frame format is not supported
+ */
+gboolean fill_input_blob(
+    const FrameView&       frame,
+    const cv::Rect&        source,
+    const InputBlobParams& params,
+    float*                 blob);
+
+/**
+ * Name of the SIMD kernel that fill_input_blob() was compiled with.
+ *
+ * @return const char* "avx2", "neon", "sse2" or "scalar"
+ */
+const char* input_blob_kernel();
+
+/**
+ * Convert a full frame to a packed BGR image. BGR frames are referenced, not
+ * copied.
+ *
+ * @param frame Source frame (BGR, NV12, I420 or YUY2)
+ * @param bgr Converted image
+ * @return gboolean TRUE on success, FALSE if the frame format is not supported
+ */
+gboolean frame_to_bgr(const FrameView& frame, cv::Mat& bgr);
+
+#endif // __INPUT_BLOB_H__
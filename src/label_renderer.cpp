@@ -0,0 +1,273 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+#include "label_renderer.h"
+
+namespace {
+
+const int kFontFace = cv::FONT_HERSHEY_SIMPLEX;
+
+// Margin around each rasterized entry, so anti-aliased edges are not clipped
+const int kPadding = 1;
+
+/**
+ * Rasterize text into a coverage mask.
+ */
+cv::Mat rasterize(const std::string& text, double font_scale, int font_thickness)
+{
+    int baseline = 0;
+    cv::Size size = cv::getTextSize(text, kFontFace, font_scale, font_thickness, &baseline);
+
+    cv::Mat mask = cv::Mat::zeros(
+        size.height + baseline + 2 * kPadding,
+        size.width + 2 * kPadding,
+        CV_8UC1);
+
+    cv::putText(
+        mask,
+        text,
+        cv::Point(kPadding, kPadding + size.height),
+        kFontFace,
+        font_scale,
+        cv::Scalar(255),
+        font_thickness,
+        cv::LINE_AA);
+
+    return mask;
+}
+
+/**
+ * Convert a color to one byte per image channel.
+ */
+void to_pixel(const cv::Scalar& color, int channels, uchar* pixel)
+{
+    for (int channel = 0; channel < channels; ++channel)
+    {
+        pixel[channel] = cv::saturate_cast<uchar>(color[channel]);
+    }
+}
+
+} // namespace
+
+LabelRenderer::LabelRenderer()
+    : blend_(true)
+    , space_width_(0)
+{
+}
+
+void LabelRenderer::initialize(
+    const std::vector<std::string>& class_names,
+    double                          font_scale,
+    int                             font_thickness)
+{
+    std::vector<std::string> texts;
+
+    for (const auto& class_name : class_names)
+    {
+        if (!class_name.empty())
+        {
+            texts.push_back(class_name);
+        }
+    }
+
+    for (char glyph : std::string("0123456789."))
+    {
+        texts.push_back(std::string(1, glyph));
+    }
+
+    std::vector<cv::Mat> masks;
+    masks.reserve(texts.size());
+
+    int atlas_width = 0;
+    int atlas_height = 0;
+
+    for (const auto& text : texts)
+    {
+        masks.push_back(rasterize(text, font_scale, font_thickness));
+        atlas_width = std::max(atlas_width, masks.back().cols);
+        atlas_height += masks.back().rows;
+    }
+
+    // Entries are stacked vertically
+    atlas_ = cv::Mat::zeros(atlas_height, atlas_width, CV_8UC1);
+    labels_.clear();
+
+    int top = 0;
+    const std::size_t num_labels = texts.size() - glyphs_.size();
+
+    for (std::size_t index = 0; index < texts.size(); ++index)
+    {
+        cv::Rect entry(0, top, masks[index].cols, masks[index].rows);
+        masks[index].copyTo(atlas_(entry));
+        top += entry.height;
+
+        if (index < num_labels)
+        {
+            labels_[texts[index]] = entry;
+        }
+        else
+        {
+            glyphs_[index - num_labels] = entry;
+        }
+    }
+
+    int baseline = 0;
+    space_width_ = cv::getTextSize(" ", kFontFace, font_scale, font_thickness, &baseline).width;
+}
+
+void LabelRenderer::set_blend(bool blend)
+{
+    blend_ = blend;
+}
+
+void LabelRenderer::draw_box(cv::Mat& image, const cv::Rect& box, const cv::Scalar& color, int thickness) const
+{
+    const cv::Rect bounds(0, 0, image.cols, image.rows);
+    const cv::Rect clipped = box & bounds;
+
+    if (clipped.empty())
+    {
+        return;
+    }
+
+    const int width = std::min(thickness, clipped.width);
+    const int height = std::min(thickness, clipped.height);
+
+    const cv::Rect strips[] = {
+        cv::Rect(clipped.x, clipped.y, clipped.width, height),
+        cv::Rect(clipped.x, clipped.y + clipped.height - height, clipped.width, height),
+        cv::Rect(clipped.x, clipped.y, width, clipped.height),
+        cv::Rect(clipped.x + clipped.width - width, clipped.y, width, clipped.height)
+    };
+
+    for (const auto& strip : strips)
+    {
+        image(strip).setTo(color);
+    }
+}
+
+void LabelRenderer::draw_label(
+    cv::Mat&           image,
+    cv::Point          origin,
+    const std::string& class_name,
+    float              confidence,
+    const cv::Scalar&  color) const
+{
+    if (atlas_.empty() || image.empty() || (image.depth() != CV_8U) || (image.channels() > 4))
+    {
+        return;
+    }
+
+    uchar pixel[4];
+    to_pixel(color, image.channels(), pixel);
+
+    auto label = labels_.find(class_name);
+    if (label != labels_.end())
+    {
+        blit(label->second, image, origin, pixel);
+        origin.x += label->second.width + space_width_;
+    }
+
+    // Confidence as "d.dd"
+    int hundredths = static_cast<int>(std::lround(std::min(1.0f, std::max(0.0f, confidence)) * 100.0f));
+    const int digits[] = { hundredths / 100, 10, (hundredths / 10) % 10, hundredths % 10 };
+
+    for (int digit : digits)
+    {
+        const cv::Rect& glyph = glyphs_[static_cast<std::size_t>(digit)];
+        blit(glyph, image, origin, pixel);
+        origin.x += glyph.width - 2 * kPadding;
+    }
+}
+
+void LabelRenderer::blit(const cv::Rect& entry, cv::Mat& image, cv::Point origin, const uchar* color) const
+{
+    const cv::Rect target = cv::Rect(origin, entry.size()) & cv::Rect(0, 0, image.cols, image.rows);
+
+    if (target.empty())
+    {
+        return;
+    }
+
+    const int channels = image.channels();
+    const int offset_x = entry.x + target.x - origin.x;
+    const int offset_y = entry.y + target.y - origin.y;
+
+    for (int y = 0; y < target.height; ++y)
+    {
+        const uchar* coverage = atlas_.ptr<uchar>(offset_y + y) + offset_x;
+        uchar* pixel = image.ptr<uchar>(target.y + y) + target.x * channels;
+
+        for (int x = 0; x < target.width; ++x, pixel += channels)
+        {
+            const int alpha = coverage[x];
+
+            if (alpha == 0)
+            {
+                continue;
+            }
+
+            if ((alpha == 255) || !blend_)
+            {
+                if (blend_ || (alpha >= 128))
+                {
+                    for (int channel = 0; channel < channels; ++channel)
+                    {
+                        pixel[channel] = color[channel];
+                    }
+                }
+            }
+            else
+            {
+                for (int channel = 0; channel < channels; ++channel)
+                {
+                    pixel[channel] = static_cast<uchar>(
+                        pixel[channel] + ((color[channel] - pixel[channel]) * alpha + 127) / 255);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,149 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __LABEL_RENDERER_H__
+#define __LABEL_RENDERER_H__
+
+#include <array>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <opencv2/core.hpp>
+
+/**
+ * Draws detection boxes and labels without rasterizing text per frame.
+ *
+ * Every class name and the glyphs needed to print a confidence score are
+ * rasterized once, as anti-aliased coverage masks, into a single 8-bit glyph
+ * atlas. Labels are then drawn by blending the atlas entries into the image
+ * in the requested color, so the cost of drawing a label only depends on its
+ * size in pixels. Boxes are drawn as four filled strips.
+ *
+ * Images may have one (luma), two (packed YUY2) or three (BGR) channels.
+ */
+class LabelRenderer {
+public:
+
+    static constexpr double kDefaultFontScale = 0.6;
+    static constexpr int kDefaultFontThickness = 1;
+
+    LabelRenderer();
+
+    /**
+     * Rasterize the class names and the confidence glyphs into the atlas.
+     *
+     * @param class_names Class names that labels may be drawn for
+     * @param font_scale Hershey font scale
+     * @param font_thickness Hershey font stroke thickness
+     */
+    void initialize(
+        const std::vector<std::string>& class_names,
+        double                          font_scale = kDefaultFontScale,
+        int                             font_thickness = kDefaultFontThickness);
+
+    /**
+     * Enable/disable anti-aliasing. When disabled, glyph pixels are either
+     * fully drawn or skipped, which is slightly faster.
+     *
+     * @param blend Blend glyph edges into the image
+     */
+    void set_blend(bool blend);
+
+    /**
+     * Draw the outline of a box. The outline is drawn inside the box.
+     *
+     * @param image Image to draw on
+     * @param box Box to outline
+     * @param color Color, one value per image channel
+     * @param thickness Outline thickness in pixels
+     */
+    void draw_box(cv::Mat& image, const cv::Rect& box, const cv::Scalar& color, int thickness) const;
+
+    /**
+     * Draw "<class name> <confidence>" with its top-left corner at origin.
+     * Class names that were not passed to initialize() are left out.
+     *
+     * @param image Image to draw on
+     * @param origin Top-left corner of the label
+     * @param class_name Class name
+     * @param confidence Confidence score in [0, 1], printed with two decimals
+     * @param color Color, one value per image channel
+     */
+    void draw_label(
+        cv::Mat&           image,
+        cv::Point          origin,
+        const std::string& class_name,
+        float              confidence,
+        const cv::Scalar&  color) const;
+
+
+private:
+
+    /**
+     * Blend an atlas entry into the image.
+     *
+     * @param entry Atlas entry
+     * @param image Image to draw on
+     * @param origin Top-left corner of the entry in the image
+     * @param color Color, one value per image channel
+     */
+    void blit(const cv::Rect& entry, cv::Mat& image, cv::Point origin, const uchar* color) const;
+
+
+private:
+
+    bool blend_;
+
+    // Coverage masks for every label and glyph (CV_8UC1)
+    cv::Mat atlas_;
+
+    std::unordered_map<std::string, cv::Rect> labels_;
+
+    // Glyphs for '0' to '9', then '.'
+    std::array<cv::Rect, 11> glyphs_;
+
+    // Horizontal gap between the class name and the confidence
+    int space_width_;
+};
+
+#endif // __LABEL_RENDERER_H__
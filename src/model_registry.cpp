@@ -0,0 +1,430 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "detector_debug.h"
+#include "model_registry.h"
+
+#define GST_CAT_DEFAULT detector_core_debug
+
+namespace {
+
+/**
+ * Read-only mapping of a whole file.
+ */
+class MappedFile {
+public:
+
+    explicit MappedFile(const std::string& path)
+        : data_(MAP_FAILED)
+        , size_(0)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return;
+        }
+
+        struct stat file_stat;
+        if ((fstat(fd, &file_stat) == 0) && (file_stat.st_size > 0))
+        {
+            size_ = static_cast<size_t>(file_stat.st_size);
+            data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (data_ != MAP_FAILED)
+            {
+                // The importers read the file front to back.
+                madvise(data_, size_, MADV_SEQUENTIAL);
+            }
+        }
+
+        close(fd);
+    }
+
+    ~MappedFile()
+    {
+        if (data_ != MAP_FAILED)
+        {
+            munmap(data_, size_);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator= (const MappedFile&) = delete;
+
+    bool valid() const
+    {
+        return data_ != MAP_FAILED;
+    }
+
+    const char* data() const
+    {
+        return static_cast<const char*>(data_);
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+
+private:
+
+    void* data_;
+
+    size_t size_;
+};
+
+bool has_extension(const std::string& path, const char* extension)
+{
+    const size_t length = strlen(extension);
+    return (path.size() >= length) &&
+        (path.compare(path.size() - length, length, extension) == 0);
+}
+
+/**
+ * Build the network from memory-mapped copies of its files, using the
+ * framework's in-memory importer. Returns an empty network if the files
+ * cannot be mapped or the framework is not recognized, in which case the
+ * caller falls back to loading by path.
+ */
+cv::dnn::Net read_mapped_net(const std::string& weights, const std::string& config)
+{
+    MappedFile weights_file(weights);
+    MappedFile config_file(config);
+
+    if (!weights_file.valid() || !config_file.valid())
+    {
+        return cv::dnn::Net();
+    }
+
+    if (has_extension(weights, ".pb"))
+    {
+        return cv::dnn::readNetFromTensorflow(
+            weights_file.data(), weights_file.size(),
+            config_file.data(), config_file.size());
+    }
+
+    if (has_extension(weights, ".caffemodel"))
+    {
+        return cv::dnn::readNetFromCaffe(
+            config_file.data(), config_file.size(),
+            weights_file.data(), weights_file.size());
+    }
+
+    if (has_extension(weights, ".weights"))
+    {
+        return cv::dnn::readNetFromDarknet(
+            config_file.data(), config_file.size(),
+            weights_file.data(), weights_file.size());
+    }
+
+    return cv::dnn::Net();
+}
+
+/**
+ * Quantize the network to INT8, calibrating it on the detector's
+ * preprocessed calibration images. Inputs and outputs stay FP32, so blobs
+ * are prepared and decoded as for the unquantized network.
+ */
+cv::dnn::Net quantize_net(cv::dnn::Net& net, const ModelKey& key, const ModelLoadOptions& options)
+{
+#if (CV_VERSION_MAJOR > 4) || ((CV_VERSION_MAJOR == 4) && (CV_VERSION_MINOR >= 6))
+    std::vector<cv::Mat> inputs;
+    if (options.calibration_inputs)
+    {
+        inputs = options.calibration_inputs();
+    }
+
+    if (inputs.empty())
+    {
+        CV_Error(cv::Error::StsBadArg, "No calibration images found in '" + key.calibration + "'");
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    cv::dnn::Net quantized = net.quantize(inputs, CV_32F, CV_32F);
+
+    auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start_time).count();
+
+    GST_INFO("Quantized '%s' to INT8 with %zu calibration images in %lld ms",
+        key.weights.c_str(), inputs.size(), static_cast<long long>(elapsed_ms));
+
+    return quantized;
+#else
+    (void)net;
+    (void)key;
+    (void)options;
+    CV_Error(cv::Error::StsNotImplemented, "INT8 quantization requires OpenCV 4.6 or newer");
+    return cv::dnn::Net();
+#endif
+}
+
+}
+
+bool ModelKey::operator< (const ModelKey& other) const
+{
+    return std::tie(owner, config, weights, backend, target, calibration, replica,
+            input_width, input_height) <
+        std::tie(other.owner, other.config, other.weights, other.backend, other.target,
+            other.calibration, other.replica, other.input_width, other.input_height);
+}
+
+SharedModel::SharedModel(const ModelKey& key, cv::dnn::DetectionModel model)
+    : key_(key)
+    , model_(std::move(model))
+{
+}
+
+const ModelKey& SharedModel::key() const
+{
+    return key_;
+}
+
+cv::dnn::DetectionModel& SharedModel::model()
+{
+    return model_;
+}
+
+std::mutex& SharedModel::lock()
+{
+    return lock_;
+}
+
+ModelRegistry::ModelRegistry()
+{
+    detector_debug_init();
+}
+
+ModelRegistry& ModelRegistry::instance()
+{
+    static ModelRegistry registry;
+    return registry;
+}
+
+std::shared_ptr<SharedModel> ModelRegistry::acquire(const ModelKey& key,
+    const ModelLoadOptions& options)
+{
+    std::promise<std::shared_ptr<SharedModel>> loaded;
+    std::shared_future<std::shared_ptr<SharedModel>> loading;
+
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+
+        erase_expired();
+
+        Entry& entry = models_[key];
+
+        std::shared_ptr<SharedModel> model = entry.model.lock();
+        if (model)
+        {
+            GST_INFO("Sharing detection model '%s' (replica %zu, %ld users)",
+                key.weights.c_str(), key.replica, model.use_count());
+            return model;
+        }
+
+        // A detector that asks for a model while another one loads it waits
+        // for that load rather than loading a second copy.
+        if (entry.loading.valid())
+        {
+            loading = entry.loading;
+        }
+        else
+        {
+            entry.loading = loaded.get_future().share();
+        }
+    }
+
+    if (loading.valid())
+    {
+        return loading.get();
+    }
+
+    // Other models may load at the same time, so the resident set change
+    // is only exact if nothing else is loading.
+    size_t resident_before = resident_set_bytes();
+    auto start_time = std::chrono::steady_clock::now();
+
+    std::shared_ptr<SharedModel> model;
+
+    try
+    {
+        model = load(key, options);
+    }
+    catch (...)
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            models_.erase(key);
+        }
+
+        loaded.set_exception(std::current_exception());
+        throw;
+    }
+
+    auto load_time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start_time).count();
+
+    long resident_bytes =
+        static_cast<long>(resident_set_bytes()) - static_cast<long>(resident_before);
+
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+
+        Entry& entry = models_[key];
+        entry.model = model;
+        entry.loading = std::shared_future<std::shared_ptr<SharedModel>>();
+        entry.resident_bytes = resident_bytes;
+    }
+
+    loaded.set_value(model);
+
+    GST_INFO("Loaded detection model '%s' (replica %zu, %s, %lld ms, %+ld KiB resident)",
+        key.weights.c_str(), key.replica, options.map_files ? "mapped" : "read",
+        static_cast<long long>(load_time_ms), resident_bytes / 1024);
+
+    return model;
+}
+
+std::shared_ptr<SharedModel> ModelRegistry::load(const ModelKey& key,
+    const ModelLoadOptions& options)
+{
+    cv::dnn::Net net;
+
+    if (options.map_files)
+    {
+        net = read_mapped_net(key.weights, key.config);
+
+        if (net.empty())
+        {
+            GST_WARNING("Cannot map '%s', loading it from the file instead",
+                key.weights.c_str());
+        }
+    }
+
+    if (net.empty())
+    {
+        net = cv::dnn::readNet(key.weights, key.config);
+    }
+
+    if (!key.calibration.empty())
+    {
+        net = quantize_net(net, key, options);
+    }
+
+    cv::dnn::DetectionModel detection_model(net);
+    detection_model.setPreferableBackend(static_cast<cv::dnn::Backend>(key.backend));
+    detection_model.setPreferableTarget(static_cast<cv::dnn::Target>(key.target));
+
+    return std::make_shared<SharedModel>(key, std::move(detection_model));
+}
+
+void ModelRegistry::erase_expired()
+{
+    for (auto it = models_.begin(); it != models_.end();)
+    {
+        if (it->second.model.expired() && !it->second.loading.valid())
+        {
+            it = models_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+std::string ModelRegistry::memory_report() const
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    std::ostringstream report;
+
+    for (const auto& item : models_)
+    {
+        long users = item.second.model.use_count();
+        if (users == 0)
+        {
+            continue;
+        }
+
+        report << item.first.weights
+               << " (backend " << item.first.backend
+               << ", target " << item.first.target
+               << ", replica " << item.first.replica
+               << ", input " << item.first.input_width << "x" << item.first.input_height
+               << (item.first.calibration.empty() ? "" : ", int8")
+               << (item.first.owner ? ", private" : "") << "): "
+               << users << " users, "
+               << item.second.resident_bytes / 1024 << " KiB resident\n";
+    }
+
+    report << "Process resident set: " << resident_set_bytes() / 1024 << " KiB\n";
+
+    return report.str();
+}
+
+size_t ModelRegistry::resident_set_bytes()
+{
+    // The second field of statm is the resident set size in pages.
+    std::ifstream statm("/proc/self/statm");
+
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+
+    if (!(statm >> total_pages >> resident_pages))
+    {
+        return 0;
+    }
+
+    return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
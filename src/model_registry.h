@@ -0,0 +1,230 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __MODEL_REGISTRY_H__
+#define __MODEL_REGISTRY_H__
+
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <opencv2/dnn/dnn.hpp>
+
+/**
+ * Identifies a loaded network. Detectors with equal keys share one network.
+ */
+struct ModelKey {
+
+    // Detector that owns a private network, or 0 for a network that any
+    // detector with the same key may share.
+    size_t owner = 0;
+
+    std::string config;
+    std::string weights;
+
+    int backend = cv::dnn::DNN_BACKEND_DEFAULT;
+    int target = cv::dnn::DNN_TARGET_CPU;
+
+    // Directory of calibration images the network is quantized to INT8
+    // with. Empty for the unquantized network.
+    std::string calibration;
+
+    // Shared networks that must run inference concurrently (for example
+    // the workers of a pipelined detector) use different replicas.
+    size_t replica = 0;
+
+    // Input size the network runs at. OpenCV reshapes a network whenever
+    // its input shape changes, so detectors that run at different sizes
+    // use different copies. 0x0 if the size is not fixed.
+    int input_width = 0;
+    int input_height = 0;
+
+    bool operator< (const ModelKey& other) const;
+};
+
+/**
+ * How to load a model that is not loaded yet. Detectors sharing a model
+ * only pay for these when they are the first to load it.
+ */
+struct ModelLoadOptions {
+
+    // Build the network from memory-mapped files rather than letting
+    // OpenCV read them into the heap
+    bool map_files = false;
+
+    // Produces the network input blobs used to calibrate quantization.
+    // Required if the key has a calibration directory.
+    std::function<std::vector<cv::Mat>()> calibration_inputs;
+};
+
+/**
+ * A network used by every detector with the same key. The weights are
+ * parsed and stored once; each detector keeps its own input blobs and
+ * outputs. A network can only run one forward pass at a time, so forward
+ * passes (and changes to the model's input parameters) must hold the lock.
+ * Detectors sharing a network therefore run their forward passes one after
+ * the other; the lock is uncontended for a private network.
+ */
+class SharedModel {
+public:
+
+    SharedModel(const ModelKey& key, cv::dnn::DetectionModel model);
+
+    SharedModel(const SharedModel&) = delete;
+    SharedModel& operator= (const SharedModel&) = delete;
+
+    /**
+     * Key the model was loaded with.
+     *
+     * @return const ModelKey&
+     */
+    const ModelKey& key() const;
+
+    /**
+     * Loaded model. Hold lock() while using it.
+     *
+     * @return cv::dnn::DetectionModel&
+     */
+    cv::dnn::DetectionModel& model();
+
+    /**
+     * Lock that serializes use of the model.
+     *
+     * @return std::mutex&
+     */
+    std::mutex& lock();
+
+
+private:
+
+    ModelKey key_;
+
+    cv::dnn::DetectionModel model_;
+
+    std::mutex lock_;
+};
+
+/**
+ * Process-wide registry of loaded networks. Networks are loaded on first
+ * use and released when the last detector using them releases its
+ * reference. Different networks load concurrently; detectors that ask for
+ * a network while it is being loaded wait for that load.
+ */
+class ModelRegistry {
+public:
+
+    /**
+     * Registry shared by every detector in the process.
+     *
+     * @return ModelRegistry&
+     */
+    static ModelRegistry& instance();
+
+    /**
+     * Get the model for the key, loading it if no detector holds it yet.
+     * Throws cv::Exception if the model cannot be loaded, both to the
+     * detector that loaded it and to any detector waiting for it.
+     *
+     * @param key Model key
+     * @param options Load options. Only used if the model has to be loaded.
+     * @return std::shared_ptr<SharedModel> Shared model
+     */
+    std::shared_ptr<SharedModel> acquire(const ModelKey& key,
+        const ModelLoadOptions& options = ModelLoadOptions());
+
+    /**
+     * Describe every loaded model: its key, the number of detectors using
+     * it, and the resident memory it added when it was loaded.
+     *
+     * @return std::string One line per model
+     */
+    std::string memory_report() const;
+
+    /**
+     * Resident set size of the process.
+     *
+     * @return size_t Size in bytes, or 0 if it cannot be read
+     */
+    static size_t resident_set_bytes();
+
+
+private:
+
+    ModelRegistry();
+
+    struct Entry {
+
+        std::weak_ptr<SharedModel> model;
+
+        // Valid while the model is being loaded
+        std::shared_future<std::shared_ptr<SharedModel>> loading;
+
+        // Change in resident set size while the model was loaded
+        long resident_bytes = 0;
+    };
+
+    /**
+     * Load the network for the key. Called without the registry lock.
+     *
+     * @param key Model key
+     * @param options Load options
+     * @return std::shared_ptr<SharedModel> Loaded model
+     */
+    static std::shared_ptr<SharedModel> load(const ModelKey& key,
+        const ModelLoadOptions& options);
+
+    /**
+     * Drop the entries of models that are neither loaded nor loading.
+     * Called with the registry lock held.
+     */
+    void erase_expired();
+
+    // Guards the entries only; models are loaded without it.
+    mutable std::mutex lock_;
+
+    std::map<ModelKey, Entry> models_;
+};
+
+#endif // __MODEL_REGISTRY_H__
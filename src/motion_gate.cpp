@@ -0,0 +1,153 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <opencv2/imgproc.hpp>
+#include "motion_gate.h"
+
+MotionGate::MotionGate()
+    : threshold_(0.0)
+    , min_interval_ms_(0)
+    , refresh_interval_ms_(0)
+    , score_(0.0)
+{
+}
+
+void MotionGate::configure(float threshold, guint min_interval_ms, guint refresh_interval_ms)
+{
+    threshold_ = threshold;
+    min_interval_ms_ = min_interval_ms;
+    refresh_interval_ms_ = refresh_interval_ms;
+}
+
+bool MotionGate::enabled() const
+{
+    return threshold_ > 0.0;
+}
+
+bool MotionGate::update(const FrameView& frame)
+{
+    if (!enabled() || !make_thumbnail(frame, thumbnail_))
+    {
+        return true;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+
+    if (!reference_.empty())
+    {
+        cv::absdiff(thumbnail_, reference_, difference_);
+
+        score_ = static_cast<float>(cv::countNonZero(difference_ > kPixelThreshold)) /
+            static_cast<float>(difference_.total());
+
+        const long long elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            now - last_detection_).count();
+
+        const bool refresh = (refresh_interval_ms_ > 0) &&
+            (elapsed_ms >= static_cast<long long>(refresh_interval_ms_));
+        const bool moved = (score_ >= threshold_) &&
+            (elapsed_ms >= static_cast<long long>(min_interval_ms_));
+
+        if (!refresh && !moved)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        score_ = 1.0;
+    }
+
+    thumbnail_.copyTo(reference_);
+    last_detection_ = now;
+
+    return true;
+}
+
+float MotionGate::score() const
+{
+    return score_;
+}
+
+void MotionGate::reset()
+{
+    reference_.release();
+    score_ = 0.0;
+}
+
+bool MotionGate::make_thumbnail(const FrameView& frame, cv::Mat& thumbnail) const
+{
+    if (frame.empty())
+    {
+        return false;
+    }
+
+    // Area interpolation averages every source pixel, which also smooths
+    // out sensor noise.
+    const cv::Size size(kThumbnailWidth, kThumbnailHeight);
+
+    switch (frame.format)
+    {
+    case GST_VIDEO_FORMAT_BGR:
+        {
+            cv::Mat small;
+            cv::resize(frame.planes[0], small, size, 0, 0, cv::INTER_AREA);
+            cv::cvtColor(small, thumbnail, cv::COLOR_BGR2GRAY);
+        }
+        return true;
+    case GST_VIDEO_FORMAT_NV12:
+    case GST_VIDEO_FORMAT_I420:
+        cv::resize(frame.planes[0], thumbnail, size, 0, 0, cv::INTER_AREA);
+        return true;
+    case GST_VIDEO_FORMAT_YUY2:
+        {
+            // Every element holds a luma sample in its first channel.
+            cv::Mat small;
+            cv::resize(frame.planes[0], small, size, 0, 0, cv::INTER_AREA);
+            cv::extractChannel(small, thumbnail, 0);
+        }
+        return true;
+    default:
+        return false;
+    }
+}
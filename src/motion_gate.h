@@ -0,0 +1,145 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __MOTION_GATE_H__
+#define __MOTION_GATE_H__
+
+#include <chrono>
+#include <glib.h>
+#include <opencv2/core.hpp>
+#include "frame_view.h"
+
+/**
+ * Decides whether a frame has changed enough since the last inference to be
+ * worth running through the network. Each frame is reduced to a small luma
+ * thumbnail, which is compared against the thumbnail of the frame that was
+ * last detected. The motion score is the fraction of thumbnail pixels that
+ * differ by more than kPixelThreshold.
+ */
+class MotionGate {
+public:
+
+    static constexpr int kThumbnailWidth = 64;
+    static constexpr int kThumbnailHeight = 48;
+
+    // Luma difference at which a thumbnail pixel counts as changed
+    static constexpr int kPixelThreshold = 20;
+
+    MotionGate();
+    MotionGate( const MotionGate& ) = delete;
+    MotionGate& operator= ( const MotionGate& ) = delete;
+
+    /**
+     * Configure the gate.
+     *
+     * @param threshold Motion score, in [0, 1], at which a frame is detected.
+     *                  0 disables the gate and every frame is detected.
+     * @param min_interval_ms Minimum time between two detections triggered
+     *                        by motion
+     * @param refresh_interval_ms Time after which a frame is detected even
+     *                            without motion. 0 never forces a detection.
+     */
+    void configure(float threshold, guint min_interval_ms, guint refresh_interval_ms);
+
+    /**
+     * Check whether the gate is enabled.
+     *
+     * @return bool
+     */
+    bool enabled() const;
+
+    /**
+     * Score the frame against the last detected frame. If the frame should
+     * be detected, it becomes the new reference.
+     *
+     * @param frame Input frame (BGR, NV12, I420 or YUY2)
+     * @return bool true if the frame should be detected, false if the
+     *              previous detections still apply
+     */
+    bool update(const FrameView& frame);
+
+    /**
+     * Motion score of the last frame passed to update().
+     *
+     * @return float Fraction of changed thumbnail pixels
+     */
+    float score() const;
+
+    /**
+     * Forget the reference frame, so that the next frame is detected.
+     */
+    void reset();
+
+
+private:
+
+    /**
+     * Downscale the luma of a frame to the thumbnail size.
+     *
+     * @param frame Input frame
+     * @param thumbnail Thumbnail (CV_8UC1)
+     * @return bool false if the frame format is not supported
+     */
+    bool make_thumbnail(const FrameView& frame, cv::Mat& thumbnail) const;
+
+
+private:
+
+    float threshold_;
+
+    guint min_interval_ms_;
+
+    guint refresh_interval_ms_;
+
+    // Thumbnail of the last detected frame
+    cv::Mat reference_;
+
+    cv::Mat thumbnail_;
+    cv::Mat difference_;
+
+    float score_;
+
+    std::chrono::steady_clock::time_point last_detection_;
+};
+
+#endif // __MOTION_GATE_H__
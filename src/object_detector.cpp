@@ -41,9 +41,26 @@
  * Boston, MA 02111-1307, USA.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
 #include <fstream>
+#include "detector_debug.h"
 #include "object_detector.h"
 
+#define GST_CAT_DEFAULT detector_core_debug
+
+namespace {
+
+size_t next_model_owner()
+{
+    static std::atomic<size_t> next_owner(1);
+    return next_owner++;
+}
+
+}
+
 class Timer {
 public:
 
@@ -98,8 +115,27 @@ ObjectDetector::ObjectDetector()
     , crop_size_(cv::Size(ObjectDetector::kDefaultCropWidth, ObjectDetector::kDefaultCropHeight))
     , conf_threshold_(ObjectDetector::kDefaultConfidenceThreshold)
     , nms_threshold_(ObjectDetector::kDefaultNmsThreshold)
+    , input_scale_(ObjectDetector::kDefaultScale)
+    , input_mean_(ObjectDetector::kDefaultInputMean)
+    , swap_rb_(true)
+    , decode_outputs_(false)
+    , model_owner_(next_model_owner())
+    , share_model_(false)
+    , replica_(0)
+    , map_files_(false)
+    , backend_(cv::dnn::DNN_BACKEND_DEFAULT)
+    , target_(cv::dnn::DNN_TARGET_CPU)
+    , input_geometry_(InputGeometry::Stretch)
+    , tile_columns_(1)
+    , tile_rows_(1)
+    , tile_overlap_(0.0)
+    , refine_interval_(0)
+    , refine_margin_(0.0)
+    , inferences_since_refine_(0)
+    , refine_requested_(false)
     , annotation_enabled_(false)
 {
+    detector_debug_init();
 }
 
 gboolean ObjectDetector::initialize(
@@ -117,34 +153,88 @@ gboolean ObjectDetector::initialize(
 
     if (config_file && weights_file && class_names_file)
     {
-        g_print("Creating detection model.\n");
+        GST_INFO("Creating detection model from '%s' and '%s'.", config_file, weights_file);
 
         success = parse_class_names(class_names_file, class_names_);
 
         if (success)
         {
-            model_ = std::make_unique<cv::dnn::DetectionModel>(
-                weights_file,
-                config_file
-            );
+            label_renderer_.initialize(class_names_);
 
             conf_threshold_ = conf_threshold;
             nms_threshold_ = nms_threshold;
 
-            // Override the input size. If the image size and the input size
-            // are not equal, OpenCV performs a crop from the center of the
-            // input image.
+            // The input size, scale, mean and channel order are applied to
+            // the shared model before each DetectionModel::detect call.
             crop_size_ = crop;
-            model_->setInputSize(crop);
+            input_scale_ = input_scale;
+            input_mean_ = input_mean;
+            swap_rb_ = swap_rb;
+
+            // Detectors that share the network and use the same files get
+            // one copy of it. Otherwise the key is private to this detector.
+            ModelKey key;
+            key.owner = share_model_ ? 0 : model_owner_;
+            key.config = config_file;
+            key.weights = weights_file;
+            key.backend = backend_;
+            key.target = target_;
+            key.calibration = calibration_dir_;
+            key.replica = replica_;
+
+            ModelLoadOptions options;
+            options.map_files = map_files_;
+
+            const bool refine = !refine_size_.empty() && (refine_size_ != crop_size_);
+
+            try
+            {
+                model_ = acquire_model(key, crop_size_, options);
+                refine_model_ = refine ? acquire_model(key, refine_size_, options) : nullptr;
+            }
+            catch (const cv::Exception& e)
+            {
+                GST_WARNING("Failed to load detection model: %s", e.what());
+                return FALSE;
+            }
+
+            inferences_since_refine_ = 0;
+            refine_requested_ = false;
+
+            // SSD-style networks end in a DetectionOutput layer, which is
+            // decoded here so that blob preparation, the forward pass and
+            // decoding can run as separate stages. Networks that need image
+            // info as an input are left to DetectionModel.
+            std::lock_guard<std::mutex> lock(model_->lock());
+
+            cv::dnn::Net& net = model_->model().getNetwork_();
+            std::vector<cv::String> layer_names = net.getLayerNames();
 
-            model_->setInputScale(input_scale);
-            model_->setInputMean(input_mean);
-            model_->setInputSwapRB(swap_rb);
+            decode_outputs_ = !layer_names.empty() &&
+                (net.getLayer(0)->outputNameToIndex("im_info") == -1) &&
+                (net.getLayer(net.getLayerId(layer_names.back()))->type == "DetectionOutput");
+
+            output_names_ = net.getUnconnectedOutLayersNames();
+
+            if (decode_outputs_)
+            {
+                const int tiles = tile_columns_ * tile_rows_;
+
+                const int shape[] = { tiles, 3, crop_size_.height, crop_size_.width };
+                input_blob_.create(4, shape, CV_32F);
+
+                if (refine_model_)
+                {
+                    const int refine_shape[] = { tiles, 3, refine_size_.height, refine_size_.width };
+                    refine_blob_.create(4, refine_shape, CV_32F);
+                }
+            }
 
             initialized_ = TRUE;
         }
         else
         {
+            GST_WARNING("Failed to read class names from '%s'.", class_names_file);
             success = false;
         }
     }
@@ -152,6 +242,216 @@ gboolean ObjectDetector::initialize(
     return success;
 }
 
+gboolean ObjectDetector::warm_up()
+{
+    if (!is_initialized())
+    {
+        return FALSE;
+    }
+
+    // OpenCV's worker threads are started by the first forward pass, so
+    // they inherit the thread settings. The loading thread only has them
+    // for the duration of the warm-up.
+    ScopedThreadSettings scoped_settings(thread_settings_);
+
+    // Each input size has its own network, which is set up separately.
+    std::vector<cv::Size> input_sizes(1, crop_size_);
+    if (refine_model_)
+    {
+        input_sizes.push_back(refine_size_);
+    }
+
+    try
+    {
+        for (const auto& input_size : input_sizes)
+        {
+            if (decode_outputs_)
+            {
+                cv::Mat& blob = (input_size == crop_size_) ? input_blob_ : refine_blob_;
+                blob.setTo(cv::Scalar::all(0));
+
+                std::vector<cv::Mat> outputs;
+                forward(blob, outputs);
+            }
+            else
+            {
+                cv::Mat image(input_size, CV_8UC3, cv::Scalar::all(0));
+
+                std::vector<int> class_ids;
+                std::vector<float> confidences;
+                std::vector<cv::Rect> boxes;
+                detect(image, input_size, class_ids, confidences, boxes);
+            }
+        }
+    }
+    catch (const cv::Exception& e)
+    {
+        GST_WARNING("Warm-up inference failed: %s", e.what());
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+void ObjectDetector::set_share_model(bool share_model)
+{
+    share_model_ = share_model;
+}
+
+void ObjectDetector::set_model_replica(size_t replica)
+{
+    replica_ = replica;
+}
+
+void ObjectDetector::set_map_files(bool map_files)
+{
+    map_files_ = map_files;
+}
+
+gboolean ObjectDetector::set_backend(int backend, int target)
+{
+    std::vector<cv::dnn::Target> targets =
+        cv::dnn::getAvailableTargets(static_cast<cv::dnn::Backend>(backend));
+
+    if (std::find(targets.begin(), targets.end(), target) == targets.end())
+    {
+        GST_WARNING("DNN target %d is not available with backend %d.", target, backend);
+        return FALSE;
+    }
+
+    backend_ = backend;
+    target_ = target;
+
+    return TRUE;
+}
+
+void ObjectDetector::set_input_geometry(InputGeometry geometry, const cv::Rect& roi)
+{
+    input_geometry_ = geometry;
+    input_roi_ = roi;
+}
+
+void ObjectDetector::set_detection_mask(const std::vector<std::vector<cv::Point>>& regions)
+{
+    detection_mask_ = regions;
+}
+
+void ObjectDetector::set_tiling(int columns, int rows, float overlap)
+{
+    tile_columns_ = std::max(1, columns);
+    tile_rows_ = std::max(1, rows);
+    tile_overlap_ = std::max(0.0f, std::min(overlap, 0.9f));
+}
+
+void ObjectDetector::set_refinement(const cv::Size& size, guint interval, float margin)
+{
+    refine_size_ = size;
+    refine_interval_ = interval;
+    refine_margin_ = std::max(0.0f, margin);
+}
+
+void ObjectDetector::set_calibration_dir(const gchar* calibration_dir)
+{
+    calibration_dir_ = calibration_dir ? calibration_dir : "";
+}
+
+std::vector<cv::Mat> ObjectDetector::load_calibration_inputs(
+    cv::Size crop,
+    float    input_scale,
+    float    input_mean,
+    bool     swap_rb) const
+{
+    std::vector<cv::String> paths;
+    cv::glob(calibration_dir_, paths, false);
+
+    std::vector<cv::Mat> inputs;
+
+    for (const auto& path : paths)
+    {
+        if (inputs.size() >= kMaxCalibrationImages)
+        {
+            break;
+        }
+
+        cv::Mat image = cv::imread(path, cv::IMREAD_COLOR);
+        if (image.empty())
+        {
+            continue;
+        }
+
+        // Same transform as the blobs filled from video frames: the whole
+        // image is scaled to the crop size.
+        inputs.push_back(cv::dnn::blobFromImage(
+            image, input_scale, crop, cv::Scalar::all(input_mean), swap_rb, false));
+    }
+
+    return inputs;
+}
+
+void ObjectDetector::set_thread_settings(const ThreadSettings& settings)
+{
+    thread_settings_ = settings;
+}
+
+const ThreadSettings& ObjectDetector::thread_settings() const
+{
+    return thread_settings_;
+}
+
+std::shared_ptr<SharedModel> ObjectDetector::acquire_model(
+    ModelKey key,
+    const cv::Size& input_size,
+    ModelLoadOptions options) const
+{
+    key.input_width = input_size.width;
+    key.input_height = input_size.height;
+
+    // Quantization is calibrated at the size the network runs at.
+    options.calibration_inputs = [this, input_size]()
+    {
+        return load_calibration_inputs(input_size, input_scale_, input_mean_, swap_rb_);
+    };
+
+    return ModelRegistry::instance().acquire(key, options);
+}
+
+SharedModel& ObjectDetector::model_for(const cv::Size& input_size) const
+{
+    return (refine_model_ && (input_size == refine_size_)) ? *refine_model_ : *model_;
+}
+
+void ObjectDetector::forward(const cv::Mat& blob, std::vector<cv::Mat>& outputs)
+{
+    // Blobs are NCHW.
+    SharedModel& model = model_for(cv::Size(blob.size[3], blob.size[2]));
+
+    std::lock_guard<std::mutex> lock(model.lock());
+
+    cv::dnn::Net& net = model.model().getNetwork_();
+    net.setInput(blob);
+    net.forward(outputs, output_names_);
+}
+
+void ObjectDetector::detect(
+    const cv::Mat& image,
+    const cv::Size& input_size,
+    std::vector<int>& class_ids,
+    std::vector<float>& confidences,
+    std::vector<cv::Rect>& boxes)
+{
+    SharedModel& shared_model = model_for(input_size);
+
+    std::lock_guard<std::mutex> lock(shared_model.lock());
+
+    cv::dnn::DetectionModel& model = shared_model.model();
+
+    // The image is resized to the input size without cropping; the input
+    // geometry is applied by the caller. The mean is subtracted from every
+    // channel.
+    model.setInputParams(input_scale_, input_size, cv::Scalar::all(input_mean_), swap_rb_);
+    model.detect(image, class_ids, confidences, boxes, conf_threshold_, nms_threshold_);
+}
+
 gboolean ObjectDetector::is_initialized() const
 {
     return initialized_;
@@ -166,6 +466,9 @@ gboolean ObjectDetector::parse_class_names(const gchar* filename, std::vector<st
 {
     std::ifstream file(filename);
 
+    // A retry after a failed load must not append the names again.
+    class_names.clear();
+
     if (file.is_open())
     {
         std::string line;
@@ -182,6 +485,13 @@ gboolean ObjectDetector::parse_class_names(const gchar* filename, std::vector<st
     }
 }
 
+void ObjectDetector::reuse_detections(DetectionList& detection_list)
+{
+    detection_list.info.timestamp = create_timestamp();
+    detection_list.info.elapsed_time_ms = 0;
+    detection_list.info.reused = true;
+}
+
 uint64_t ObjectDetector::create_timestamp()
 {
     using namespace std::chrono;
@@ -198,68 +508,641 @@ uint64_t ObjectDetector::create_timestamp()
 
 gboolean ObjectDetector::get_objects(cv::Mat& image, DetectionList& detection_list)
 {
+    if (get_objects(FrameView::from_bgr(image), detection_list))
+    {
+        if (annotation_enabled_)
+        {
+            annotate(detection_list, image);
+        }
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+gboolean ObjectDetector::get_objects(const FrameView& frame, DetectionList& detection_list)
+{
+    InferenceRequest request;
+
+    // preprocess() fills the preallocated blob for the input size in place
+    request.input_size = next_input_size();
+    request.blob = (request.input_size == crop_size_) ? input_blob_ : refine_blob_;
+
+    if (preprocess(frame, request) && infer(request) && postprocess(request))
+    {
+        detection_list = std::move(request.detection_list);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+gboolean ObjectDetector::preprocess(const cv::Mat& image, InferenceRequest& request) const
+{
+    return preprocess(FrameView::from_bgr(image), request);
+}
+
+gboolean ObjectDetector::preprocess(const FrameView& frame, InferenceRequest& request) const
+{
+    if (!is_initialized() || frame.empty())
+    {
+        return FALSE;
+    }
+
+    Timer timer;
+
+    begin_request(frame, request, true);
+
     gboolean success = FALSE;
 
-    std::vector<int> class_ids;
-    std::vector<float> confidences;
-    std::vector<cv::Rect> boxes;
+    if (decode_outputs_)
+    {
+        // Each tile is resampled straight into its slice of the blob.
+        const cv::Size& input_size = request.input_size;
+        const int shape[] = {
+            static_cast<int>(request.regions.size()), 3, input_size.height, input_size.width };
+        const std::size_t image_size = 3 * static_cast<std::size_t>(input_size.area());
+
+        InputBlobParams params = input_blob_params(input_size);
+        params.target = request.target;
+
+        request.blob.create(4, shape, CV_32F);
+
+        success = TRUE;
+        for (std::size_t index = 0; success && (index < request.regions.size()); ++index)
+        {
+            success = fill_input_blob(
+                frame,
+                request.regions[index],
+                params,
+                request.blob.ptr<float>() + index * image_size);
+        }
+    }
+    else
+    {
+        success = frame_to_bgr(frame, request.image);
+    }
+
+    request.detection_list.info.elapsed_time_ms = timer.elapsed_ms();
+
+    return success;
+}
+
+gboolean ObjectDetector::get_objects(const std::vector<FrameView>& frames, std::vector<DetectionList>& detection_lists)
+{
+    detection_lists.clear();
+
+    if (!is_initialized())
+    {
+        return FALSE;
+    }
+
+    for (const auto& frame : frames)
+    {
+        if (frame.empty())
+        {
+            return FALSE;
+        }
+    }
+
+    if (!decode_outputs_)
+    {
+        detection_lists.resize(frames.size());
+
+        for (std::size_t index = 0; index < frames.size(); ++index)
+        {
+            if (!get_objects(frames[index], detection_lists[index]))
+            {
+                return FALSE;
+            }
+        }
+
+        return TRUE;
+    }
+
+    Timer timer;
+
+    // Each frame is converted straight into its slice of the batch blob.
+    const int shape[] = {
+        static_cast<int>(frames.size()), 3, crop_size_.height, crop_size_.width };
+    const std::size_t image_size = 3 * static_cast<std::size_t>(crop_size_.area());
+    InputBlobParams params = input_blob_params(crop_size_);
+
+    // Only reallocated when the number of streams changes
+    cv::Mat& blob = batch_blob_;
+    blob.create(4, shape, CV_32F);
+
+    std::vector<InferenceRequest> requests(frames.size());
+    for (std::size_t index = 0; index < frames.size(); ++index)
+    {
+        requests[index].input_size = crop_size_;
+        begin_request(frames[index], requests[index], false);
+        requests[index].batch_index = static_cast<int>(index);
+        params.target = requests[index].target;
+
+        if (!fill_input_blob(
+                frames[index],
+                requests[index].regions[0],
+                params,
+                blob.ptr<float>() + index * image_size))
+        {
+            return FALSE;
+        }
+    }
+
+    std::vector<cv::Mat> outputs;
+    forward(blob, outputs);
 
-    if (is_initialized())
+    // Preprocessing and inference time is shared by the whole batch.
+    uint32_t elapsed_time_ms = static_cast<uint32_t>(timer.elapsed_ms());
+
+    detection_lists.reserve(requests.size());
+
+    for (auto& request : requests)
+    {
+        request.outputs = outputs;
+        request.detection_list.info.elapsed_time_ms = elapsed_time_ms;
+
+        postprocess(request);
+
+        detection_lists.push_back(std::move(request.detection_list));
+    }
+
+    return TRUE;
+}
+
+void ObjectDetector::begin_request(const FrameView& frame, InferenceRequest& request, bool tile) const
+{
+    request.frame = frame;
+
+    if (request.input_size.empty())
+    {
+        request.input_size = next_input_size();
+    }
+
+    const cv::Size& input_size = request.input_size;
+
+    const cv::Rect source = input_source(frame.size, input_size);
+    if (tile)
+    {
+        request.regions = tile_regions(source);
+    }
+    else
+    {
+        request.regions.assign(1, source);
+    }
+
+    // Every tile has the same size, so they share one target region.
+    const cv::Size region_size = request.regions[0].size();
+    request.target = input_target(region_size, input_size);
+
+    MetaInfo& info = request.detection_list.info;
+    info.timestamp = create_timestamp();
+    info.image_width = frame.size.width;
+    info.image_height = frame.size.height;
+    info.crop_width = input_size.width;
+    info.crop_height = input_size.height;
+
+    info.input_geometry = input_geometry_;
+    info.source_x = source.x;
+    info.source_y = source.y;
+    info.source_width = source.width;
+    info.source_height = source.height;
+    info.input_scale_x = static_cast<float>(request.target.width) / std::max(1, region_size.width);
+    info.input_scale_y = static_cast<float>(request.target.height) / std::max(1, region_size.height);
+    info.input_offset_x = request.target.x;
+    info.input_offset_y = request.target.y;
+}
+
+cv::Size ObjectDetector::next_input_size() const
+{
+    if (!refine_model_)
+    {
+        return crop_size_;
+    }
+
+    bool refine = refine_requested_.exchange(false);
+
+    if ((refine_interval_ > 0) && (++inferences_since_refine_ >= refine_interval_))
+    {
+        refine = true;
+    }
+
+    if (refine)
+    {
+        inferences_since_refine_ = 0;
+        return refine_size_;
+    }
+
+    return crop_size_;
+}
+
+cv::Rect ObjectDetector::input_source(const cv::Size& frame_size, const cv::Size& input_size) const
+{
+    const cv::Rect frame_rect(cv::Point(0, 0), frame_size);
+
+    switch (input_geometry_)
+    {
+    case InputGeometry::CenterCrop:
+        {
+            // Largest region with the input's aspect ratio
+            const double scale = std::min(
+                static_cast<double>(frame_size.width) / input_size.width,
+                static_cast<double>(frame_size.height) / input_size.height);
+
+            const int width = std::max(1, std::min(frame_size.width, cvRound(input_size.width * scale)));
+            const int height = std::max(1, std::min(frame_size.height, cvRound(input_size.height * scale)));
+
+            return cv::Rect(
+                (frame_size.width - width) / 2, (frame_size.height - height) / 2, width, height);
+        }
+    case InputGeometry::Roi:
+        {
+            const cv::Rect roi = input_roi_ & frame_rect;
+            return roi.empty() ? frame_rect : roi;
+        }
+    case InputGeometry::Stretch:
+    case InputGeometry::Letterbox:
+    default:
+        return frame_rect;
+    }
+}
+
+cv::Rect ObjectDetector::input_target(const cv::Size& region_size, const cv::Size& input_size) const
+{
+    const cv::Rect input(cv::Point(0, 0), input_size);
+
+    if ((input_geometry_ != InputGeometry::Letterbox) || region_size.empty())
+    {
+        return input;
+    }
+
+    // Fit the region inside the input, keeping its aspect ratio, and center
+    // it between the padding.
+    const double scale = std::min(
+        static_cast<double>(input_size.width) / region_size.width,
+        static_cast<double>(input_size.height) / region_size.height);
+
+    const int width = std::max(1, std::min(input_size.width, cvRound(region_size.width * scale)));
+    const int height = std::max(1, std::min(input_size.height, cvRound(region_size.height * scale)));
+
+    return cv::Rect(
+        (input_size.width - width) / 2, (input_size.height - height) / 2, width, height);
+}
+
+std::vector<cv::Rect> ObjectDetector::tile_regions(const cv::Rect& source) const
+{
+    const int columns = std::min(tile_columns_, std::max(1, source.width));
+    const int rows = std::min(tile_rows_, std::max(1, source.height));
+
+    const int tile_width = std::min(source.width,
+        cvCeil(source.width / (columns - (columns - 1) * tile_overlap_)));
+    const int tile_height = std::min(source.height,
+        cvCeil(source.height / (rows - (rows - 1) * tile_overlap_)));
+
+    std::vector<cv::Rect> regions;
+    regions.reserve(static_cast<std::size_t>(columns * rows));
+
+    // The first and last tiles are flush with the region edges and the rest
+    // are spaced evenly between them.
+    for (int row = 0; row < rows; ++row)
     {
-        Timer timer;
+        int y = source.y +
+            ((rows > 1) ? cvRound(row * (source.height - tile_height) / double(rows - 1)) : 0);
+
+        for (int column = 0; column < columns; ++column)
+        {
+            int x = source.x +
+                ((columns > 1) ? cvRound(column * (source.width - tile_width) / double(columns - 1)) : 0);
+
+            regions.emplace_back(x, y, tile_width, tile_height);
+        }
+    }
+
+    return regions;
+}
 
-        detection_list.info.timestamp = create_timestamp();
-        detection_list.info.image_width = image.size().width;
-        detection_list.info.image_height = image.size().height;
-        detection_list.info.crop_width = crop_size_.width;
-        detection_list.info.crop_height = crop_size_.height;
-        
-        model_->detect(image, class_ids, confidences, boxes, conf_threshold_, nms_threshold_);
+bool ObjectDetector::in_detection_mask(const cv::Rect& box) const
+{
+    if (detection_mask_.empty())
+    {
+        return true;
+    }
 
-        detection_list.detections.reserve(class_ids.size());
+    const cv::Point2f center(box.x + box.width / 2.0f, box.y + box.height / 2.0f);
 
-        for (std::size_t index = 0; index < class_ids.size(); ++index)
+    return std::any_of(detection_mask_.begin(), detection_mask_.end(),
+        [&center](const std::vector<cv::Point>& polygon)
         {
-            Detection detection;
+            return cv::pointPolygonTest(polygon, center, false) >= 0;
+        });
+}
+
+InputBlobParams ObjectDetector::input_blob_params(const cv::Size& input_size) const
+{
+    InputBlobParams params;
+
+    params.size = input_size;
+    params.scale = input_scale_;
+    params.mean = input_mean_;
+    params.swap_rb = swap_rb_;
+
+    return params;
+}
+
+gboolean ObjectDetector::infer(InferenceRequest& request)
+{
+    if (!is_initialized())
+    {
+        return FALSE;
+    }
 
-            detection.class_id = class_ids[index];
+    Timer timer;
 
-            int class_name_index = detection.class_id - 1;
-            if ((class_name_index >= 0) && (class_name_index < static_cast<int>(class_names_.size())))
+    if (decode_outputs_)
+    {
+        forward(request.blob, request.outputs);
+    }
+    else
+    {
+        request.class_ids.clear();
+        request.confidences.clear();
+        request.boxes.clear();
+
+        const cv::Rect input(cv::Point(0, 0), request.input_size);
+        const cv::Rect& target = request.target;
+
+        for (const auto& region : request.regions)
+        {
+            cv::Mat image = request.image(region);
+            cv::Point origin = region.tl();
+
+            // DetectionModel always stretches its input, so letterboxing is
+            // done by padding the region to the input's aspect ratio first.
+            if ((target != input) && !target.empty())
             {
-                detection.class_name = class_names_[static_cast<std::size_t>(class_name_index)];
+                const double scale = static_cast<double>(region.width) / target.width;
+                const int left = cvRound(target.x * scale);
+                const int top = cvRound(target.y * scale);
+                const int right = std::max(0, cvRound(input.width * scale) - region.width - left);
+                const int bottom = std::max(0, cvRound(input.height * scale) - region.height - top);
+
+                cv::Mat padded;
+                cv::copyMakeBorder(image, padded, top, bottom, left, right,
+                    cv::BORDER_CONSTANT, cv::Scalar::all(input_mean_));
+
+                image = padded;
+                origin -= cv::Point(left, top);
             }
 
-            detection.box = boxes[index];
-            detection.confidence = confidences[index];
+            std::vector<int> class_ids;
+            std::vector<float> confidences;
+            std::vector<cv::Rect> boxes;
 
-            detection_list.detections.push_back(detection);
+            detect(image, request.input_size, class_ids, confidences, boxes);
 
-            if (annotation_enabled_)
+            for (std::size_t index = 0; index < boxes.size(); ++index)
             {
-                annotate_detection(detection, image);
+                request.class_ids.push_back(class_ids[index]);
+                request.confidences.push_back(confidences[index]);
+                request.boxes.push_back(boxes[index] + origin);
             }
         }
+    }
 
-        timer.stop();
-        detection_list.info.elapsed_time_ms = timer.elapsed_ms();
+    request.detection_list.info.elapsed_time_ms += timer.elapsed_ms();
 
-        success = TRUE;
+    return TRUE;
+}
+
+gboolean ObjectDetector::postprocess(InferenceRequest& request) const
+{
+    if (!is_initialized())
+    {
+        return FALSE;
     }
 
-    return success;
+    Timer timer;
+
+    if (decode_outputs_)
+    {
+        decode_detection_output(request);
+    }
+    else if (request.regions.size() > 1)
+    {
+        // Objects on tile boundaries are detected in both tiles.
+        apply_nms(request.class_ids, request.confidences, request.boxes);
+    }
+
+    // An uncertain frame at the crop size gets the next frame refined.
+    if (refine_model_ && (refine_margin_ > 0.0f) && (request.input_size != refine_size_))
+    {
+        bool uncertain = request.uncertain;
+        for (float confidence : request.confidences)
+        {
+            uncertain = uncertain || (confidence < conf_threshold_ + refine_margin_);
+        }
+
+        if (uncertain)
+        {
+            refine_requested_ = true;
+        }
+    }
+
+    DetectionList& detection_list = request.detection_list;
+
+    detection_list.detections.clear();
+    detection_list.detections.reserve(request.class_ids.size());
+
+    for (std::size_t index = 0; index < request.class_ids.size(); ++index)
+    {
+        Detection detection;
+
+        detection.class_id = request.class_ids[index];
+
+        int class_name_index = detection.class_id - 1;
+        if ((class_name_index >= 0) && (class_name_index < static_cast<int>(class_names_.size())))
+        {
+            detection.class_name = class_names_[static_cast<std::size_t>(class_name_index)];
+        }
+
+        detection.box = request.boxes[index];
+        detection.confidence = request.confidences[index];
+
+        if (!in_detection_mask(detection.box))
+        {
+            continue;
+        }
+
+        detection_list.detections.push_back(detection);
+    }
+
+    detection_list.info.elapsed_time_ms += timer.elapsed_ms();
+
+    return TRUE;
+}
+
+void ObjectDetector::decode_detection_output(InferenceRequest& request) const
+{
+    request.class_ids.clear();
+    request.confidences.clear();
+    request.boxes.clear();
+
+    if (request.outputs.empty())
+    {
+        return;
+    }
+
+    // Each detection is [image_id, class_id, confidence, left, top, right, bottom]
+    const cv::Mat& output = request.outputs[0];
+    const float* data = reinterpret_cast<const float*>(output.data);
+
+    const int frame_width = request.frame.size.width;
+    const int frame_height = request.frame.size.height;
+
+    const cv::Rect input(cv::Point(0, 0), request.input_size);
+
+    for (std::size_t i = 0; i + 7 <= output.total(); i += 7)
+    {
+        const int region_index = static_cast<int>(data[i]) - request.batch_index;
+        if ((region_index < 0) || (region_index >= static_cast<int>(request.regions.size())))
+        {
+            continue;
+        }
+
+        const cv::Rect& region = request.regions[static_cast<std::size_t>(region_index)];
+        const cv::Rect& target = request.target.empty() ? input : request.target;
+
+        float confidence = data[i + 2];
+
+        // Candidates just below the threshold make the frame uncertain too.
+        if (std::abs(confidence - conf_threshold_) < refine_margin_)
+        {
+            request.uncertain = true;
+        }
+
+        if (confidence < conf_threshold_)
+        {
+            continue;
+        }
+
+        // Coordinates are normalized to [0, 1] of the network input unless
+        // the network reports them in input pixels.
+        float input_left   = data[i + 3];
+        float input_top    = data[i + 4];
+        float input_right  = data[i + 5];
+        float input_bottom = data[i + 6];
+
+        if ((static_cast<int>(input_right) - static_cast<int>(input_left) + 1 <= 2) ||
+            (static_cast<int>(input_bottom) - static_cast<int>(input_top) + 1 <= 2))
+        {
+            input_left   *= input.width;
+            input_top    *= input.height;
+            input_right  *= input.width;
+            input_bottom *= input.height;
+        }
+
+        // Either way, the box is mapped from the target region back onto
+        // the source region.
+        const float scale_x = static_cast<float>(region.width) / target.width;
+        const float scale_y = static_cast<float>(region.height) / target.height;
+
+        int left   = region.x + static_cast<int>((input_left - target.x) * scale_x);
+        int top    = region.y + static_cast<int>((input_top - target.y) * scale_y);
+        int right  = region.x + static_cast<int>((input_right - target.x) * scale_x);
+        int bottom = region.y + static_cast<int>((input_bottom - target.y) * scale_y);
+        int width  = right - left + 1;
+        int height = bottom - top + 1;
+
+        left   = std::max(0, std::min(left, frame_width - 1));
+        top    = std::max(0, std::min(top, frame_height - 1));
+        width  = std::max(1, std::min(width, frame_width - left));
+        height = std::max(1, std::min(height, frame_height - top));
+
+        request.class_ids.push_back(static_cast<int>(data[i + 1]));
+        request.confidences.push_back(confidence);
+        request.boxes.emplace_back(left, top, width, height);
+    }
+
+    // Also merges objects detected in more than one tile.
+    apply_nms(request.class_ids, request.confidences, request.boxes);
+}
+
+void ObjectDetector::apply_nms(
+    std::vector<int>& class_ids,
+    std::vector<float>& confidences,
+    std::vector<cv::Rect>& boxes) const
+{
+    if (nms_threshold_ <= 0.0)
+    {
+        return;
+    }
+
+    std::map<int, std::vector<std::size_t>> class_to_indices;
+    for (std::size_t index = 0; index < class_ids.size(); ++index)
+    {
+        class_to_indices[class_ids[index]].push_back(index);
+    }
+
+    std::vector<int> kept_class_ids;
+    std::vector<float> kept_confidences;
+    std::vector<cv::Rect> kept_boxes;
+
+    for (const auto& entry : class_to_indices)
+    {
+        std::vector<cv::Rect> class_boxes;
+        std::vector<float> class_confidences;
+
+        for (std::size_t index : entry.second)
+        {
+            class_boxes.push_back(boxes[index]);
+            class_confidences.push_back(confidences[index]);
+        }
+
+        std::vector<int> keep;
+        cv::dnn::NMSBoxes(class_boxes, class_confidences, conf_threshold_, nms_threshold_, keep);
+
+        for (int local_index : keep)
+        {
+            std::size_t index = entry.second[static_cast<std::size_t>(local_index)];
+            kept_class_ids.push_back(class_ids[index]);
+            kept_confidences.push_back(confidences[index]);
+            kept_boxes.push_back(boxes[index]);
+        }
+    }
+
+    class_ids = std::move(kept_class_ids);
+    confidences = std::move(kept_confidences);
+    boxes = std::move(kept_boxes);
+}
+
+void ObjectDetector::annotate(const DetectionList& detection_list, cv::Mat& image) const
+{
+    for (const auto& detection : detection_list.detections)
+    {
+        annotate_detection(detection, image);
+    }
 }
 
-void ObjectDetector::annotate_detection(const Detection& detection, cv::Mat& image)
+void ObjectDetector::annotate_detection(const Detection& detection, cv::Mat& image) const
 {
     static const int thickness = 2;
-    cv::Scalar color(0, 255, 0);
 
-    cv::rectangle(image, detection.box, color, thickness);
+    // Green for BGR. Luma-only and packed YUY2 images are drawn at full
+    // brightness with neutral chroma.
+    cv::Scalar color(0, 255, 0);
+    if (image.channels() == 1)
+    {
+        color = cv::Scalar(255);
+    }
+    else if (image.channels() == 2)
+    {
+        color = cv::Scalar(255, 128);
+    }
 
-    cv::Point class_name_location(detection.box.x + 10, detection.box.y + 30);
-    cv::putText(image, detection.class_name, class_name_location, cv::FONT_HERSHEY_COMPLEX, 1, color);
+    label_renderer_.draw_box(image, detection.box, color, thickness);
 
-    cv::Point confidence_location(detection.box.x + 200, detection.box.y + 30);
-    cv::putText(image, std::to_string(detection.confidence), confidence_location, cv::FONT_HERSHEY_COMPLEX, 1, color);
+    cv::Point label_location(detection.box.x + thickness + 2, detection.box.y + thickness + 2);
+    label_renderer_.draw_label(image, label_location, detection.class_name, detection.confidence, color);
 }
@@ -44,11 +44,65 @@
 #ifndef __OBJECT_DETECTOR_H__
 #define __OBJECT_DETECTOR_H__
 
+#include <atomic>
 #include <gst/gst.h>
 #include <gst/video/video.h>
 #include <opencv2/opencv.hpp>
 #include <opencv2/dnn/dnn.hpp>
 #include "detections_list.h"
+#include "frame_view.h"
+#include "input_blob.h"
+#include "label_renderer.h"
+#include "model_registry.h"
+#include "thread_settings.h"
+
+/**
+ * State of a single frame as it moves through the detection stages
+ * (preprocess, infer, postprocess). Each stage may run on a different thread.
+ */
+struct InferenceRequest {
+
+    // Input frame
+    FrameView frame;
+
+    // Input frame converted to BGR. Only set for networks that are run
+    // through DetectionModel::detect.
+    cv::Mat image;
+
+    // Network input blob
+    cv::Mat blob;
+
+    // Raw network outputs
+    std::vector<cv::Mat> outputs;
+
+    // Index of the request's first image within the batch that produced
+    // the outputs
+    int batch_index = 0;
+
+    // Regions of the frame the network input images were resampled from,
+    // one per image. A single region covering the frame unless the frame
+    // was tiled.
+    std::vector<cv::Rect> regions;
+
+    // Network input size the request is run at. Chosen when the request is
+    // prepared unless it is already set.
+    cv::Size input_size;
+
+    // Region of the network input each image was resampled into
+    cv::Rect target;
+
+    // Decoded detections, before class names are attached
+    std::vector<int> class_ids;
+    std::vector<float> confidences;
+    std::vector<cv::Rect> boxes;
+
+    // TRUE if a candidate detection scored within the refinement margin of
+    // the confidence threshold
+    bool uncertain = false;
+
+    // Final list of detections
+    DetectionList detection_list;
+};
 
 
 class ObjectDetector {
@@ -60,6 +114,7 @@ public:
     static constexpr float kDefaultInputMean = 127.5;
     static constexpr float kDefaultConfidenceThreshold = 0.45;
     static constexpr float kDefaultNmsThreshold = 0.2;
+    static constexpr size_t kMaxCalibrationImages = 200;
 
     ObjectDetector();
     ObjectDetector( const ObjectDetector& ) = delete;
@@ -90,6 +145,141 @@ public:
         float        input_mean = kDefaultInputMean,
         bool         swap_rb = true);
 
+    /**
+     * Share the network with other detectors that use the same files
+     * instead of loading a private copy. Detectors sharing a network run
+     * their forward passes one at a time. Must be called before
+     * initialize().
+     *
+     * @param share_model Share the network (default false)
+     */
+    void set_share_model(bool share_model);
+
+    /**
+     * Select which copy of a shared network the detector uses. Detectors
+     * with the same files and replica share one network and take turns
+     * running it; detectors that must run concurrently use different
+     * replicas. Must be called before initialize().
+     *
+     * @param replica Replica index (default 0)
+     */
+    void set_model_replica(size_t replica);
+
+    /**
+     * Build the network from memory-mapped model files instead of having
+     * OpenCV read them into the heap. Must be called before initialize().
+     *
+     * @param map_files Map the files (default false)
+     */
+    void set_map_files(bool map_files);
+
+    /**
+     * Select the DNN backend and target. Must be called before initialize().
+     *
+     * @param backend cv::dnn::Backend
+     * @param target cv::dnn::Target
+     * @return gboolean TRUE on success, FALSE if OpenCV was built without
+     *                  support for the target on that backend. The previous
+     *                  selection is kept.
+     */
+    gboolean set_backend(int backend, int target);
+
+    /**
+     * Quantize the network to INT8, calibrated on the images in a directory
+     * (at most kMaxCalibrationImages of them). Quantized networks only run
+     * on the OpenCV backend and the CPU target. Must be called before
+     * initialize().
+     *
+     * @param calibration_dir Directory of calibration images, or null to
+     *                        run the network unquantized
+     */
+    void set_calibration_dir(const gchar* calibration_dir);
+
+    /**
+     * Set the CPU affinity and priority of the thread that runs inference.
+     * The detector applies them itself only around warm_up(), so that
+     * OpenCV's worker threads, which are started by the first forward pass,
+     * inherit them. A dedicated inference thread applies them once when it
+     * starts, and a thread that also does other work scopes them to each
+     * call (see ScopedThreadSettings).
+     *
+     * @param settings Thread settings
+     */
+    void set_thread_settings(const ThreadSettings& settings);
+
+    /**
+     * CPU affinity and priority of the thread that runs inference.
+     *
+     * @return const ThreadSettings&
+     */
+    const ThreadSettings& thread_settings() const;
+
+    /**
+     * Select how frames are mapped onto the network input. Boxes are
+     * reported in frame coordinates in every mode, and the mapping is
+     * recorded in the list's MetaInfo.
+     *
+     * @param geometry Input geometry (default InputGeometry::Stretch)
+     * @param roi Region of the frame detected in InputGeometry::Roi mode.
+     *            It is clipped to the frame; if nothing is left, the whole
+     *            frame is used.
+     */
+    void set_input_geometry(InputGeometry geometry, const cv::Rect& roi = cv::Rect());
+
+    /**
+     * Report only the detections whose box center falls inside one of a
+     * set of polygons. Usually combined with InputGeometry::Roi on the
+     * polygons' bounding box, so that only the region of interest is
+     * detected at all.
+     *
+     * @param regions Polygons in frame coordinates. Empty (default) reports
+     *                every detection.
+     */
+    void set_detection_mask(const std::vector<std::vector<cv::Point>>& regions);
+
+    /**
+     * Cut the mapped region of each frame into a grid of overlapping tiles
+     * (see set_input_geometry()) and run every tile
+     * through the network at the crop size, all in one batched forward
+     * pass. Boxes are mapped back to frame coordinates and objects found in
+     * more than one tile are merged by non-maximum suppression over the
+     * whole frame. Not applied when several frames are detected in one
+     * batch. Must be called before initialize().
+     *
+     * @param columns Number of tile columns (default 1)
+     * @param rows Number of tile rows (default 1)
+     * @param overlap Fraction of a tile's width and height shared with the
+     *                neighboring tile, in [0, 0.9]
+     */
+    void set_tiling(int columns, int rows, float overlap);
+
+    /**
+     * Multi-scale mode: run most frames at the crop size and some at a
+     * larger refinement size, either on a fixed schedule or on the frame
+     * after one whose detections were uncertain. Each input size has its
+     * own copy of the network, so the network is reshaped once per size
+     * rather than on every switch. Batched detection always uses the crop
+     * size. Must be called before initialize().
+     *
+     * @param size Refinement input size. An empty size (or the crop size)
+     *             disables multi-scale mode.
+     * @param interval Run every interval-th inference at the refinement
+     *                 size. 0 only refines uncertain frames.
+     * @param margin A frame is uncertain if a candidate detection scored
+     *               within this distance of the confidence threshold.
+     *               0 disables refinement on uncertain frames.
+     */
+    void set_refinement(const cv::Size& size, guint interval, float margin);
+
+    /**
+     * Run one forward pass on a blank image at each input size. OpenCV sets
+     * up and fuses the network graph on the first forward pass, so doing
+     * this ahead of time keeps that cost off the first frame.
+     *
+     * @return gboolean TRUE on success, FALSE on failure
+     */
+    gboolean warm_up();
+
     /**
      * Check whether the detector has been successfully initialized.
      *
@@ -113,6 +303,91 @@ public:
      */
     gboolean get_objects(cv::Mat& image, DetectionList& detection_list);
 
+    /**
+     * Detects objects in a mapped video frame and returns a list of
+     * detections. The frame is not annotated.
+     *
+     * @param frame Input frame (BGR, NV12, I420 or YUY2)
+     * @param detection_list List of Detections
+     * @return gboolean  TRUE on success, FALSE on failure
+     */
+    gboolean get_objects(const FrameView& frame, DetectionList& detection_list);
+
+    /**
+     * Detects objects in several frames with a single batched forward pass
+     * and returns one list of detections per frame. Networks that cannot be
+     * decoded directly are run one frame at a time. Frames are not annotated.
+     *
+     * @param frames Input frames (BGR, NV12, I420 or YUY2)
+     * @param detection_lists One list of Detections per frame, in the same order
+     * @return gboolean  TRUE on success, FALSE on failure
+     */
+    gboolean get_objects(const std::vector<FrameView>& frames, std::vector<DetectionList>& detection_lists);
+
+    /**
+     * Stage 1: prepare the network input blob for the image. The image is
+     * referenced (not copied) by the request and must stay valid until the
+     * request has been postprocessed.
+     *
+     * @param image Input image. Image must be in BGR format.
+     * @param request Request to prepare
+     * @return gboolean TRUE on success, FALSE on failure
+     */
+    gboolean preprocess(const cv::Mat& image, InferenceRequest& request) const;
+
+    /**
+     * Stage 1: prepare the network input blob directly from a mapped video
+     * frame. Color conversion, resizing and normalization are fused into a
+     * single pass over the frame. The frame is referenced (not copied) by the
+     * request and must stay valid until the request has been postprocessed.
+     * If the request already holds a blob of the right shape, it is filled
+     * in place rather than reallocated.
+     *
+     * @param frame Input frame (BGR, NV12, I420 or YUY2)
+     * @param request Request to prepare
+     * @return gboolean TRUE on success, FALSE on failure
+     */
+    gboolean preprocess(const FrameView& frame, InferenceRequest& request) const;
+
+    /**
+     * Stage 2: run the network forward pass on a prepared request. Only one
+     * thread may run inference on a given detector at a time.
+     *
+     * @param request Prepared request
+     * @return gboolean TRUE on success, FALSE on failure
+     */
+    gboolean infer(InferenceRequest& request);
+
+    /**
+     * Stage 3: decode the network outputs into the request's list of
+     * detections. Annotation is not performed.
+     *
+     * @param request Request that has completed inference
+     * @return gboolean TRUE on success, FALSE on failure
+     */
+    gboolean postprocess(InferenceRequest& request) const;
+
+    /**
+     * Prepare a list of detections to be published again for a frame that
+     * was not run through the network: the timestamp is set to now, the
+     * elapsed time to 0, and the list is marked as reused.
+     *
+     * @param detection_list List of Detections
+     */
+    static void reuse_detections(DetectionList& detection_list);
+
+    /**
+     * Annotate the image with every detection in the list. This does not
+     * depend on the annotation state and may be used to draw detections that
+     * were computed from a different frame.
+     *
+     * @param detection_list List of Detections
+     * @param image Image to annotate. BGR images are annotated in color;
+     *              single-plane luma or packed YUY2 images are annotated in
+     *              brightness only.
+     */
+    void annotate(const DetectionList& detection_list, cv::Mat& image) const;
+
 
 private:
 
@@ -132,6 +407,93 @@ private:
      */
     gboolean parse_class_names(const gchar* filename, std::vector<std::string>& class_names) const;
 
+    /**
+     * Attach the frame to the request, map it onto the network input and
+     * fill in the image metadata.
+     *
+     * @param frame Input frame
+     * @param request Request to start
+     * @param tile Split the mapped region into the tile grid
+     */
+    void begin_request(const FrameView& frame, InferenceRequest& request, bool tile) const;
+
+    /**
+     * Input size to run the next request at. Counts the request against
+     * the refinement schedule.
+     *
+     * @return cv::Size Crop size or refinement size
+     */
+    cv::Size next_input_size() const;
+
+    /**
+     * Region of a frame that is mapped onto the network input.
+     *
+     * @param frame_size Frame size
+     * @param input_size Network input size
+     * @return cv::Rect Source region, within the frame
+     */
+    cv::Rect input_source(const cv::Size& frame_size, const cv::Size& input_size) const;
+
+    /**
+     * Region of the network input that a source region is resampled into.
+     * This is the whole input unless the geometry is letterbox.
+     *
+     * @param region_size Source region size
+     * @param input_size Network input size
+     * @return cv::Rect Target region, within the network input
+     */
+    cv::Rect input_target(const cv::Size& region_size, const cv::Size& input_size) const;
+
+    /**
+     * Split a source region into the tile grid. Tiles are sized so that the
+     * grid, with the configured overlap, spans the region exactly.
+     *
+     * @param source Source region
+     * @return std::vector<cv::Rect> Tiles, row by row. The source region
+     *                               itself if tiling is disabled.
+     */
+    std::vector<cv::Rect> tile_regions(const cv::Rect& source) const;
+
+    /**
+     * Check whether a box is centered inside the detection mask.
+     *
+     * @param box Box in frame coordinates
+     * @return bool true if there is no mask or the center is inside (or on
+     *              the edge of) one of its polygons
+     */
+    bool in_detection_mask(const cv::Rect& box) const;
+
+    /**
+     * Network input transform used to fill input blobs.
+     *
+     * @param input_size Network input size
+     * @return InputBlobParams
+     */
+    InputBlobParams input_blob_params(const cv::Size& input_size) const;
+
+    /**
+     * Copy of the network that runs at an input size.
+     *
+     * @param input_size Network input size
+     * @return SharedModel& Refinement network for the refinement size,
+     *                      otherwise the main network
+     */
+    SharedModel& model_for(const cv::Size& input_size) const;
+
+    /**
+     * Acquire a copy of the network for an input size.
+     *
+     * @param key Model key, without the input size
+     * @param input_size Network input size
+     * @param options Load options
+     * @return std::shared_ptr<SharedModel> Shared model. Throws
+     *                                      cv::Exception on failure.
+     */
+    std::shared_ptr<SharedModel> acquire_model(
+        ModelKey key,
+        const cv::Size& input_size,
+        ModelLoadOptions options) const;
+
     /**
      * Annotate the specified detection.
      *
@@ -139,23 +501,150 @@ private:
      * @param image Image
      * @return void
      */
-    void annotate_detection(const Detection& detection, cv::Mat& image);
+    void annotate_detection(const Detection& detection, cv::Mat& image) const;
+
+    /**
+     * Read the calibration images and turn them into network input blobs.
+     *
+     * @param crop Network input size
+     * @param input_scale Input scaling factor
+     * @param input_mean Input mean
+     * @param swap_rb Swap RED/BLUE
+     * @return std::vector<cv::Mat> One blob per readable image
+     */
+    std::vector<cv::Mat> load_calibration_inputs(
+        cv::Size crop,
+        float    input_scale,
+        float    input_mean,
+        bool     swap_rb) const;
+
+    /**
+     * Run the shared network for the blob's input size on an input blob.
+     *
+     * @param blob Input blob
+     * @param outputs Raw network outputs
+     */
+    void forward(const cv::Mat& blob, std::vector<cv::Mat>& outputs);
+
+    /**
+     * Run the shared model's own detection on an image, using this
+     * detector's input parameters and thresholds.
+     *
+     * @param image Input image (BGR)
+     * @param input_size Network input size
+     * @param class_ids Class IDs
+     * @param confidences Confidence scores
+     * @param boxes Bounding boxes
+     */
+    void detect(
+        const cv::Mat& image,
+        const cv::Size& input_size,
+        std::vector<int>& class_ids,
+        std::vector<float>& confidences,
+        std::vector<cv::Rect>& boxes);
+
+    /**
+     * Decode the output of a DetectionOutput (SSD-style) layer into boxes in
+     * image coordinates.
+     *
+     * @param request Request that has completed inference
+     */
+    void decode_detection_output(InferenceRequest& request) const;
+
+    /**
+     * Per-class non-maximum suppression. Detections that are suppressed are
+     * removed from the vectors.
+     *
+     * @param class_ids Class IDs
+     * @param confidences Confidence scores
+     * @param boxes Bounding boxes
+     */
+    void apply_nms(
+        std::vector<int>& class_ids,
+        std::vector<float>& confidences,
+        std::vector<cv::Rect>& boxes) const;
 
 
 private:
 
     gboolean initialized_;
 
-    std::unique_ptr<cv::dnn::DetectionModel> model_;
+    // Network, shared with the other detectors that use the same files if
+    // sharing is enabled
+    std::shared_ptr<SharedModel> model_;
 
     std::vector<std::string> class_names_;
 
+    // Class name labels are rasterized once at initialize()
+    LabelRenderer label_renderer_;
+
     cv::Size crop_size_;
 
     float conf_threshold_;
 
     float nms_threshold_;
 
+    float input_scale_;
+
+    float input_mean_;
+
+    bool swap_rb_;
+
+    // TRUE if the network ends in a DetectionOutput layer that can be
+    // decoded directly. Other networks are run through DetectionModel::detect
+    // in the inference stage.
+    bool decode_outputs_;
+
+    std::vector<cv::String> output_names_;
+
+    // Registry owner of the detector's private networks
+    const size_t model_owner_;
+
+    bool share_model_;
+
+    size_t replica_;
+
+    bool map_files_;
+
+    int backend_;
+    int target_;
+
+    // Empty unless the network is quantized
+    std::string calibration_dir_;
+
+    // Applied to the calling thread around every forward pass
+    ThreadSettings thread_settings_;
+
+    InputGeometry input_geometry_;
+
+    cv::Rect input_roi_;
+
+    // Polygons detections must be centered in, empty to keep every detection
+    std::vector<std::vector<cv::Point>> detection_mask_;
+
+    int tile_columns_;
+    int tile_rows_;
+    float tile_overlap_;
+
+    // Multi-scale mode. The refinement model is null unless it is enabled.
+    cv::Size refine_size_;
+    guint refine_interval_;
+    float refine_margin_;
+    std::shared_ptr<SharedModel> refine_model_;
+
+    // Refinement schedule, shared by the preprocessing and postprocessing
+    // stages
+    mutable std::atomic<guint> inferences_since_refine_;
+    mutable std::atomic<bool> refine_requested_;
+
+    // Input blobs allocated at initialize() and reused for every frame
+    // detected through get_objects(). The single frame blobs hold one image
+    // per tile, at the crop size and the refinement size. Requests prepared
+    // with preprocess() directly own their blob.
+    cv::Mat input_blob_;
+    cv::Mat refine_blob_;
+    cv::Mat batch_blob_;
+
     bool annotation_enabled_;
 };
 
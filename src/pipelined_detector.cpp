@@ -0,0 +1,367 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <algorithm>
+#include "pipelined_detector.h"
+
+PipelinedDetector::FrameJob::~FrameJob()
+{
+    map.reset();
+
+    if (buffer)
+    {
+        gst_buffer_unref(buffer);
+    }
+
+    if (pool)
+    {
+        gst_object_unref(pool);
+    }
+}
+
+PipelinedDetector::PipelinedDetector(
+    ObjectDetector& detector,
+    const std::vector<ObjectDetector*>& workers,
+    detections_list_server* server,
+    bool annotate,
+    bool roi_meta,
+    size_t depth
+)
+    : detector_(detector)
+    , server_(server)
+    , annotate_(annotate)
+    , roi_meta_(roi_meta)
+    , tracker_(nullptr)
+    , depth_(std::max(depth, workers.size() + kDefaultDepth))
+    , next_sequence_(0)
+    , preprocess_queue_(depth_)
+    , postprocessed_queue_(depth_)
+    , completed_queue_(depth_)
+    , in_flight_(0)
+    , stopped_(false)
+{
+    detectors_.push_back(&detector_);
+    detectors_.insert(detectors_.end(), workers.begin(), workers.end());
+
+    for (size_t index = 0; index < detectors_.size(); ++index)
+    {
+        infer_queues_.push_back(std::make_unique<FrameQueue>(depth_));
+        inferred_queues_.push_back(std::make_unique<FrameQueue>(depth_));
+    }
+
+    runners_.emplace_back(&PipelinedDetector::run_preprocess, this);
+
+    for (size_t index = 0; index < detectors_.size(); ++index)
+    {
+        runners_.emplace_back(&PipelinedDetector::run_infer, this, index);
+    }
+
+    runners_.emplace_back(&PipelinedDetector::run_postprocess, this);
+    runners_.emplace_back(&PipelinedDetector::run_serialize, this);
+}
+
+PipelinedDetector::~PipelinedDetector()
+{
+    stop();
+}
+
+void PipelinedDetector::set_finish_callback(FinishCallback callback)
+{
+    finish_callback_ = callback;
+}
+
+void PipelinedDetector::set_tracker(FlowTracker* tracker)
+{
+    tracker_ = tracker;
+}
+
+bool PipelinedDetector::submit(GstBuffer* buffer, const GstVideoInfo& info, GstBufferPool* pool,
+    FrameAction action)
+{
+    FrameJobPtr job = std::make_unique<FrameJob>();
+
+    job->sequence = next_sequence_++;
+    job->buffer = buffer;
+    job->info = info;
+    job->pool = pool ? static_cast<GstBufferPool*>(gst_object_ref(pool)) : nullptr;
+    job->action = action;
+
+    in_flight_++;
+
+    if (!preprocess_queue_.push(std::move(job)))
+    {
+        in_flight_--;
+        return false;
+    }
+
+    return true;
+}
+
+GstBuffer* PipelinedDetector::pop(bool wait)
+{
+    FrameJobPtr job;
+
+    bool popped = (wait && (in_flight_ > 0)) ?
+        completed_queue_.pop(job) : completed_queue_.try_pop(job);
+
+    if (!popped)
+    {
+        return nullptr;
+    }
+
+    in_flight_--;
+
+    GstBuffer* buffer = job->buffer;
+    job->buffer = nullptr;
+
+    return buffer;
+}
+
+size_t PipelinedDetector::in_flight() const
+{
+    return in_flight_;
+}
+
+size_t PipelinedDetector::depth() const
+{
+    return depth_;
+}
+
+size_t PipelinedDetector::num_workers() const
+{
+    return detectors_.size();
+}
+
+void PipelinedDetector::stop()
+{
+    if (stopped_.exchange(true))
+    {
+        return;
+    }
+
+    close_queues();
+
+    for (auto& runner : runners_)
+    {
+        runner.join();
+    }
+
+    // Releasing the jobs releases their buffers.
+    preprocess_queue_.drain();
+    for (size_t index = 0; index < detectors_.size(); ++index)
+    {
+        infer_queues_[index]->drain();
+        inferred_queues_[index]->drain();
+    }
+    postprocessed_queue_.drain();
+    completed_queue_.drain();
+
+    in_flight_ = 0;
+}
+
+void PipelinedDetector::close_queues()
+{
+    preprocess_queue_.close();
+    for (size_t index = 0; index < detectors_.size(); ++index)
+    {
+        infer_queues_[index]->close();
+        inferred_queues_[index]->close();
+    }
+    postprocessed_queue_.close();
+    completed_queue_.close();
+}
+
+void PipelinedDetector::run_preprocess()
+{
+    FrameJobPtr job;
+    while (preprocess_queue_.pop(job))
+    {
+        // Frames that are not detected fail every stage until
+        // postprocessing, so they come out untouched.
+        if (job->action == FrameAction::Detect)
+        {
+            job->map = std::make_unique<ScopedBufferMap>(job->buffer, job->info);
+
+            job->success = detector_.preprocess(job->map->view(), job->request);
+        }
+
+        size_t index = static_cast<size_t>(job->sequence % detectors_.size());
+        if (!infer_queues_[index]->push(std::move(job)))
+        {
+            break;
+        }
+    }
+}
+
+void PipelinedDetector::run_infer(size_t index)
+{
+    ObjectDetector& detector = *detectors_[index];
+
+    // This thread only runs inference, so it keeps the settings.
+    apply_thread_settings(detector.thread_settings());
+
+    FrameJobPtr job;
+    while (infer_queues_[index]->pop(job))
+    {
+        if (job->success)
+        {
+            job->success = detector.infer(job->request);
+        }
+
+        if (!inferred_queues_[index]->push(std::move(job)))
+        {
+            break;
+        }
+    }
+}
+
+void PipelinedDetector::run_postprocess()
+{
+    // Frames were dispatched round-robin, so collecting them round-robin
+    // restores sequence order.
+    for (guint64 sequence = 0; ; ++sequence)
+    {
+        size_t index = static_cast<size_t>(sequence % detectors_.size());
+
+        FrameJobPtr job;
+        if (!inferred_queues_[index]->pop(job))
+        {
+            break;
+        }
+
+        if (job->success)
+        {
+            job->success = detector_.postprocess(job->request);
+
+            if (job->success)
+            {
+                last_detection_list_ = job->request.detection_list;
+
+                if (tracker_)
+                {
+                    tracker_->start(job->request.frame, last_detection_list_);
+                }
+            }
+        }
+        else if ((job->action == FrameAction::Track) && track(*job))
+        {
+            // Frames after this one start from the tracked detections.
+            last_detection_list_ = job->request.detection_list;
+            job->success = TRUE;
+        }
+        else if ((job->action == FrameAction::Reuse) || (job->action == FrameAction::Track))
+        {
+            // Frames are postprocessed in order, so this is the last frame
+            // before this one that was detected.
+            job->request.detection_list = last_detection_list_;
+            ObjectDetector::reuse_detections(job->request.detection_list);
+            job->success = TRUE;
+        }
+
+        if (job->success && finish_callback_)
+        {
+            finish_callback_(job->request.detection_list);
+        }
+
+        // The read-only mapping is not needed past this point.
+        job->request.image.release();
+        job->request.frame.planes.clear();
+        job->map.reset();
+
+        if (job->success && annotate_ && (job->request.detection_list.detections.size() > 0))
+        {
+            // Draw into the outgoing buffer. This only copies (into a
+            // buffer from the output pool) if someone else also holds a
+            // reference to it.
+            job->buffer = make_frame_writable(job->buffer, job->info, job->pool);
+
+            ScopedBufferMap scoped_buffer(job->buffer, job->info, GST_MAP_READWRITE);
+            if (!scoped_buffer.frame().empty())
+            {
+                detector_.annotate(job->request.detection_list, scoped_buffer.frame());
+            }
+        }
+
+        if (job->success && roi_meta_ && (job->request.detection_list.detections.size() > 0))
+        {
+            // Only the buffer metadata has to be writable, so this does not
+            // copy the frame.
+            job->buffer = gst_buffer_make_writable(job->buffer);
+            attach_roi_meta(job->buffer, job->request.detection_list);
+        }
+
+        if (!postprocessed_queue_.push(std::move(job)))
+        {
+            break;
+        }
+    }
+}
+
+bool PipelinedDetector::track(FrameJob& job)
+{
+    if (tracker_ == nullptr)
+    {
+        return false;
+    }
+
+    ScopedBufferMap scoped_buffer(job.buffer, job.info);
+
+    return tracker_->track(scoped_buffer.view(), job.request.detection_list);
+}
+
+void PipelinedDetector::run_serialize()
+{
+    FrameJobPtr job;
+    while (postprocessed_queue_.pop(job))
+    {
+        if (job->success && server_)
+        {
+            server_->publish(detections_list_server::build_message(job->request.detection_list));
+        }
+
+        if (!completed_queue_.push(std::move(job)))
+        {
+            break;
+        }
+    }
+}
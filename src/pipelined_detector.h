@@ -0,0 +1,307 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __PIPELINED_DETECTOR_H__
+#define __PIPELINED_DETECTOR_H__
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include "bounded_queue.h"
+#include "flow_tracker.h"
+#include "gstopencv-utils.h"
+#include "object_detector.h"
+#include "detections_list_server.h"
+
+/**
+ * Runs detection as a pipeline of stages (preprocess, infer, postprocess and
+ * serialize), each on its own thread and connected by bounded queues. While
+ * frame N is being inferred, frame N+1 is being preprocessed and frame N-1 is
+ * being postprocessed and published.
+ *
+ * The infer stage may be backed by several independent detectors, each with
+ * its own thread. Frames are dispatched to them round-robin and collected
+ * again in sequence order, so completed frames always come out in the order
+ * they were submitted.
+ */
+class PipelinedDetector {
+public:
+
+    // Default number of frames that may be in the stages at once
+    static constexpr size_t kDefaultDepth = 4;
+
+    // What the stages do with a submitted frame
+    enum class FrameAction {
+
+        // Run the frame through the network
+        Detect,
+
+        // Pass the frame through without inference. Nothing is published
+        // for it.
+        Skip,
+
+        // Pass the frame through without inference, and annotate and
+        // publish it with the detections of the last detected frame
+        Reuse,
+
+        // Like Reuse, but the detections are first moved onto the frame by
+        // the tracker (see set_tracker())
+        Track
+    };
+
+    /**
+     * Constructor. Starts one thread per stage, plus one inference thread
+     * per additional detector.
+     *
+     * @param detector Initialized detector
+     * @param workers Additional initialized detectors to run inference on.
+     *                They must outlive the pipeline.
+     * @param server Server that detections are published to (may be null)
+     * @param annotate Annotate frames that contain detections
+     * @param roi_meta Attach detections to frames as GstVideoRegionOfInterestMeta
+     * @param depth Maximum number of frames in flight. This is raised if
+     *              needed to keep every detector busy.
+     */
+    PipelinedDetector(
+        ObjectDetector& detector,
+        const std::vector<ObjectDetector*>& workers,
+        detections_list_server* server,
+        bool annotate,
+        bool roi_meta = false,
+        size_t depth = kDefaultDepth);
+
+    PipelinedDetector(const PipelinedDetector&) = delete;
+    PipelinedDetector& operator= (const PipelinedDetector&) = delete;
+
+    /**
+     * Destructor. Stops all stages and releases frames still in flight.
+     */
+    ~PipelinedDetector();
+
+    typedef std::function<void(DetectionList&)> FinishCallback;
+
+    /**
+     * Set a callback that is invoked from the postprocess thread for every
+     * list of detections (detected or reused) before it is published. Must
+     * be called before the first frame is submitted.
+     *
+     * @param callback Callback
+     */
+    void set_finish_callback(FinishCallback callback);
+
+    /**
+     * Set the tracker that carries detections onto frames submitted with
+     * FrameAction::Track. It is started from every detected frame, from the
+     * postprocess thread. Without a tracker, those frames are reused. Must
+     * be called before the first frame is submitted.
+     *
+     * @param tracker Tracker (not owned, may be null)
+     */
+    void set_tracker(FlowTracker* tracker);
+
+    /**
+     * Submit a frame to the first stage. Ownership of the buffer is
+     * transferred to the pipeline.
+     *
+     * @param buffer Input buffer
+     * @param info Video info describing the image represented in buffer
+     * @param pool Pool to copy the frame into if it must be copied before
+     *             it can be annotated (may be nullptr)
+     * @param action Whether to run inference on the frame. Frames that are
+     *               not detected keep their place in the output order.
+     * @return bool false if the pipeline has been stopped
+     */
+    bool submit(GstBuffer* buffer, const GstVideoInfo& info, GstBufferPool* pool = nullptr,
+        FrameAction action = FrameAction::Detect);
+
+    /**
+     * Remove the oldest completed frame. Frames are returned in the order
+     * they were submitted. Ownership of the buffer is transferred to the
+     * caller.
+     *
+     * @param wait Wait for the oldest frame to complete if it is still in flight
+     * @return GstBuffer* Completed buffer, or nullptr if none is available
+     */
+    GstBuffer* pop(bool wait);
+
+    /**
+     * Number of frames that have been submitted but not yet popped.
+     *
+     * @return size_t
+     */
+    size_t in_flight() const;
+
+    /**
+     * Maximum number of frames in flight.
+     *
+     * @return size_t
+     */
+    size_t depth() const;
+
+    /**
+     * Number of detectors used by the infer stage.
+     *
+     * @return size_t
+     */
+    size_t num_workers() const;
+
+    /**
+     * Stop all stages. Frames still in flight are released.
+     */
+    void stop();
+
+
+private:
+
+    struct FrameJob {
+
+        guint64 sequence = 0;
+
+        GstBuffer* buffer = nullptr;
+        GstVideoInfo info;
+
+        // Output pool used if the frame is copied for annotation
+        GstBufferPool* pool = nullptr;
+
+        FrameAction action = FrameAction::Detect;
+
+        // Keeps the frame mapped (read-only) from preprocessing until
+        // postprocessing
+        std::unique_ptr<ScopedBufferMap> map;
+
+        InferenceRequest request;
+
+        gboolean success = FALSE;
+
+        ~FrameJob();
+    };
+
+    typedef std::unique_ptr<FrameJob> FrameJobPtr;
+
+    typedef BoundedQueue<FrameJobPtr> FrameQueue;
+
+    /**
+     * Preprocess thread entry point. Dispatches frames to the inference
+     * queues round-robin.
+     */
+    void run_preprocess();
+
+    /**
+     * Inference thread entry point.
+     *
+     * @param index Detector index
+     */
+    void run_infer(size_t index);
+
+    /**
+     * Postprocess thread entry point. Collects frames from the inference
+     * queues in sequence order.
+     */
+    void run_postprocess();
+
+    /**
+     * Serialize thread entry point.
+     */
+    void run_serialize();
+
+    /**
+     * Move the tracked detections onto a frame submitted with
+     * FrameAction::Track.
+     *
+     * @param job Frame job
+     * @return bool false if the frame could not be tracked
+     */
+    bool track(FrameJob& job);
+
+    /**
+     * Close every queue to wake and stop all threads.
+     */
+    void close_queues();
+
+
+private:
+
+    ObjectDetector& detector_;
+
+    // Detectors used by the infer stage. The first is detector_.
+    std::vector<ObjectDetector*> detectors_;
+
+    detections_list_server* server_;
+
+    bool annotate_;
+    bool roi_meta_;
+
+    FinishCallback finish_callback_;
+
+    FlowTracker* tracker_;
+
+    size_t depth_;
+
+    guint64 next_sequence_;
+
+    FrameQueue preprocess_queue_;
+
+    // One input and one output queue per detector
+    std::vector<std::unique_ptr<FrameQueue>> infer_queues_;
+    std::vector<std::unique_ptr<FrameQueue>> inferred_queues_;
+
+    FrameQueue postprocessed_queue_;
+
+    FrameQueue completed_queue_;
+
+    // Detections of the last detected frame. Only used by the postprocess
+    // thread.
+    DetectionList last_detection_list_;
+
+    std::vector<std::thread> runners_;
+
+    std::atomic<size_t> in_flight_;
+
+    std::atomic<bool> stopped_;
+};
+
+#endif // __PIPELINED_DETECTOR_H__
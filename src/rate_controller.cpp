@@ -0,0 +1,170 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "rate_controller.h"
+
+RateController::RateController()
+    : target_latency_ms_(0)
+    , max_cpu_percent_(0)
+    , interval_(1)
+    , frames_since_detection_(0)
+    , inference_ms_(0.0)
+    , cpu_percent_(0.0)
+    , window_cpu_start_(0)
+{
+}
+
+void RateController::configure(guint target_latency_ms, guint max_cpu_percent)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    target_latency_ms_ = target_latency_ms;
+    max_cpu_percent_ = max_cpu_percent;
+
+    if (!enabled())
+    {
+        interval_ = 1;
+    }
+}
+
+bool RateController::enabled() const
+{
+    return (target_latency_ms_ > 0) || (max_cpu_percent_ > 0);
+}
+
+bool RateController::should_detect()
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    if (!enabled())
+    {
+        return true;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const std::clock_t cpu_now = std::clock();
+
+    if (window_start_ == std::chrono::steady_clock::time_point())
+    {
+        window_start_ = now;
+        window_cpu_start_ = cpu_now;
+    }
+
+    const double window_ms =
+        std::chrono::duration<double, std::milli>(now - window_start_).count();
+
+    if (window_ms >= kWindowMs)
+    {
+        // std::clock() is the CPU time used by every thread of the process.
+        const double cpu_ms = 1000.0 * (cpu_now - window_cpu_start_) / CLOCKS_PER_SEC;
+        cpu_percent_ = 100.0 * cpu_ms / window_ms;
+
+        update_interval();
+
+        window_start_ = now;
+        window_cpu_start_ = cpu_now;
+    }
+
+    if (++frames_since_detection_ >= interval_)
+    {
+        frames_since_detection_ = 0;
+        return true;
+    }
+
+    return false;
+}
+
+void RateController::report(double inference_ms)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    inference_ms_ = (inference_ms_ > 0.0) ?
+        (kSmoothing * inference_ms + (1.0 - kSmoothing) * inference_ms_) : inference_ms;
+}
+
+void RateController::stamp(DetectionList& detection_list) const
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    detection_list.info.inference_interval = interval_;
+    detection_list.info.cpu_percent = static_cast<float>(cpu_percent_);
+}
+
+void RateController::reset()
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    interval_ = 1;
+    frames_since_detection_ = 0;
+    inference_ms_ = 0.0;
+    cpu_percent_ = 0.0;
+    window_start_ = std::chrono::steady_clock::time_point();
+}
+
+void RateController::update_interval()
+{
+    // Left unclamped, so that the interval can fall back to 1.
+    double required = 0.0;
+
+    if ((target_latency_ms_ > 0) && (inference_ms_ > 0.0))
+    {
+        required = std::max(required, inference_ms_ / target_latency_ms_);
+    }
+
+    // Usage is assumed to scale with the inference rate.
+    if ((max_cpu_percent_ > 0) && (cpu_percent_ > 0.0))
+    {
+        required = std::max(required, interval_ * cpu_percent_ / max_cpu_percent_);
+    }
+
+    if (required > interval_)
+    {
+        interval_ = std::min(kMaxInterval, static_cast<guint>(std::ceil(required)));
+    }
+    else if ((interval_ > 1) && (required <= 0.8 * (interval_ - 1)))
+    {
+        interval_--;
+    }
+}
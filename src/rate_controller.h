@@ -0,0 +1,162 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __RATE_CONTROLLER_H__
+#define __RATE_CONTROLLER_H__
+
+#include <chrono>
+#include <ctime>
+#include <mutex>
+#include <glib.h>
+#include "detections_list.h"
+
+/**
+ * Adapts how often inference runs so that the detector stays within a
+ * latency or CPU budget. The operating point is an inference interval:
+ * inference runs on one frame in every interval, and the frames in between
+ * reuse the last detections.
+ *
+ * With a latency target, the interval is chosen so that the average
+ * inference time per frame stays below the target. With a CPU limit, the
+ * process's CPU usage is measured over short windows and the interval is
+ * scaled by how far usage is from the limit. The interval rises as soon as
+ * a budget is exceeded and falls one step at a time once there is headroom,
+ * so it does not oscillate.
+ */
+class RateController {
+public:
+
+    // Longest inference interval the controller will choose
+    static constexpr guint kMaxInterval = 30;
+
+    // Length of the window over which CPU usage is measured
+    static constexpr int kWindowMs = 500;
+
+    // Weight of the newest sample in the inference time average
+    static constexpr double kSmoothing = 0.2;
+
+    RateController();
+    RateController( const RateController& ) = delete;
+    RateController& operator= ( const RateController& ) = delete;
+
+    /**
+     * Configure the budgets. The controller is disabled if both are 0.
+     *
+     * @param target_latency_ms Average inference time per frame (0 = none)
+     * @param max_cpu_percent CPU usage of the process, in percent of one
+     *                        core (0 = none)
+     */
+    void configure(guint target_latency_ms, guint max_cpu_percent);
+
+    /**
+     * Check whether the controller is enabled.
+     *
+     * @return bool
+     */
+    bool enabled() const;
+
+    /**
+     * Called for every incoming frame. Updates the operating point at the
+     * end of each measurement window.
+     *
+     * @return bool true if inference should run on the frame
+     */
+    bool should_detect();
+
+    /**
+     * Report the inference time of a detected frame. May be called from any
+     * thread.
+     *
+     * @param inference_ms Preprocessing, inference and decoding time
+     */
+    void report(double inference_ms);
+
+    /**
+     * Record the current operating point in a list's metadata. May be
+     * called from any thread.
+     *
+     * @param detection_list List of Detections
+     */
+    void stamp(DetectionList& detection_list) const;
+
+    /**
+     * Return to detecting every frame and restart the measurements.
+     */
+    void reset();
+
+
+private:
+
+    /**
+     * Choose the interval for the measurements of the last window. Called
+     * with the lock held.
+     */
+    void update_interval();
+
+
+private:
+
+    mutable std::mutex lock_;
+
+    guint target_latency_ms_;
+
+    guint max_cpu_percent_;
+
+    // Operating point
+    guint interval_;
+
+    // Frames since the last one that was detected
+    guint frames_since_detection_;
+
+    // Moving average of the inference time
+    double inference_ms_;
+
+    // CPU usage measured over the last window
+    double cpu_percent_;
+
+    std::chrono::steady_clock::time_point window_start_;
+
+    std::clock_t window_cpu_start_;
+};
+
+#endif // __RATE_CONTROLLER_H__
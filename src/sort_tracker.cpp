@@ -0,0 +1,313 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <algorithm>
+#include "sort_tracker.h"
+
+namespace {
+
+// State is [cx, cy, w, h, vx, vy, vw, vh], measurement is [cx, cy, w, h].
+constexpr int kStateSize = 8;
+constexpr int kMeasurementSize = 4;
+
+float iou(const cv::Rect& a, const cv::Rect& b)
+{
+    const float intersection = static_cast<float>((a & b).area());
+    const float area_union = static_cast<float>(a.area() + b.area()) - intersection;
+    return (area_union > 0) ? (intersection / area_union) : 0.0f;
+}
+
+cv::Mat measure(const cv::Rect& box)
+{
+    return (cv::Mat_<float>(kMeasurementSize, 1) <<
+        box.x + box.width / 2.0f, box.y + box.height / 2.0f,
+        static_cast<float>(box.width), static_cast<float>(box.height));
+}
+
+cv::Rect state_box(const cv::Mat& state)
+{
+    const float width = std::max(1.0f, state.at<float>(2));
+    const float height = std::max(1.0f, state.at<float>(3));
+
+    return cv::Rect(
+        cvRound(state.at<float>(0) - width / 2), cvRound(state.at<float>(1) - height / 2),
+        cvRound(width), cvRound(height));
+}
+
+}
+
+SortTracker::SortTracker()
+    : enabled_(false)
+    , iou_threshold_(kDefaultIouThreshold)
+    , max_age_ms_(kDefaultMaxAgeMs)
+    , next_id_(1)
+    , last_timestamp_(0)
+{
+}
+
+void SortTracker::configure(bool enabled, float iou_threshold, guint max_age_ms)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    enabled_ = enabled;
+    iou_threshold_ = iou_threshold;
+    max_age_ms_ = max_age_ms;
+
+    tracks_.clear();
+    last_timestamp_ = 0;
+}
+
+bool SortTracker::enabled() const
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    return enabled_;
+}
+
+void SortTracker::update(DetectionList& detection_list)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    if (!enabled_)
+    {
+        return;
+    }
+
+    std::vector<Detection>& detections = detection_list.detections;
+    const uint64_t timestamp = detection_list.info.timestamp;
+
+    const bool copied = detection_list.info.reused &&
+        std::none_of(detections.begin(), detections.end(),
+            [](const Detection& detection) { return detection.tracked; });
+
+    // A copied list carries no new measurements. Its detections take the
+    // ID of the track whose last box they overlap most.
+    if (copied)
+    {
+        for (auto& detection : detections)
+        {
+            const Track* best = nullptr;
+            float best_iou = iou_threshold_;
+
+            for (const auto& track : tracks_)
+            {
+                float overlap = iou(track.box, detection.box);
+                if ((track.class_id == detection.class_id) && (overlap >= best_iou))
+                {
+                    best = &track;
+                    best_iou = overlap;
+                }
+            }
+
+            if (best)
+            {
+                label(*best, timestamp, detection);
+            }
+        }
+
+        return;
+    }
+
+    // Lists that arrive out of order (possible in latest mode) are treated
+    // as if they were only just after the previous one.
+    const float dt = (last_timestamp_ > 0) && (timestamp > last_timestamp_) ?
+        static_cast<float>(timestamp - last_timestamp_) / 1000.0f : 0.001f;
+    last_timestamp_ = std::max(last_timestamp_, timestamp);
+
+    for (auto& track : tracks_)
+    {
+        predict(track, dt);
+    }
+
+    struct Candidate {
+        float iou;
+        size_t track;
+        size_t detection;
+    };
+
+    std::vector<Candidate> candidates;
+
+    for (size_t track = 0; track < tracks_.size(); ++track)
+    {
+        for (size_t detection = 0; detection < detections.size(); ++detection)
+        {
+            if (tracks_[track].class_id != detections[detection].class_id)
+            {
+                continue;
+            }
+
+            float overlap = iou(tracks_[track].predicted, detections[detection].box);
+            if (overlap >= iou_threshold_)
+            {
+                candidates.push_back({ overlap, track, detection });
+            }
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(),
+        [](const Candidate& a, const Candidate& b) { return a.iou > b.iou; });
+
+    std::vector<bool> track_matched(tracks_.size(), false);
+    std::vector<bool> detection_matched(detections.size(), false);
+
+    for (const auto& candidate : candidates)
+    {
+        if (track_matched[candidate.track] || detection_matched[candidate.detection])
+        {
+            continue;
+        }
+
+        track_matched[candidate.track] = true;
+        detection_matched[candidate.detection] = true;
+
+        Track& track = tracks_[candidate.track];
+        Detection& detection = detections[candidate.detection];
+
+        track.filter.correct(measure(detection.box));
+        track.box = detection.box;
+        track.last_seen = timestamp;
+        track.hits++;
+
+        label(track, timestamp, detection);
+    }
+
+    // Tracks that have not been matched for too long are dropped before new
+    // ones are added.
+    size_t kept = 0;
+    for (size_t index = 0; index < tracks_.size(); ++index)
+    {
+        if (track_matched[index] || (timestamp <= tracks_[index].last_seen + max_age_ms_))
+        {
+            if (kept != index)
+            {
+                tracks_[kept] = std::move(tracks_[index]);
+            }
+            kept++;
+        }
+    }
+    tracks_.resize(kept);
+
+    for (size_t index = 0; index < detections.size(); ++index)
+    {
+        if (!detection_matched[index])
+        {
+            tracks_.push_back(create_track(detections[index], timestamp));
+            label(tracks_.back(), timestamp, detections[index]);
+        }
+    }
+}
+
+void SortTracker::reset()
+{
+    std::lock_guard<std::mutex> guard(lock_);
+
+    tracks_.clear();
+    last_timestamp_ = 0;
+}
+
+SortTracker::Track SortTracker::create_track(const Detection& detection, uint64_t timestamp)
+{
+    Track track;
+
+    track.id = next_id_++;
+    track.class_id = detection.class_id;
+    track.box = detection.box;
+    track.predicted = detection.box;
+    track.first_seen = timestamp;
+    track.last_seen = timestamp;
+    track.hits = 1;
+
+    cv::KalmanFilter& filter = track.filter;
+    filter.init(kStateSize, kMeasurementSize, 0, CV_32F);
+
+    cv::setIdentity(filter.measurementMatrix);
+    cv::setIdentity(filter.measurementNoiseCov,
+        cv::Scalar::all(kMeasurementNoise * kMeasurementNoise));
+
+    // The new track's size and position are as measured, and its velocity
+    // is unknown.
+    measure(detection.box).copyTo(filter.statePost.rowRange(0, kMeasurementSize));
+
+    cv::setIdentity(filter.errorCovPost, cv::Scalar::all(kMeasurementNoise * kMeasurementNoise));
+    for (int index = kMeasurementSize; index < kStateSize; ++index)
+    {
+        filter.errorCovPost.at<float>(index, index) = kInitialVelocityNoise * kInitialVelocityNoise;
+    }
+
+    return track;
+}
+
+void SortTracker::predict(Track& track, float dt) const
+{
+    cv::KalmanFilter& filter = track.filter;
+
+    // Constant velocity, with process noise from a random acceleration
+    // over the time step.
+    const float q = kAccelerationNoise * kAccelerationNoise;
+
+    cv::setIdentity(filter.transitionMatrix);
+    filter.processNoiseCov.setTo(cv::Scalar::all(0));
+
+    for (int index = 0; index < kMeasurementSize; ++index)
+    {
+        const int velocity = index + kMeasurementSize;
+
+        filter.transitionMatrix.at<float>(index, velocity) = dt;
+
+        filter.processNoiseCov.at<float>(index, index) = q * dt * dt * dt * dt / 4;
+        filter.processNoiseCov.at<float>(index, velocity) = q * dt * dt * dt / 2;
+        filter.processNoiseCov.at<float>(velocity, index) = q * dt * dt * dt / 2;
+        filter.processNoiseCov.at<float>(velocity, velocity) = q * dt * dt;
+    }
+
+    track.predicted = state_box(filter.predict());
+}
+
+void SortTracker::label(const Track& track, uint64_t timestamp, Detection& detection) const
+{
+    detection.track_id = (track.hits >= kMinHits) ? track.id : 0;
+    detection.age = static_cast<uint32_t>(timestamp - std::min(timestamp, track.first_seen));
+    detection.velocity = cv::Point2f(
+        track.filter.statePost.at<float>(kMeasurementSize),
+        track.filter.statePost.at<float>(kMeasurementSize + 1));
+}
@@ -0,0 +1,189 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __SORT_TRACKER_H__
+#define __SORT_TRACKER_H__
+
+#include <mutex>
+#include <vector>
+#include <glib.h>
+#include <opencv2/core.hpp>
+#include <opencv2/video/tracking.hpp>
+#include "detections_list.h"
+
+/**
+ * Assigns stable track IDs to detections across lists (SORT). Every track
+ * has a constant-velocity Kalman filter over its box center and size. For
+ * each list, the tracks are predicted to the list's timestamp and matched
+ * to detections of the same class, greedily and best IoU first. Matched
+ * tracks are corrected with their detection. Unmatched detections start new
+ * tracks, and tracks that go unmatched for longer than the maximum age are
+ * dropped.
+ *
+ * Lists that are plain copies of an earlier list (reused, with no tracked
+ * detections) do not update the filters. Their detections are only labeled
+ * with the track they overlap most. All methods may be called from any
+ * thread.
+ */
+class SortTracker {
+public:
+
+    static constexpr float kDefaultIouThreshold = 0.3;
+    static constexpr guint kDefaultMaxAgeMs = 1000;
+
+    // Number of matches before a track's ID is reported
+    static constexpr guint kMinHits = 3;
+
+    // Standard deviation of the measured box position and size, in pixels
+    static constexpr float kMeasurementNoise = 5.0;
+
+    // Standard deviation of the unmodeled acceleration, in pixels/s^2
+    static constexpr float kAccelerationNoise = 300.0;
+
+    // Standard deviation of the velocity of a new track, in pixels/s
+    static constexpr float kInitialVelocityNoise = 500.0;
+
+    SortTracker();
+    SortTracker( const SortTracker& ) = delete;
+    SortTracker& operator= ( const SortTracker& ) = delete;
+
+    /**
+     * Configure the tracker. Existing tracks are dropped.
+     *
+     * @param enabled Assign track IDs
+     * @param iou_threshold Minimum IoU between a predicted track and a
+     *                      detection for them to match
+     * @param max_age_ms Time a track is kept without a match
+     */
+    void configure(bool enabled, float iou_threshold, guint max_age_ms);
+
+    /**
+     * Check whether the tracker is enabled.
+     *
+     * @return bool
+     */
+    bool enabled() const;
+
+    /**
+     * Update the tracks with a list of detections and fill in the track ID,
+     * age and velocity of each detection. Lists must be passed in the
+     * order of their frames.
+     *
+     * @param detection_list List of Detections
+     */
+    void update(DetectionList& detection_list);
+
+    /**
+     * Drop every track. IDs keep increasing.
+     */
+    void reset();
+
+
+private:
+
+    struct Track {
+
+        guint32 id = 0;
+
+        int class_id = 0;
+
+        cv::KalmanFilter filter;
+
+        // Box of the last matched detection, and the box predicted for the
+        // current list
+        cv::Rect box;
+        cv::Rect predicted;
+
+        // Timestamps (ms) of the first and last match
+        uint64_t first_seen = 0;
+        uint64_t last_seen = 0;
+
+        guint hits = 0;
+    };
+
+    /**
+     * Start a track from a detection.
+     *
+     * @param detection Detection
+     * @param timestamp Timestamp of its list
+     * @return Track
+     */
+    Track create_track(const Detection& detection, uint64_t timestamp);
+
+    /**
+     * Predict a track forward in time.
+     *
+     * @param track Track
+     * @param dt Time step in seconds
+     */
+    void predict(Track& track, float dt) const;
+
+    /**
+     * Copy a track's ID, age and velocity into a detection.
+     *
+     * @param track Track
+     * @param timestamp Timestamp of the detection's list
+     * @param detection Detection
+     */
+    void label(const Track& track, uint64_t timestamp, Detection& detection) const;
+
+
+private:
+
+    mutable std::mutex lock_;
+
+    bool enabled_;
+
+    float iou_threshold_;
+
+    guint max_age_ms_;
+
+    std::vector<Track> tracks_;
+
+    guint32 next_id_;
+
+    // Timestamp of the last list that updated the tracks
+    uint64_t last_timestamp_;
+};
+
+#endif // __SORT_TRACKER_H__
@@ -0,0 +1,214 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <mutex>
+#include "detector_debug.h"
+#include "thread_settings.h"
+
+#ifdef __linux__
+#include <sched.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+#define GST_CAT_DEFAULT detector_core_debug
+
+namespace {
+
+#ifdef __linux__
+
+pid_t current_thread_id()
+{
+    return static_cast<pid_t>(syscall(SYS_gettid));
+}
+
+guint64 current_cpu_mask()
+{
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) != 0)
+    {
+        return 0;
+    }
+
+    guint64 mask = 0;
+    for (int cpu = 0; cpu < 64; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &cpu_set))
+        {
+            mask |= (G_GUINT64_CONSTANT(1) << cpu);
+        }
+    }
+
+    return mask;
+}
+
+bool set_cpu_mask(guint64 mask)
+{
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+
+    for (int cpu = 0; cpu < 64; ++cpu)
+    {
+        if (mask & (G_GUINT64_CONSTANT(1) << cpu))
+        {
+            CPU_SET(cpu, &cpu_set);
+        }
+    }
+
+    // A pid of 0 applies to the calling thread only.
+    return sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0;
+}
+
+gint current_priority()
+{
+    errno = 0;
+    int priority = getpriority(PRIO_PROCESS, static_cast<id_t>(current_thread_id()));
+    return (errno == 0) ? priority : 0;
+}
+
+bool set_priority(gint priority)
+{
+    // On Linux, the nice value is per thread. Raising the priority (a
+    // negative value) requires CAP_SYS_NICE.
+    return setpriority(PRIO_PROCESS, static_cast<id_t>(current_thread_id()), priority) == 0;
+}
+
+#endif
+
+}
+
+bool ThreadSettings::empty() const
+{
+    return (cpu_mask == 0) && (priority == 0);
+}
+
+gboolean apply_thread_settings(const ThreadSettings& settings)
+{
+    gboolean success = TRUE;
+
+    detector_debug_init();
+
+#ifdef __linux__
+    if ((settings.cpu_mask != 0) && !set_cpu_mask(settings.cpu_mask))
+    {
+        GST_WARNING("Failed to set inference thread affinity to 0x%" G_GINT64_MODIFIER "x",
+            settings.cpu_mask);
+        success = FALSE;
+    }
+
+    if ((settings.priority != 0) && !set_priority(settings.priority))
+    {
+        GST_WARNING("Failed to set inference thread priority to %d", settings.priority);
+        success = FALSE;
+    }
+#else
+    if (!settings.empty())
+    {
+        GST_WARNING("Inference thread affinity and priority are not supported on this platform");
+        success = FALSE;
+    }
+#endif
+
+    return success;
+}
+
+ScopedThreadSettings::ScopedThreadSettings(const ThreadSettings& settings)
+{
+#ifdef __linux__
+    // Only the settings that the thread does not have yet are changed, and
+    // later restored. A thread that kept the priority because it could not
+    // be restored does not try again.
+    if (settings.cpu_mask != 0)
+    {
+        guint64 cpu_mask = current_cpu_mask();
+        if ((cpu_mask != 0) && (cpu_mask != settings.cpu_mask))
+        {
+            settings_.cpu_mask = settings.cpu_mask;
+            previous_.cpu_mask = cpu_mask;
+        }
+    }
+
+    if (settings.priority != 0)
+    {
+        gint priority = current_priority();
+        if (priority != settings.priority)
+        {
+            settings_.priority = settings.priority;
+            previous_.priority = priority;
+        }
+    }
+
+    apply_thread_settings(settings_);
+#else
+    // Only warns that the settings are not supported, so once is enough.
+    static std::once_flag warned;
+    if (!settings.empty())
+    {
+        std::call_once(warned, [&settings]() { apply_thread_settings(settings); });
+    }
+#endif
+}
+
+ScopedThreadSettings::~ScopedThreadSettings()
+{
+#ifdef __linux__
+    if ((settings_.cpu_mask != 0) && !set_cpu_mask(previous_.cpu_mask))
+    {
+        GST_WARNING("Failed to restore thread affinity 0x%" G_GINT64_MODIFIER "x",
+            previous_.cpu_mask);
+    }
+
+    // Going back to a lower nice value requires CAP_SYS_NICE (or a high
+    // enough RLIMIT_NICE), so a thread that ran inference at a positive
+    // priority may keep it.
+    if ((settings_.priority != 0) && !set_priority(previous_.priority))
+    {
+        GST_WARNING("Failed to restore thread priority %d, the thread keeps "
+            "priority %d", previous_.priority, settings_.priority);
+    }
+#endif
+}
@@ -0,0 +1,105 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __THREAD_SETTINGS_H__
+#define __THREAD_SETTINGS_H__
+
+#include <glib.h>
+
+/**
+ * CPU affinity and scheduling priority for a thread that runs inference.
+ */
+struct ThreadSettings {
+
+    // CPUs the thread may run on, one bit per CPU. 0 leaves the affinity
+    // unchanged.
+    guint64 cpu_mask = 0;
+
+    // Nice value (-20 to 19). 0 leaves the priority unchanged.
+    gint priority = 0;
+
+    /**
+     * Check whether the settings change anything.
+     *
+     * @return bool true if neither the affinity nor the priority is set
+     */
+    bool empty() const;
+};
+
+/**
+ * Apply the settings to the calling thread. Threads created by the calling
+ * thread afterwards (such as OpenCV's worker threads) inherit them.
+ *
+ * @param settings Settings to apply
+ * @return gboolean TRUE on success, FALSE if any setting could not be applied
+ */
+gboolean apply_thread_settings(const ThreadSettings& settings);
+
+/**
+ * Applies thread settings to the calling thread for the lifetime of the
+ * object, then restores the previous affinity and priority. Settings the
+ * thread already has are left alone. A setting that cannot be restored is
+ * logged and left in place, so it is only logged once per thread: without
+ * CAP_SYS_NICE, a thread that ran at a positive nice value keeps it.
+ *
+ * This is for threads that also do other work. A dedicated inference thread
+ * calls apply_thread_settings() once instead.
+ */
+class ScopedThreadSettings {
+public:
+
+    explicit ScopedThreadSettings(const ThreadSettings& settings);
+    ~ScopedThreadSettings();
+
+    ScopedThreadSettings(const ScopedThreadSettings&) = delete;
+    ScopedThreadSettings& operator= (const ScopedThreadSettings&) = delete;
+
+
+private:
+
+    ThreadSettings settings_;
+
+    ThreadSettings previous_;
+};
+
+#endif // __THREAD_SETTINGS_H__
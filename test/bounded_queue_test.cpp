@@ -0,0 +1,174 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <gtest/gtest.h>
+#include "bounded_queue.h"
+
+namespace {
+
+// Long enough for a blocked thread to have reached its wait
+constexpr std::chrono::milliseconds kSettleTime(50);
+
+}
+
+TEST(BoundedQueueTest, ItemsLeaveInOrder)
+{
+    BoundedQueue<int> queue(3);
+
+    EXPECT_TRUE(queue.push(1));
+    EXPECT_TRUE(queue.push(2));
+    EXPECT_TRUE(queue.push(3));
+
+    int item = 0;
+    EXPECT_TRUE(queue.pop(item));
+    EXPECT_EQ(item, 1);
+    EXPECT_TRUE(queue.try_pop(item));
+    EXPECT_EQ(item, 2);
+    EXPECT_TRUE(queue.pop(item));
+    EXPECT_EQ(item, 3);
+
+    EXPECT_FALSE(queue.try_pop(item));
+}
+
+TEST(BoundedQueueTest, PushWaitsForSpace)
+{
+    BoundedQueue<int> queue(1);
+    ASSERT_TRUE(queue.push(1));
+
+    std::atomic<bool> pushed(false);
+    auto producer = std::async(std::launch::async, [&queue, &pushed]()
+    {
+        bool result = queue.push(2);
+        pushed = true;
+        return result;
+    });
+
+    std::this_thread::sleep_for(kSettleTime);
+    EXPECT_FALSE(pushed);
+
+    int item = 0;
+    ASSERT_TRUE(queue.pop(item));
+    EXPECT_EQ(item, 1);
+
+    EXPECT_TRUE(producer.get());
+    ASSERT_TRUE(queue.pop(item));
+    EXPECT_EQ(item, 2);
+}
+
+TEST(BoundedQueueTest, PopWaitsForItem)
+{
+    BoundedQueue<int> queue(1);
+
+    auto consumer = std::async(std::launch::async, [&queue]()
+    {
+        int item = 0;
+        return queue.pop(item) ? item : -1;
+    });
+
+    std::this_thread::sleep_for(kSettleTime);
+    EXPECT_EQ(consumer.wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+
+    ASSERT_TRUE(queue.push(7));
+    EXPECT_EQ(consumer.get(), 7);
+}
+
+TEST(BoundedQueueTest, CloseWakesWaiters)
+{
+    BoundedQueue<int> empty(1);
+    BoundedQueue<int> full(1);
+    ASSERT_TRUE(full.push(1));
+
+    auto consumer = std::async(std::launch::async, [&empty]()
+    {
+        int item = 0;
+        return empty.pop(item);
+    });
+
+    auto producer = std::async(std::launch::async, [&full]()
+    {
+        return full.push(2);
+    });
+
+    std::this_thread::sleep_for(kSettleTime);
+
+    empty.close();
+    full.close();
+
+    EXPECT_FALSE(consumer.get());
+    EXPECT_FALSE(producer.get());
+}
+
+TEST(BoundedQueueTest, ClosedQueueKeepsItemsForDrain)
+{
+    BoundedQueue<int> queue(3);
+    ASSERT_TRUE(queue.push(1));
+    ASSERT_TRUE(queue.push(2));
+
+    queue.close();
+
+    int item = 0;
+    EXPECT_FALSE(queue.push(3));
+    EXPECT_FALSE(queue.pop(item));
+    EXPECT_FALSE(queue.try_pop(item));
+
+    std::deque<int> items = queue.drain();
+    EXPECT_EQ(items, std::deque<int>({ 1, 2 }));
+    EXPECT_TRUE(queue.drain().empty());
+}
+
+TEST(BoundedQueueTest, MoveOnlyItems)
+{
+    BoundedQueue<std::unique_ptr<int>> queue(1);
+
+    ASSERT_TRUE(queue.push(std::unique_ptr<int>(new int(5))));
+
+    std::unique_ptr<int> item;
+    ASSERT_TRUE(queue.pop(item));
+    ASSERT_TRUE(item);
+    EXPECT_EQ(*item, 5);
+}
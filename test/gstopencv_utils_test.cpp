@@ -0,0 +1,129 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <gtest/gtest.h>
+#include "gstopencv-utils.h"
+
+namespace {
+
+typedef std::vector<cv::Point> Polygon;
+
+}
+
+TEST(ParseRegionsTest, MissingOrBlankTextHasNoRegions)
+{
+    std::vector<Polygon> regions = { { cv::Point(0, 0) } };
+
+    EXPECT_TRUE(parse_regions(nullptr, regions));
+    EXPECT_TRUE(regions.empty());
+
+    EXPECT_TRUE(parse_regions("", regions));
+    EXPECT_TRUE(regions.empty());
+
+    EXPECT_TRUE(parse_regions(" ; ;", regions));
+    EXPECT_TRUE(regions.empty());
+}
+
+TEST(ParseRegionsTest, RectangleCoversItsPixels)
+{
+    std::vector<Polygon> regions;
+
+    ASSERT_TRUE(parse_regions("10,20,100,50", regions));
+    ASSERT_EQ(regions.size(), 1u);
+
+    const Polygon expected = {
+        cv::Point(10, 20), cv::Point(109, 20), cv::Point(109, 69), cv::Point(10, 69) };
+
+    EXPECT_EQ(regions[0], expected);
+
+    // The bounding box of the corners is the rectangle itself.
+    EXPECT_EQ(cv::boundingRect(regions[0]), cv::Rect(10, 20, 100, 50));
+}
+
+TEST(ParseRegionsTest, PolygonKeepsItsVertices)
+{
+    std::vector<Polygon> regions;
+
+    ASSERT_TRUE(parse_regions("700,300  900,300\t960,540 640,540 ", regions));
+    ASSERT_EQ(regions.size(), 1u);
+
+    const Polygon expected = {
+        cv::Point(700, 300), cv::Point(900, 300), cv::Point(960, 540), cv::Point(640, 540) };
+
+    EXPECT_EQ(regions[0], expected);
+}
+
+TEST(ParseRegionsTest, RegionsAreSeparatedBySemicolons)
+{
+    std::vector<Polygon> regions;
+
+    ASSERT_TRUE(parse_regions(" 0,200,640,280 ; 700,300 900,300 960,540;", regions));
+    ASSERT_EQ(regions.size(), 2u);
+
+    EXPECT_EQ(regions[0].size(), 4u);
+    EXPECT_EQ(regions[1].size(), 3u);
+    EXPECT_EQ(cv::boundingRect(regions[0]), cv::Rect(0, 200, 640, 280));
+}
+
+TEST(ParseRegionsTest, InvalidRegionsAreRejected)
+{
+    const char* invalid[] = {
+        "-10,20,100,50",
+        "10,20,0,50",
+        "10,20,100,-50",
+        "10,20,100,50x",
+        "10,20 30,40",
+        "10,20 30,40 -50,60",
+        "10,20 30,40 50",
+        "a,b,c,d",
+        "0,0,10,10;garbage",
+    };
+
+    for (const char* text : invalid)
+    {
+        std::vector<Polygon> regions;
+
+        EXPECT_FALSE(parse_regions(text, regions)) << text;
+        EXPECT_TRUE(regions.empty()) << text;
+    }
+}
@@ -0,0 +1,257 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <tuple>
+#include <gtest/gtest.h>
+#include <opencv2/dnn.hpp>
+#include <opencv2/imgproc.hpp>
+#include "input_blob.h"
+
+namespace {
+
+// Normalization of the MobileNet SSD models
+constexpr float kScale = 1.0f / 127.5f;
+constexpr float kMean = 127.5f;
+
+// blobFromImage rounds the resized image to 8 bits before normalizing it,
+// while the fused kernel does not, so the two differ by up to one level.
+constexpr double kTolerance = 1.0 * kScale;
+
+cv::Mat random_image(const cv::Size& size, int type)
+{
+    cv::Mat image(size, type);
+    cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(256));
+    return image;
+}
+
+cv::Mat make_blob(const cv::Size& size)
+{
+    const int shape[] = { 1, 3, size.height, size.width };
+    return cv::Mat(4, shape, CV_32F, cv::Scalar(-1000));
+}
+
+InputBlobParams make_params(const cv::Size& size, bool swap_rb)
+{
+    InputBlobParams params;
+    params.size = size;
+    params.scale = kScale;
+    params.mean = kMean;
+    params.swap_rb = swap_rb;
+    return params;
+}
+
+cv::Mat reference_blob(const cv::Mat& bgr, const InputBlobParams& params, const cv::Size& size)
+{
+    return cv::dnn::blobFromImage(bgr, params.scale, size,
+        cv::Scalar::all(params.mean), params.swap_rb, false);
+}
+
+// A frame of a single color, so that chroma subsampling does not matter.
+FrameView uniform_frame(GstVideoFormat format, const cv::Size& size,
+    uchar y, uchar u, uchar v, std::vector<cv::Mat>& storage)
+{
+    const cv::Size chroma(size.width / 2, size.height / 2);
+
+    switch (format)
+    {
+    case GST_VIDEO_FORMAT_NV12:
+        storage = { cv::Mat(size, CV_8UC1, cv::Scalar(y)),
+            cv::Mat(chroma, CV_8UC2, cv::Scalar(u, v)) };
+        break;
+    case GST_VIDEO_FORMAT_I420:
+        storage = { cv::Mat(size, CV_8UC1, cv::Scalar(y)),
+            cv::Mat(chroma, CV_8UC1, cv::Scalar(u)),
+            cv::Mat(chroma, CV_8UC1, cv::Scalar(v)) };
+        break;
+    case GST_VIDEO_FORMAT_YUY2:
+        {
+            // Y0 U Y1 V: every pixel holds its luma, and the chroma sample
+            // alternates between U and V.
+            cv::Mat packed(size, CV_8UC2);
+            for (int row = 0; row < size.height; ++row)
+            {
+                for (int col = 0; col < size.width; ++col)
+                {
+                    packed.at<cv::Vec2b>(row, col) = cv::Vec2b(y, (col % 2) ? v : u);
+                }
+            }
+            storage = { packed };
+        }
+        break;
+    default:
+        break;
+    }
+
+    FrameView frame;
+    frame.format = format;
+    frame.size = size;
+    frame.planes = storage;
+    return frame;
+}
+
+class InputBlobTest : public ::testing::TestWithParam<std::tuple<cv::Size, cv::Size, bool>> {
+};
+
+}
+
+TEST_P(InputBlobTest, BgrMatchesBlobFromImage)
+{
+    const cv::Size frame_size = std::get<0>(GetParam());
+    const cv::Size input_size = std::get<1>(GetParam());
+    const InputBlobParams params = make_params(input_size, std::get<2>(GetParam()));
+
+    RecordProperty("kernel", input_blob_kernel());
+
+    cv::Mat image = random_image(frame_size, CV_8UC3);
+    cv::Mat blob = make_blob(input_size);
+
+    ASSERT_TRUE(fill_input_blob(FrameView::from_bgr(image), cv::Rect(cv::Point(), frame_size),
+        params, blob.ptr<float>()));
+
+    EXPECT_LE(cv::norm(blob, reference_blob(image, params, input_size), cv::NORM_INF),
+        kTolerance);
+}
+
+INSTANTIATE_TEST_SUITE_P(Sizes, InputBlobTest, ::testing::Combine(
+    ::testing::Values(cv::Size(1280, 720), cv::Size(300, 200), cv::Size(641, 479)),
+    ::testing::Values(cv::Size(300, 300), cv::Size(416, 416), cv::Size(513, 287)),
+    ::testing::Bool()));
+
+TEST(InputBlobSourceTest, SourceRegionMatchesCroppedImage)
+{
+    const cv::Size input_size(300, 300);
+    const InputBlobParams params = make_params(input_size, true);
+    const cv::Rect source(100, 50, 640, 480);
+
+    cv::Mat image = random_image(cv::Size(1280, 720), CV_8UC3);
+    cv::Mat blob = make_blob(input_size);
+
+    ASSERT_TRUE(fill_input_blob(FrameView::from_bgr(image), source, params, blob.ptr<float>()));
+
+    EXPECT_LE(cv::norm(blob, reference_blob(image(source), params, input_size), cv::NORM_INF),
+        kTolerance);
+}
+
+TEST(InputBlobSourceTest, TargetIsPaddedWithZeros)
+{
+    // Letterbox a 4:3 frame into a square input.
+    const cv::Size input_size(320, 320);
+    InputBlobParams params = make_params(input_size, false);
+    params.target = cv::Rect(0, 40, 320, 240);
+
+    cv::Mat image = random_image(cv::Size(640, 480), CV_8UC3);
+    cv::Mat blob = make_blob(input_size);
+
+    ASSERT_TRUE(fill_input_blob(FrameView::from_bgr(image), cv::Rect(0, 0, 640, 480),
+        params, blob.ptr<float>()));
+
+    cv::Mat reference = reference_blob(image, params, params.target.size());
+
+    for (int channel = 0; channel < 3; ++channel)
+    {
+        cv::Mat plane(input_size, CV_32F, blob.ptr<float>(0, channel));
+        cv::Mat reference_plane(params.target.size(), CV_32F, reference.ptr<float>(0, channel));
+
+        EXPECT_EQ(cv::countNonZero(plane.rowRange(0, params.target.y)), 0);
+        EXPECT_EQ(cv::countNonZero(plane.rowRange(params.target.br().y, input_size.height)), 0);
+        EXPECT_LE(cv::norm(plane(params.target), reference_plane, cv::NORM_INF), kTolerance);
+    }
+}
+
+TEST(InputBlobSourceTest, YuvMatchesConvertedFrame)
+{
+    const cv::Size frame_size(640, 480);
+    const cv::Size input_size(300, 300);
+    const InputBlobParams params = make_params(input_size, true);
+
+    const GstVideoFormat formats[] = {
+        GST_VIDEO_FORMAT_NV12,
+        GST_VIDEO_FORMAT_I420,
+        GST_VIDEO_FORMAT_YUY2,
+    };
+
+    const cv::Vec3b colors[] = {
+        cv::Vec3b(100, 90, 160),
+        cv::Vec3b(30, 200, 60),
+        cv::Vec3b(235, 128, 128),
+        cv::Vec3b(16, 16, 240),
+    };
+
+    for (GstVideoFormat format : formats)
+    {
+        for (const cv::Vec3b& color : colors)
+        {
+            std::vector<cv::Mat> storage;
+            FrameView frame = uniform_frame(format, frame_size, color[0], color[1], color[2], storage);
+
+            cv::Mat bgr;
+            ASSERT_TRUE(frame_to_bgr(frame, bgr));
+
+            cv::Mat blob = make_blob(input_size);
+            ASSERT_TRUE(fill_input_blob(frame, cv::Rect(cv::Point(), frame_size),
+                params, blob.ptr<float>()));
+
+            EXPECT_LE(cv::norm(blob, reference_blob(bgr, params, input_size), cv::NORM_INF),
+                kTolerance) << gst_video_format_to_string(format) << " YUV "
+                << int(color[0]) << "," << int(color[1]) << "," << int(color[2]);
+        }
+    }
+}
+
+TEST(InputBlobSourceTest, UnsupportedFormatIsRejected)
+{
+    const cv::Size input_size(300, 300);
+    cv::Mat image(480, 640, CV_8UC4, cv::Scalar::all(0));
+
+    FrameView frame;
+    frame.format = GST_VIDEO_FORMAT_RGBA;
+    frame.size = image.size();
+    frame.planes = { image };
+
+    cv::Mat blob = make_blob(input_size);
+    cv::Mat bgr;
+
+    EXPECT_FALSE(fill_input_blob(frame, cv::Rect(0, 0, 640, 480),
+        make_params(input_size, false), blob.ptr<float>()));
+    EXPECT_FALSE(frame_to_bgr(frame, bgr));
+}
@@ -0,0 +1,198 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "model_registry.h"
+
+namespace {
+
+// Darknet network of 3x3 convolutions, kFilters wide. Each convolution
+// after the first adds about 2.4 MB of weights.
+constexpr int kFilters = 256;
+constexpr int kLayers = 5;
+constexpr int kInstances = 4;
+
+class ModelRegistryTest : public ::testing::Test {
+protected:
+
+    void SetUp() override
+    {
+        config_ = ::testing::TempDir() + "model_registry_test.cfg";
+        weights_ = ::testing::TempDir() + "model_registry_test.weights";
+
+        std::ofstream config(config_);
+        config << "[net]\nwidth=32\nheight=32\nchannels=3\n";
+
+        std::ofstream weights(weights_, std::ios::binary);
+        const int32_t version[] = { 0, 2, 0 };
+        const uint64_t seen = 0;
+        weights.write(reinterpret_cast<const char*>(version), sizeof(version));
+        weights.write(reinterpret_cast<const char*>(&seen), sizeof(seen));
+
+        int channels = 3;
+        weights_bytes_ = 0;
+
+        for (int layer = 0; layer < kLayers; ++layer)
+        {
+            config << "\n[convolutional]\nfilters=" << kFilters
+                   << "\nsize=3\nstride=1\npad=1\nactivation=leaky\n";
+
+            // Biases, then the kernels
+            std::vector<float> values(kFilters + kFilters * channels * 9, 0.01f);
+            weights.write(reinterpret_cast<const char*>(values.data()),
+                values.size() * sizeof(float));
+
+            weights_bytes_ += values.size() * sizeof(float);
+            channels = kFilters;
+        }
+    }
+
+    ModelKey key(size_t owner = 0) const
+    {
+        ModelKey key;
+        key.config = config_;
+        key.weights = weights_;
+        key.owner = owner;
+        return key;
+    }
+
+    std::string config_;
+    std::string weights_;
+    size_t weights_bytes_;
+};
+
+long resident_change(size_t before)
+{
+    return static_cast<long>(ModelRegistry::resident_set_bytes()) - static_cast<long>(before);
+}
+
+}
+
+TEST_F(ModelRegistryTest, SharedModelIsLoadedOnce)
+{
+    ModelRegistry& registry = ModelRegistry::instance();
+
+    size_t before = ModelRegistry::resident_set_bytes();
+    if (before == 0)
+    {
+        GTEST_SKIP() << "Resident set size is not available";
+    }
+
+    std::vector<std::shared_ptr<SharedModel>> models;
+
+    models.push_back(registry.acquire(key()));
+    const long first = resident_change(before);
+
+    // The weights are parsed into the heap, so the first load adds about
+    // their size.
+    ASSERT_GE(first, static_cast<long>(weights_bytes_ / 2));
+
+    before = ModelRegistry::resident_set_bytes();
+    for (int index = 1; index < kInstances; ++index)
+    {
+        models.push_back(registry.acquire(key()));
+        EXPECT_EQ(models.back(), models.front());
+    }
+    const long shared = resident_change(before);
+
+    // Every owner gets a private copy.
+    before = ModelRegistry::resident_set_bytes();
+    for (int index = 1; index < kInstances; ++index)
+    {
+        models.push_back(registry.acquire(key(index)));
+        EXPECT_NE(models.back(), models.front());
+    }
+    const long private_copies = resident_change(before);
+
+    EXPECT_LT(shared, first / 4);
+    EXPECT_GT(private_copies, (kInstances - 1) * first / 2);
+}
+
+TEST_F(ModelRegistryTest, ConcurrentAcquireLoadsOnce)
+{
+    std::vector<std::shared_ptr<SharedModel>> models(kInstances);
+    std::vector<std::thread> threads;
+
+    for (int index = 0; index < kInstances; ++index)
+    {
+        threads.emplace_back([this, &models, index]()
+        {
+            models[index] = ModelRegistry::instance().acquire(key());
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    for (const auto& model : models)
+    {
+        ASSERT_TRUE(model);
+        EXPECT_EQ(model, models.front());
+    }
+}
+
+TEST_F(ModelRegistryTest, ReleasedModelIsUnloaded)
+{
+    ModelRegistry& registry = ModelRegistry::instance();
+
+    std::weak_ptr<SharedModel> released = registry.acquire(key());
+    EXPECT_TRUE(released.expired());
+    EXPECT_EQ(registry.memory_report().find(weights_), std::string::npos);
+
+    std::shared_ptr<SharedModel> model = registry.acquire(key());
+    EXPECT_NE(registry.memory_report().find(weights_), std::string::npos);
+}
+
+TEST_F(ModelRegistryTest, FailedLoadThrows)
+{
+    ModelKey missing = key();
+    missing.weights = ::testing::TempDir() + "missing.weights";
+
+    EXPECT_THROW(ModelRegistry::instance().acquire(missing), cv::Exception);
+    EXPECT_THROW(ModelRegistry::instance().acquire(missing), cv::Exception);
+}
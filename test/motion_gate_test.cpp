@@ -0,0 +1,192 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <chrono>
+#include <thread>
+#include <gtest/gtest.h>
+#include "motion_gate.h"
+
+namespace {
+
+constexpr float kThreshold = 0.1;
+
+cv::Mat make_image(int changed_width = 0)
+{
+    cv::Mat image(480, 640, CV_8UC3, cv::Scalar::all(50));
+    image.colRange(0, changed_width).setTo(cv::Scalar::all(200));
+    return image;
+}
+
+}
+
+TEST(MotionGateTest, DisabledGateDetectsEveryFrame)
+{
+    MotionGate gate;
+    cv::Mat image = make_image();
+
+    EXPECT_FALSE(gate.enabled());
+
+    for (int frame = 0; frame < 5; ++frame)
+    {
+        EXPECT_TRUE(gate.update(FrameView::from_bgr(image)));
+    }
+}
+
+TEST(MotionGateTest, StaticFramesAreSkipped)
+{
+    MotionGate gate;
+    gate.configure(kThreshold, 0, 0);
+    cv::Mat image = make_image();
+
+    EXPECT_TRUE(gate.update(FrameView::from_bgr(image)));
+    EXPECT_FLOAT_EQ(gate.score(), 1.0f);
+
+    for (int frame = 0; frame < 5; ++frame)
+    {
+        EXPECT_FALSE(gate.update(FrameView::from_bgr(image)));
+        EXPECT_FLOAT_EQ(gate.score(), 0.0f);
+    }
+}
+
+TEST(MotionGateTest, MotionAboveThresholdIsDetected)
+{
+    MotionGate gate;
+    gate.configure(kThreshold, 0, 0);
+
+    cv::Mat still = make_image();
+    cv::Mat small_change = make_image(32);
+    cv::Mat large_change = make_image(320);
+
+    EXPECT_TRUE(gate.update(FrameView::from_bgr(still)));
+
+    // 5% of the frame
+    EXPECT_FALSE(gate.update(FrameView::from_bgr(small_change)));
+    EXPECT_NEAR(gate.score(), 0.05f, 0.02f);
+
+    // Half of the frame
+    EXPECT_TRUE(gate.update(FrameView::from_bgr(large_change)));
+    EXPECT_NEAR(gate.score(), 0.5f, 0.02f);
+
+    // The detected frame is the new reference.
+    EXPECT_FALSE(gate.update(FrameView::from_bgr(large_change)));
+}
+
+TEST(MotionGateTest, MinIntervalLimitsDetections)
+{
+    MotionGate gate;
+    gate.configure(kThreshold, 10000, 0);
+
+    cv::Mat still = make_image();
+    cv::Mat moved = make_image(320);
+
+    EXPECT_TRUE(gate.update(FrameView::from_bgr(still)));
+    EXPECT_FALSE(gate.update(FrameView::from_bgr(moved)));
+    EXPECT_NEAR(gate.score(), 0.5f, 0.02f);
+}
+
+TEST(MotionGateTest, RefreshIntervalForcesDetection)
+{
+    MotionGate gate;
+    gate.configure(kThreshold, 0, 100);
+    cv::Mat image = make_image();
+
+    EXPECT_TRUE(gate.update(FrameView::from_bgr(image)));
+    EXPECT_FALSE(gate.update(FrameView::from_bgr(image)));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+
+    EXPECT_TRUE(gate.update(FrameView::from_bgr(image)));
+    EXPECT_FALSE(gate.update(FrameView::from_bgr(image)));
+}
+
+TEST(MotionGateTest, ResetForcesDetection)
+{
+    MotionGate gate;
+    gate.configure(kThreshold, 0, 0);
+    cv::Mat image = make_image();
+
+    EXPECT_TRUE(gate.update(FrameView::from_bgr(image)));
+    EXPECT_FALSE(gate.update(FrameView::from_bgr(image)));
+
+    gate.reset();
+
+    EXPECT_TRUE(gate.update(FrameView::from_bgr(image)));
+}
+
+TEST(MotionGateTest, Nv12LumaIsCompared)
+{
+    MotionGate gate;
+    gate.configure(kThreshold, 0, 0);
+
+    cv::Mat luma(480, 640, CV_8UC1, cv::Scalar(50));
+    cv::Mat chroma(240, 320, CV_8UC2, cv::Scalar(128, 128));
+
+    FrameView frame;
+    frame.format = GST_VIDEO_FORMAT_NV12;
+    frame.size = luma.size();
+    frame.planes = { luma, chroma };
+
+    EXPECT_TRUE(gate.update(frame));
+    EXPECT_FALSE(gate.update(frame));
+
+    luma.colRange(0, 320).setTo(cv::Scalar(200));
+
+    EXPECT_TRUE(gate.update(frame));
+    EXPECT_NEAR(gate.score(), 0.5f, 0.02f);
+}
+
+TEST(MotionGateTest, UnsupportedFormatIsDetected)
+{
+    MotionGate gate;
+    gate.configure(kThreshold, 0, 0);
+
+    cv::Mat image(480, 640, CV_8UC4, cv::Scalar::all(50));
+
+    FrameView frame;
+    frame.format = GST_VIDEO_FORMAT_RGBA;
+    frame.size = image.size();
+    frame.planes = { image };
+
+    EXPECT_TRUE(gate.update(frame));
+    EXPECT_TRUE(gate.update(frame));
+}
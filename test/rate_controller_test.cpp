@@ -0,0 +1,199 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <chrono>
+#include <thread>
+#include <gtest/gtest.h>
+#include "rate_controller.h"
+
+namespace {
+
+class RateControllerTest : public ::testing::Test {
+protected:
+
+    // Let the current measurement window end, so that the next frame
+    // updates the operating point.
+    bool next_window()
+    {
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(RateController::kWindowMs + 50));
+        return controller_.should_detect();
+    }
+
+    guint interval() const
+    {
+        DetectionList detection_list;
+        controller_.stamp(detection_list);
+        return detection_list.info.inference_interval;
+    }
+
+    RateController controller_;
+};
+
+}
+
+TEST_F(RateControllerTest, DisabledControllerDetectsEveryFrame)
+{
+    controller_.report(1000.0);
+
+    for (int frame = 0; frame < 10; ++frame)
+    {
+        EXPECT_TRUE(controller_.should_detect());
+    }
+
+    EXPECT_FALSE(controller_.enabled());
+    EXPECT_EQ(interval(), 1u);
+}
+
+TEST_F(RateControllerTest, LatencyTargetSetsInterval)
+{
+    controller_.configure(10, 0);
+    controller_.report(40.0);
+
+    controller_.should_detect();
+    next_window();
+
+    EXPECT_EQ(interval(), 4u);
+
+    // Exactly one frame in every interval is detected.
+    int detected = 0;
+    for (int frame = 0; frame < 40; ++frame)
+    {
+        detected += controller_.should_detect() ? 1 : 0;
+    }
+
+    EXPECT_EQ(detected, 10);
+}
+
+TEST_F(RateControllerTest, IntervalIsCapped)
+{
+    controller_.configure(1, 0);
+    controller_.report(1000.0);
+
+    controller_.should_detect();
+    next_window();
+
+    EXPECT_EQ(interval(), RateController::kMaxInterval);
+}
+
+TEST_F(RateControllerTest, IntervalFallsOneStepPerWindow)
+{
+    controller_.configure(10, 0);
+    controller_.report(40.0);
+
+    controller_.should_detect();
+    next_window();
+    ASSERT_EQ(interval(), 4u);
+
+    // Inference got fast, so there is headroom at every interval.
+    for (int sample = 0; sample < 50; ++sample)
+    {
+        controller_.report(1.0);
+    }
+
+    for (guint expected = 3; expected >= 1; --expected)
+    {
+        next_window();
+        EXPECT_EQ(interval(), expected);
+    }
+
+    next_window();
+    EXPECT_EQ(interval(), 1u);
+}
+
+TEST_F(RateControllerTest, IntervalHoldsNearTheTarget)
+{
+    controller_.configure(10, 0);
+    controller_.report(40.0);
+
+    controller_.should_detect();
+    next_window();
+    ASSERT_EQ(interval(), 4u);
+
+    // 3 would be within the target, but too close to it to step down.
+    for (int sample = 0; sample < 50; ++sample)
+    {
+        controller_.report(25.0);
+    }
+
+    next_window();
+    EXPECT_EQ(interval(), 4u);
+}
+
+TEST_F(RateControllerTest, CpuLimitRaisesInterval)
+{
+    controller_.configure(0, 1);
+    controller_.should_detect();
+
+    // Keep a core busy for the whole window.
+    const auto end = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(RateController::kWindowMs + 50);
+    volatile unsigned long spins = 0;
+    while (std::chrono::steady_clock::now() < end)
+    {
+        spins = spins + 1;
+    }
+
+    controller_.should_detect();
+
+    DetectionList detection_list;
+    controller_.stamp(detection_list);
+
+    EXPECT_GT(detection_list.info.cpu_percent, 50.0f);
+    EXPECT_GT(detection_list.info.inference_interval, 1u);
+}
+
+TEST_F(RateControllerTest, ResetReturnsToEveryFrame)
+{
+    controller_.configure(10, 0);
+    controller_.report(40.0);
+
+    controller_.should_detect();
+    next_window();
+    ASSERT_EQ(interval(), 4u);
+
+    controller_.reset();
+
+    EXPECT_EQ(interval(), 1u);
+    EXPECT_TRUE(controller_.should_detect());
+}
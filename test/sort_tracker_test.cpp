@@ -0,0 +1,249 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <gtest/gtest.h>
+#include "sort_tracker.h"
+
+namespace {
+
+constexpr uint64_t kFrameMs = 100;
+
+Detection make_detection(int class_id, const cv::Rect& box)
+{
+    Detection detection;
+    detection.class_id = class_id;
+    detection.box = box;
+    return detection;
+}
+
+DetectionList make_list(uint64_t timestamp, const std::vector<Detection>& detections)
+{
+    DetectionList detection_list;
+    detection_list.info.timestamp = timestamp;
+    detection_list.detections = detections;
+    return detection_list;
+}
+
+class SortTrackerTest : public ::testing::Test {
+protected:
+
+    void SetUp() override
+    {
+        tracker_.configure(true, SortTracker::kDefaultIouThreshold, SortTracker::kDefaultMaxAgeMs);
+    }
+
+    // Update the tracker with one list and return it.
+    DetectionList update(uint64_t timestamp, const std::vector<Detection>& detections)
+    {
+        DetectionList detection_list = make_list(timestamp, detections);
+        tracker_.update(detection_list);
+        return detection_list;
+    }
+
+    SortTracker tracker_;
+};
+
+}
+
+TEST_F(SortTrackerTest, DisabledTrackerLeavesDetectionsUnlabeled)
+{
+    tracker_.configure(false, SortTracker::kDefaultIouThreshold, SortTracker::kDefaultMaxAgeMs);
+
+    for (uint64_t frame = 1; frame <= 5; ++frame)
+    {
+        DetectionList detection_list = update(frame * kFrameMs,
+            { make_detection(0, cv::Rect(100, 100, 50, 50)) });
+
+        EXPECT_EQ(detection_list.detections[0].track_id, 0u);
+    }
+}
+
+TEST_F(SortTrackerTest, TrackIdIsReportedOnceConfirmed)
+{
+    guint32 track_id = 0;
+
+    for (uint64_t frame = 1; frame <= 10; ++frame)
+    {
+        const int x = 100 + static_cast<int>(frame) * 5;
+        DetectionList detection_list = update(frame * kFrameMs,
+            { make_detection(0, cv::Rect(x, 100, 50, 50)) });
+
+        const Detection& detection = detection_list.detections[0];
+
+        if (frame < SortTracker::kMinHits)
+        {
+            EXPECT_EQ(detection.track_id, 0u);
+        }
+        else if (frame == SortTracker::kMinHits)
+        {
+            track_id = detection.track_id;
+            EXPECT_NE(track_id, 0u);
+        }
+        else
+        {
+            EXPECT_EQ(detection.track_id, track_id);
+        }
+
+        EXPECT_EQ(detection.age, (frame - 1) * kFrameMs);
+    }
+}
+
+TEST_F(SortTrackerTest, VelocityFollowsTheBox)
+{
+    // 10 pixels right and 5 pixels down every 100 ms
+    DetectionList detection_list;
+
+    for (uint64_t frame = 1; frame <= 20; ++frame)
+    {
+        const int offset = static_cast<int>(frame);
+        detection_list = update(frame * kFrameMs,
+            { make_detection(0, cv::Rect(100 + offset * 10, 100 + offset * 5, 50, 50)) });
+    }
+
+    EXPECT_NEAR(detection_list.detections[0].velocity.x, 100.0f, 10.0f);
+    EXPECT_NEAR(detection_list.detections[0].velocity.y, 50.0f, 10.0f);
+}
+
+TEST_F(SortTrackerTest, ObjectsAndClassesAreTrackedSeparately)
+{
+    DetectionList detection_list;
+
+    for (uint64_t frame = 1; frame <= SortTracker::kMinHits; ++frame)
+    {
+        detection_list = update(frame * kFrameMs, {
+            make_detection(0, cv::Rect(100, 100, 50, 50)),
+            make_detection(1, cv::Rect(100, 100, 50, 50)),
+            make_detection(0, cv::Rect(400, 100, 50, 50)) });
+    }
+
+    const auto& detections = detection_list.detections;
+
+    EXPECT_NE(detections[0].track_id, 0u);
+    EXPECT_NE(detections[1].track_id, 0u);
+    EXPECT_NE(detections[2].track_id, 0u);
+    EXPECT_NE(detections[0].track_id, detections[1].track_id);
+    EXPECT_NE(detections[0].track_id, detections[2].track_id);
+    EXPECT_NE(detections[1].track_id, detections[2].track_id);
+}
+
+TEST_F(SortTrackerTest, ExpiredTrackIsReplaced)
+{
+    const Detection detection = make_detection(0, cv::Rect(100, 100, 50, 50));
+    uint64_t timestamp = 0;
+    guint32 track_id = 0;
+
+    for (guint frame = 0; frame < SortTracker::kMinHits; ++frame)
+    {
+        timestamp += kFrameMs;
+        track_id = update(timestamp, { detection }).detections[0].track_id;
+    }
+    ASSERT_NE(track_id, 0u);
+
+    // The object is missing for longer than the maximum age.
+    timestamp += SortTracker::kDefaultMaxAgeMs + kFrameMs;
+    update(timestamp, {});
+
+    DetectionList detection_list;
+    for (guint frame = 0; frame < SortTracker::kMinHits; ++frame)
+    {
+        timestamp += kFrameMs;
+        detection_list = update(timestamp, { detection });
+    }
+
+    EXPECT_NE(detection_list.detections[0].track_id, 0u);
+    EXPECT_NE(detection_list.detections[0].track_id, track_id);
+}
+
+TEST_F(SortTrackerTest, CopiedListTakesIdsWithoutUpdatingTracks)
+{
+    const cv::Rect box(100, 100, 50, 50);
+    DetectionList detected;
+
+    for (uint64_t frame = 1; frame <= SortTracker::kMinHits; ++frame)
+    {
+        detected = update(frame * kFrameMs, { make_detection(0, box) });
+    }
+
+    const guint32 track_id = detected.detections[0].track_id;
+    ASSERT_NE(track_id, 0u);
+
+    // Republishing the same detections many times over must not count as
+    // new matches or move the track.
+    for (uint64_t frame = SortTracker::kMinHits + 1; frame <= 20; ++frame)
+    {
+        DetectionList copied = make_list(frame * kFrameMs, { make_detection(0, box) });
+        copied.info.reused = true;
+        tracker_.update(copied);
+
+        EXPECT_EQ(copied.detections[0].track_id, track_id);
+    }
+
+    // A copy that overlaps no track is left unlabeled.
+    DetectionList unmatched = make_list(21 * kFrameMs,
+        { make_detection(0, cv::Rect(400, 400, 50, 50)) });
+    unmatched.info.reused = true;
+    tracker_.update(unmatched);
+
+    EXPECT_EQ(unmatched.detections[0].track_id, 0u);
+}
+
+TEST_F(SortTrackerTest, ResetDropsTracksButKeepsIdsIncreasing)
+{
+    const Detection detection = make_detection(0, cv::Rect(100, 100, 50, 50));
+    guint32 track_id = 0;
+
+    for (uint64_t frame = 1; frame <= SortTracker::kMinHits; ++frame)
+    {
+        track_id = update(frame * kFrameMs, { detection }).detections[0].track_id;
+    }
+
+    tracker_.reset();
+
+    DetectionList detection_list;
+    for (uint64_t frame = 1; frame <= SortTracker::kMinHits; ++frame)
+    {
+        detection_list = update(frame * kFrameMs, { detection });
+    }
+
+    EXPECT_GT(detection_list.detections[0].track_id, track_id);
+}
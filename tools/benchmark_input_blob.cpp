@@ -0,0 +1,216 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Times the fused input blob kernel against the OpenCV path it replaces
+ * (conversion to BGR followed by cv::dnn::blobFromImage) on random frames
+ * of every supported format. Each measurement is repeated over several
+ * rounds, and the minimum and median time per frame are reported, so that
+ * kernels can be compared on a machine that is not idle.
+ *
+ * The SIMD kernel is chosen when the detector is compiled. Build with
+ * -Dcpp_args=-march=native (or compare opencv-detector-blob-bench with
+ * opencv-detector-blob-bench-avx2) to measure another one.
+ *
+ * Usage:
+ *   opencv-detector-blob-bench [frame-width frame-height
+ *       [input-width input-height [iterations]]]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "input_blob.h"
+
+namespace {
+
+constexpr int kRounds = 15;
+
+struct Timing {
+    double min_ms = 0.0;
+    double median_ms = 0.0;
+};
+
+Timing time_per_frame(const std::function<void()>& run, int iterations)
+{
+    // The first run allocates and warms the caches.
+    run();
+
+    std::vector<double> rounds;
+
+    for (int round = 0; round < kRounds; ++round)
+    {
+        auto start_time = std::chrono::steady_clock::now();
+
+        for (int iteration = 0; iteration < iterations; ++iteration)
+        {
+            run();
+        }
+
+        rounds.push_back(std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start_time).count() / iterations);
+    }
+
+    std::sort(rounds.begin(), rounds.end());
+
+    Timing timing;
+    timing.min_ms = rounds.front();
+    timing.median_ms = rounds[rounds.size() / 2];
+    return timing;
+}
+
+cv::Mat random_plane(int rows, int cols, int type)
+{
+    cv::Mat plane(rows, cols, type);
+    cv::randu(plane, cv::Scalar::all(0), cv::Scalar::all(256));
+    return plane;
+}
+
+FrameView random_frame(GstVideoFormat format, const cv::Size& size)
+{
+    FrameView frame;
+    frame.format = format;
+    frame.size = size;
+
+    const cv::Size chroma(size.width / 2, size.height / 2);
+
+    switch (format)
+    {
+    case GST_VIDEO_FORMAT_BGR:
+        frame.planes.push_back(random_plane(size.height, size.width, CV_8UC3));
+        break;
+    case GST_VIDEO_FORMAT_NV12:
+        frame.planes.push_back(random_plane(size.height, size.width, CV_8UC1));
+        frame.planes.push_back(random_plane(chroma.height, chroma.width, CV_8UC2));
+        break;
+    case GST_VIDEO_FORMAT_I420:
+        frame.planes.push_back(random_plane(size.height, size.width, CV_8UC1));
+        frame.planes.push_back(random_plane(chroma.height, chroma.width, CV_8UC1));
+        frame.planes.push_back(random_plane(chroma.height, chroma.width, CV_8UC1));
+        break;
+    case GST_VIDEO_FORMAT_YUY2:
+        frame.planes.push_back(random_plane(size.height, size.width, CV_8UC2));
+        break;
+    default:
+        break;
+    }
+
+    return frame;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    const cv::Size frame_size(
+        (argc > 2) ? atoi(argv[1]) : 1280,
+        (argc > 2) ? atoi(argv[2]) : 720);
+    const cv::Size input_size(
+        (argc > 4) ? atoi(argv[3]) : 300,
+        (argc > 4) ? atoi(argv[4]) : 300);
+    const int iterations = (argc > 5) ? std::max(1, atoi(argv[5])) : 50;
+
+    if (frame_size.empty() || input_size.empty())
+    {
+        fprintf(stderr, "Usage: %s [frame-width frame-height [input-width input-height "
+            "[iterations]]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    InputBlobParams params;
+    params.size = input_size;
+    params.scale = 1.0f / 127.5f;
+    params.mean = 127.5f;
+    params.swap_rb = true;
+
+    const cv::Rect source(cv::Point(0, 0), frame_size);
+
+    const int shape[] = { 1, 3, input_size.height, input_size.width };
+    cv::Mat fused(4, shape, CV_32F);
+
+    printf("Kernel: %s, frame %dx%d, input %dx%d, %d rounds of %d frames\n",
+        input_blob_kernel(), frame_size.width, frame_size.height,
+        input_size.width, input_size.height, kRounds, iterations);
+    printf("format,fused_min_ms,fused_median_ms,opencv_min_ms,opencv_median_ms,max_difference\n");
+
+    const GstVideoFormat formats[] = {
+        GST_VIDEO_FORMAT_BGR,
+        GST_VIDEO_FORMAT_NV12,
+        GST_VIDEO_FORMAT_I420,
+        GST_VIDEO_FORMAT_YUY2,
+    };
+
+    for (GstVideoFormat format : formats)
+    {
+        const FrameView frame = random_frame(format, frame_size);
+
+        Timing fused_timing = time_per_frame([&]()
+        {
+            fill_input_blob(frame, source, params, fused.ptr<float>());
+        }, iterations);
+
+        cv::Mat bgr;
+        cv::Mat reference;
+
+        Timing opencv_timing = time_per_frame([&]()
+        {
+            frame_to_bgr(frame, bgr);
+            cv::dnn::blobFromImage(bgr, reference, params.scale, input_size,
+                cv::Scalar::all(params.mean), params.swap_rb, false);
+        }, iterations);
+
+        // Chroma is sampled at the nearest position rather than upsampled
+        // first, so only BGR frames are expected to match closely.
+        double max_difference = cv::norm(fused, reference, cv::NORM_INF);
+
+        printf("%s,%.3f,%.3f,%.3f,%.3f,%.4f\n", gst_video_format_to_string(format),
+            fused_timing.min_ms, fused_timing.median_ms,
+            opencv_timing.min_ms, opencv_timing.median_ms, max_difference);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,234 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Compares the FP32 network with its INT8 quantization on a fixed set of
+ * images. For every image, both detectors run once and the tool prints
+ * their latency and how well the INT8 detections agree with the FP32 ones.
+ * Agreement is measured by greedy IoU matching within each class, treating
+ * the FP32 detections as the reference.
+ *
+ * Usage:
+ *   opencv-detector-compare <configs> <weights> <classes> <calibration-dir>
+ *       <image-dir> [iou-threshold]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "object_detector.h"
+
+namespace {
+
+struct Agreement {
+    size_t reference = 0;
+    size_t candidate = 0;
+    size_t matched = 0;
+};
+
+double iou(const cv::Rect& a, const cv::Rect& b)
+{
+    double intersection = (a & b).area();
+    double area_union = a.area() + b.area() - intersection;
+    return (area_union > 0) ? (intersection / area_union) : 0.0;
+}
+
+Agreement match(const DetectionList& reference, const DetectionList& candidate, double threshold)
+{
+    Agreement agreement;
+    agreement.reference = reference.detections.size();
+    agreement.candidate = candidate.detections.size();
+
+    std::vector<bool> used(candidate.detections.size(), false);
+
+    for (const auto& expected : reference.detections)
+    {
+        double best_iou = threshold;
+        size_t best_index = candidate.detections.size();
+
+        for (size_t index = 0; index < candidate.detections.size(); ++index)
+        {
+            const Detection& detection = candidate.detections[index];
+            if (used[index] || (detection.class_id != expected.class_id))
+            {
+                continue;
+            }
+
+            double overlap = iou(expected.box, detection.box);
+            if (overlap >= best_iou)
+            {
+                best_iou = overlap;
+                best_index = index;
+            }
+        }
+
+        if (best_index < candidate.detections.size())
+        {
+            used[best_index] = true;
+            agreement.matched++;
+        }
+    }
+
+    return agreement;
+}
+
+double detect_ms(ObjectDetector& detector, const cv::Mat& image, DetectionList& detection_list)
+{
+    auto start_time = std::chrono::steady_clock::now();
+    detector.get_objects(FrameView::from_bgr(image), detection_list);
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start_time).count();
+}
+
+double percentile(std::vector<double> values, double fraction)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(fraction * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+double mean(const std::vector<double>& values)
+{
+    return values.empty() ? 0.0 :
+        std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+}
+
+void print_latency(const char* name, const std::vector<double>& values)
+{
+    printf("%s latency: mean %.2f ms, median %.2f ms, p95 %.2f ms\n", name,
+        mean(values), percentile(values, 0.5), percentile(values, 0.95));
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 6)
+    {
+        fprintf(stderr, "Usage: %s <configs> <weights> <classes> <calibration-dir> "
+            "<image-dir> [iou-threshold]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char* configs = argv[1];
+    const char* weights = argv[2];
+    const char* classes = argv[3];
+    const char* calibration_dir = argv[4];
+    const char* image_dir = argv[5];
+    double iou_threshold = (argc > 6) ? atof(argv[6]) : 0.5;
+
+    ObjectDetector fp32;
+    if (!fp32.initialize(configs, weights, classes))
+    {
+        fprintf(stderr, "Failed to load the FP32 network.\n");
+        return EXIT_FAILURE;
+    }
+
+    ObjectDetector int8;
+    int8.set_calibration_dir(calibration_dir);
+    if (!int8.initialize(configs, weights, classes))
+    {
+        fprintf(stderr, "Failed to quantize the network.\n");
+        return EXIT_FAILURE;
+    }
+
+    fp32.warm_up();
+    int8.warm_up();
+
+    std::vector<cv::String> paths;
+    cv::glob(image_dir, paths, false);
+
+    std::vector<double> fp32_ms;
+    std::vector<double> int8_ms;
+    Agreement total;
+
+    printf("image,fp32_ms,int8_ms,fp32_detections,int8_detections,matched\n");
+
+    for (const auto& path : paths)
+    {
+        cv::Mat image = cv::imread(path, cv::IMREAD_COLOR);
+        if (image.empty())
+        {
+            continue;
+        }
+
+        DetectionList fp32_detections;
+        DetectionList int8_detections;
+
+        fp32_ms.push_back(detect_ms(fp32, image, fp32_detections));
+        int8_ms.push_back(detect_ms(int8, image, int8_detections));
+
+        Agreement agreement = match(fp32_detections, int8_detections, iou_threshold);
+        total.reference += agreement.reference;
+        total.candidate += agreement.candidate;
+        total.matched += agreement.matched;
+
+        printf("%s,%.2f,%.2f,%zu,%zu,%zu\n", path.c_str(), fp32_ms.back(), int8_ms.back(),
+            agreement.reference, agreement.candidate, agreement.matched);
+    }
+
+    if (fp32_ms.empty())
+    {
+        fprintf(stderr, "No images found in '%s'.\n", image_dir);
+        return EXIT_FAILURE;
+    }
+
+    printf("\n%zu images\n", fp32_ms.size());
+    print_latency("FP32", fp32_ms);
+    print_latency("INT8", int8_ms);
+    printf("Speedup: %.2fx\n", mean(fp32_ms) / std::max(mean(int8_ms), 1e-9));
+    printf("Agreement at IoU %.2f: precision %.3f, recall %.3f\n", iou_threshold,
+        total.candidate ? static_cast<double>(total.matched) / total.candidate : 1.0,
+        total.reference ? static_cast<double>(total.matched) / total.reference : 1.0);
+
+    return EXIT_SUCCESS;
+}
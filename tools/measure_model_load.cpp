@@ -0,0 +1,268 @@
+/*
+ * OpenCV Detector Plugin
+ * Copyright (C) 2024 Robert Vaughan <robert.glissmann@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Measures how long a network takes to load, and how much memory loading
+ * it costs, with OpenCV reading the model files (map-model=false) and with
+ * the files memory-mapped (map-model=true). Every load runs in a fresh
+ * child process, so that neither mode benefits from the heap or the
+ * mappings left behind by the other. With --cold, the model files are
+ * dropped from the page cache before each load.
+ *
+ * For each load, the tool prints the load time, the change in resident
+ * set size, and the peak resident set size during the load relative to
+ * before it. The medians of each mode follow.
+ *
+ * Usage:
+ *   opencv-detector-measure-load <configs> <weights> [runs] [--cold]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "model_registry.h"
+
+namespace {
+
+struct LoadResult {
+    double load_ms = 0.0;
+    long resident_kib = 0;
+    long peak_kib = 0;
+};
+
+/**
+ * Read a "<field>: <value> kB" line of /proc/self/status.
+ */
+long status_kib(const char* field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    const size_t length = strlen(field);
+
+    while (std::getline(status, line))
+    {
+        if ((line.compare(0, length, field) == 0) && (line[length] == ':'))
+        {
+            return atol(line.c_str() + length + 1);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Ask the kernel to drop the file's pages from the page cache. Only clean
+ * pages that no process has mapped are dropped.
+ */
+void evict_from_page_cache(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+/**
+ * Load the network in a child process and report its measurements.
+ */
+bool measure_load(const ModelKey& key, bool map_files, bool cold, LoadResult& result)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return false;
+    }
+
+    pid_t child = fork();
+    if (child < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    if (child == 0)
+    {
+        close(fds[0]);
+
+        if (cold)
+        {
+            evict_from_page_cache(key.config);
+            evict_from_page_cache(key.weights);
+        }
+
+        ModelLoadOptions options;
+        options.map_files = map_files;
+
+        LoadResult measured;
+        const long resident_before = status_kib("VmRSS");
+        auto start_time = std::chrono::steady_clock::now();
+
+        try
+        {
+            std::shared_ptr<SharedModel> model = ModelRegistry::instance().acquire(key, options);
+
+            measured.load_ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start_time).count();
+            measured.resident_kib = status_kib("VmRSS") - resident_before;
+            measured.peak_kib = status_kib("VmHWM") - resident_before;
+        }
+        catch (const cv::Exception& e)
+        {
+            fprintf(stderr, "Failed to load the network: %s\n", e.what());
+            _exit(EXIT_FAILURE);
+        }
+
+        bool written = write(fds[1], &measured, sizeof(measured)) == sizeof(measured);
+        _exit(written ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    close(fds[1]);
+
+    bool received = read(fds[0], &result, sizeof(result)) == sizeof(result);
+    close(fds[0]);
+
+    int status = 0;
+    waitpid(child, &status, 0);
+
+    return received && WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_SUCCESS);
+}
+
+template <typename T>
+T median(std::vector<T> values)
+{
+    if (values.empty())
+    {
+        return T();
+    }
+
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<const char*> arguments;
+    bool cold = false;
+
+    for (int index = 1; index < argc; ++index)
+    {
+        if (strcmp(argv[index], "--cold") == 0)
+        {
+            cold = true;
+        }
+        else
+        {
+            arguments.push_back(argv[index]);
+        }
+    }
+
+    if (arguments.size() < 2)
+    {
+        fprintf(stderr, "Usage: %s <configs> <weights> [runs] [--cold]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    ModelKey key;
+    key.config = arguments[0];
+    key.weights = arguments[1];
+
+    const int runs = (arguments.size() > 2) ? std::max(1, atoi(arguments[2])) : 5;
+
+    std::vector<LoadResult> results[2];
+
+    printf("run,mode,load_ms,resident_delta_kib,peak_delta_kib\n");
+
+    for (int run = 0; run < runs; ++run)
+    {
+        // Alternate the modes so that both see the same system state.
+        for (int mode = 0; mode < 2; ++mode)
+        {
+            const bool map_files = (mode == 1);
+            LoadResult result;
+
+            if (!measure_load(key, map_files, cold, result))
+            {
+                return EXIT_FAILURE;
+            }
+
+            printf("%d,%s,%.1f,%ld,%ld\n", run, map_files ? "mapped" : "read",
+                result.load_ms, result.resident_kib, result.peak_kib);
+
+            results[mode].push_back(result);
+        }
+    }
+
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        std::vector<double> load_ms;
+        std::vector<long> resident_kib;
+        std::vector<long> peak_kib;
+
+        for (const auto& result : results[mode])
+        {
+            load_ms.push_back(result.load_ms);
+            resident_kib.push_back(result.resident_kib);
+            peak_kib.push_back(result.peak_kib);
+        }
+
+        printf("%s%s: median load %.1f ms, resident %+ld KiB, peak %+ld KiB\n",
+            (mode == 1) ? "mapped" : "read", cold ? " (cold)" : "",
+            median(load_ms), median(resident_kib), median(peak_kib));
+    }
+
+    return EXIT_SUCCESS;
+}